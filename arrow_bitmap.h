@@ -0,0 +1,285 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bit_util.h"
+#include "bitstream.h"
+#include "compact_bitset.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+/// Interop with Apache Arrow style validity bitmaps.
+///
+/// An Arrow bitmap is a byte buffer where bit i lives in byte i / 8 at bit position i % 8 (LSB first), and an array
+/// may start at any bit offset into it. On little-endian hosts that is exactly how compact_bitset lays out its
+/// words, whatever their width, so a compact_bitset can be handed to Arrow-consuming code as a view without copying.
+///
+/// The kernels (count, count_and, bitmap_and, bitmap_or, ...) take views with arbitrary, mutually unrelated bit
+/// offsets. Rather than realigning the inputs into temporaries first, they read each 64-bit chunk at whatever
+/// offset it sits with one unaligned load and a funnel shift, and write the output a whole word at a time once it
+/// is byte-aligned.
+namespace arrow_bitmap_detail {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool LittleEndian = false;
+#else
+constexpr bool LittleEndian = true;
+#endif
+constexpr std::size_t Alignment = 64; ///< Arrow's recommended buffer alignment and padding
+
+inline std::uint64_t load_le64(const std::uint8_t *p) noexcept {
+    std::uint64_t w;
+    std::memcpy(&w, p, 8);
+    if constexpr (!LittleEndian) w = __builtin_bswap64(w);
+    return w;
+}
+inline void store_le64(std::uint8_t *p, std::uint64_t w) noexcept {
+    if constexpr (!LittleEndian) w = __builtin_bswap64(w);
+    std::memcpy(p, &w, 8);
+}
+/// 64 bits starting at absolute bit position a; bytes a / 8 through a / 8 + 8 must be readable
+inline std::uint64_t load_bits(const std::uint8_t *p, std::size_t a) noexcept {
+    const unsigned sh = a % 8;
+    p += a / 8;
+    const std::uint64_t w = load_le64(p) >> sh;
+    return sh ? w | std::uint64_t(p[8]) << (64 - sh) : w;
+}
+} // namespace arrow_bitmap_detail
+
+/// Read-only view of `length` bits of an Arrow-layout bitmap, starting `offset` bits into `data`
+class arrow_bitmap_view
+{
+protected:
+    const std::uint8_t *ptr = nullptr;
+    std::size_t off = 0, len = 0;
+public:
+    constexpr arrow_bitmap_view() noexcept = default;
+    arrow_bitmap_view(const void *data, std::size_t offset, std::size_t length) noexcept
+        : ptr(static_cast<const std::uint8_t *>(data)), off(offset), len(length) {}
+    /// Zero-copy view of a compact_bitset (only possible on little-endian hosts, unless its words are bytes)
+    template <std::size_t N, typename T>
+    arrow_bitmap_view(const compact_bitset<N, T> &bs) noexcept : arrow_bitmap_view(bs.bits(), 0, N) {
+        static_assert(arrow_bitmap_detail::LittleEndian || sizeof(T) == 1, "compact_bitset words are not in Arrow byte order on this host");
+    }
+
+    const std::uint8_t * data() const noexcept { return ptr; }
+    std::size_t offset() const noexcept { return off; }
+    std::size_t length() const noexcept { return len; }
+
+    bool operator[](std::size_t i) const noexcept { return ptr[(off + i) / 8] >> ((off + i) % 8) & 1; }
+    bool test(std::size_t i) const {
+        if (i >= len) throw std::out_of_range("Out-of-range bit position specified to arrow_bitmap_view");
+        return (*this)[i];
+    }
+    /// The view of bits [i, i + n)
+    arrow_bitmap_view slice(std::size_t i, std::size_t n) const {
+        if (i > len || n > len - i) throw std::out_of_range("arrow_bitmap_view::slice out of range");
+        return arrow_bitmap_view(ptr, off + i, n);
+    }
+
+    /// Bits [i, i + n) as a word (n <= 64), bit 0 being bit i. Bits past length() read as 0. Never reads a byte
+    /// outside the ones holding bits [0, length()).
+    std::uint64_t load(std::size_t i, unsigned n = 64) const noexcept {
+        if (i >= len) return 0;
+        const std::size_t a = off + i, byte = a / 8, end = (off + len + 7) / 8;
+        const unsigned sh = a % 8;
+        std::uint64_t w;
+        if (byte + 9 <= end) {
+            w = arrow_bitmap_detail::load_bits(ptr, a);
+        } else { // near the end of the buffer
+            std::uint8_t tmp[16] = {};
+            std::copy(ptr + byte, ptr + end, tmp);
+            w = arrow_bitmap_detail::load_bits(tmp, sh);
+        }
+        return w & bit_util::low_mask(unsigned(std::min<std::size_t>(n, len - i)));
+    }
+};
+
+/// Mutable view of an Arrow-layout bitmap. Writes never touch bits outside [offset(), offset() + length()).
+class arrow_bitmap_mut_view : public arrow_bitmap_view
+{
+    std::uint8_t * mptr() const noexcept { return const_cast<std::uint8_t *>(ptr); }
+public:
+    constexpr arrow_bitmap_mut_view() noexcept = default;
+    arrow_bitmap_mut_view(void *data, std::size_t offset, std::size_t length) noexcept : arrow_bitmap_view(data, offset, length) {}
+    /// Zero-copy mutable view of a compact_bitset. Writes can't disturb its unused bits since they're past length().
+    template <std::size_t N, typename T>
+    arrow_bitmap_mut_view(compact_bitset<N, T> &bs) noexcept : arrow_bitmap_view(bs) {}
+
+    std::uint8_t * data() const noexcept { return mptr(); }
+    arrow_bitmap_mut_view slice(std::size_t i, std::size_t n) const {
+        arrow_bitmap_view::slice(i, n); // range check
+        return arrow_bitmap_mut_view(mptr(), off + i, n);
+    }
+    arrow_bitmap_mut_view & set(std::size_t i, bool value = true) {
+        if (i >= len) throw std::out_of_range("Out-of-range bit position specified to arrow_bitmap_mut_view");
+        std::uint8_t &b = mptr()[(off + i) / 8];
+        const std::uint8_t mask = std::uint8_t(1u << ((off + i) % 8));
+        b = value ? std::uint8_t(b | mask) : std::uint8_t(b & ~mask);
+        return *this;
+    }
+    /// Store the low n bits of w (n <= 64) to bits [i, i + n), clipped to length()
+    void store(std::size_t i, std::uint64_t w, unsigned n = 64) noexcept {
+        if (i >= len) return;
+        n = unsigned(std::min<std::size_t>(n, len - i));
+        const std::size_t a = off + i;
+        std::uint8_t *p = mptr() + a / 8;
+        if (a % 8 == 0 && n == 64) {
+            arrow_bitmap_detail::store_le64(p, w);
+            return;
+        }
+        // read-modify-write the (at most 9) bytes touched
+        const unsigned sh = a % 8;
+        for (unsigned done = 0, k = 0; done < n; ++k) {
+            const unsigned lo = k ? 0 : sh, nb = std::min(8 - lo, n - done);
+            const std::uint8_t mask = std::uint8_t(bit_util::low_mask(nb) << lo);
+            p[k] = std::uint8_t((p[k] & ~mask) | ((w >> done << lo) & mask));
+            done += nb;
+        }
+    }
+};
+
+/// An owned Arrow-layout bitmap: zero-initialized, with its buffer 64-byte aligned and padded to a multiple of
+/// 64 bytes as Arrow recommends, so it can be exported to Arrow as is (offset 0).
+class arrow_bitmap
+{
+    struct deleter { void operator()(std::uint8_t *p) const noexcept { std::free(p); } };
+    std::unique_ptr<std::uint8_t[], deleter> buf;
+    std::size_t len = 0, nbytes = 0;
+public:
+    arrow_bitmap() noexcept = default;
+    explicit arrow_bitmap(std::size_t length, bool value = false) : len(length) {
+        const std::size_t a = arrow_bitmap_detail::Alignment;
+        nbytes = std::max<std::size_t>(1, ((length + 7) / 8 + a - 1) / a) * a;
+        buf.reset(static_cast<std::uint8_t *>(std::aligned_alloc(a, nbytes)));
+        if (!buf) throw std::bad_alloc();
+        std::memset(buf.get(), 0, nbytes);
+        if (value) {
+            std::memset(buf.get(), 0xFF, length / 8);
+            if (length % 8) buf[length / 8] = std::uint8_t(bit_util::low_mask(unsigned(length % 8)));
+        }
+    }
+    /// Copy of a view, realigned to offset 0
+    explicit arrow_bitmap(const arrow_bitmap_view &v) : arrow_bitmap(v.length()) {
+        for (std::size_t i = 0; i < len; i += 64) arrow_bitmap_detail::store_le64(buf.get() + i / 8, v.load(i));
+    }
+    arrow_bitmap(arrow_bitmap &&) noexcept = default;
+    arrow_bitmap & operator=(arrow_bitmap &&) noexcept = default;
+    arrow_bitmap(const arrow_bitmap &o) : arrow_bitmap(o.view()) {}
+    arrow_bitmap & operator=(const arrow_bitmap &o) { return *this = arrow_bitmap(o); }
+
+    std::size_t length() const noexcept { return len; }
+    /// Size of the (padded) buffer in bytes
+    std::size_t byte_size() const noexcept { return nbytes; }
+    const std::uint8_t * data() const noexcept { return buf.get(); }
+    std::uint8_t * data() noexcept { return buf.get(); }
+    arrow_bitmap_view view() const noexcept { return arrow_bitmap_view(buf.get(), 0, len); }
+    arrow_bitmap_mut_view mut_view() noexcept { return arrow_bitmap_mut_view(buf.get(), 0, len); }
+    operator arrow_bitmap_view() const noexcept { return view(); }
+    operator arrow_bitmap_mut_view() noexcept { return mut_view(); }
+};
+
+/// Kernels over Arrow-layout bitmaps with arbitrary bit offsets
+namespace arrow_ops {
+
+namespace detail {
+inline void check_lengths(std::size_t a, std::size_t b) {
+    if (a != b) throw std::invalid_argument("arrow_ops: bitmap lengths differ");
+}
+// out = op(a, b), one 64-bit chunk at a time, with the chunks lined up on out's byte boundaries
+template <typename Op>
+void apply(const arrow_bitmap_view a, const arrow_bitmap_view b, arrow_bitmap_mut_view out, Op op) {
+    check_lengths(a.length(), out.length());
+    check_lengths(b.length(), out.length());
+    const std::size_t n = out.length();
+    std::size_t i = std::min<std::size_t>(n, (8 - out.offset() % 8) % 8);
+    if (i) out.store(0, op(a.load(0, unsigned(i)), b.load(0, unsigned(i))), unsigned(i));
+    // the bulk: while 9 bytes past every position are inside the bitmaps, no bounds checks are needed, and out's
+    // position is byte-aligned so each result is a single 8-byte store
+    const std::uint8_t *pa = a.data(), *pb = b.data();
+    std::uint8_t *po = out.data();
+    for (; i + 72 <= n; i += 64)
+        arrow_bitmap_detail::store_le64(po + (out.offset() + i) / 8,
+                                        op(arrow_bitmap_detail::load_bits(pa, a.offset() + i), arrow_bitmap_detail::load_bits(pb, b.offset() + i)));
+    for (; i < n; i += 64) out.store(i, op(a.load(i), b.load(i)), unsigned(std::min<std::size_t>(64, n - i)));
+}
+template <typename Op>
+std::size_t count_op(const arrow_bitmap_view a, const arrow_bitmap_view b, Op op) {
+    check_lengths(a.length(), b.length());
+    const std::size_t n = a.length();
+    std::size_t ret = 0, i = 0;
+    for (; i + 72 <= n; i += 64) // see apply()
+        ret += unsigned(bit_util::popcount(op(arrow_bitmap_detail::load_bits(a.data(), a.offset() + i),
+                                              arrow_bitmap_detail::load_bits(b.data(), b.offset() + i))));
+    for (; i < n; i += 64) ret += unsigned(bit_util::popcount(op(a.load(i), b.load(i))));
+    return ret;
+}
+struct and_op { std::uint64_t operator()(std::uint64_t x, std::uint64_t y) const noexcept { return x & y; } };
+struct or_op { std::uint64_t operator()(std::uint64_t x, std::uint64_t y) const noexcept { return x | y; } };
+struct and_not_op { std::uint64_t operator()(std::uint64_t x, std::uint64_t y) const noexcept { return x & ~y; } };
+} // namespace detail
+
+/// Number of set bits (for a validity bitmap, the non-null count; the null count is length() - count())
+inline std::size_t count(const arrow_bitmap_view &v) noexcept {
+    return detail::count_op(v, v, detail::and_op{});
+}
+/// Number of set bits in a & b / a | b, without materializing it
+inline std::size_t count_and(const arrow_bitmap_view &a, const arrow_bitmap_view &b) { return detail::count_op(a, b, detail::and_op{}); }
+inline std::size_t count_or(const arrow_bitmap_view &a, const arrow_bitmap_view &b) { return detail::count_op(a, b, detail::or_op{}); }
+
+/// out = a & b, a | b, a & ~b. All three must have the same length; their offsets may all differ. `out` may alias an
+/// input only if it is the very same bits (same buffer and offset).
+/// @throws std::invalid_argument if the lengths differ
+inline void bitmap_and(const arrow_bitmap_view &a, const arrow_bitmap_view &b, arrow_bitmap_mut_view out) { detail::apply(a, b, out, detail::and_op{}); }
+inline void bitmap_or(const arrow_bitmap_view &a, const arrow_bitmap_view &b, arrow_bitmap_mut_view out) { detail::apply(a, b, out, detail::or_op{}); }
+inline void bitmap_and_not(const arrow_bitmap_view &a, const arrow_bitmap_view &b, arrow_bitmap_mut_view out) { detail::apply(a, b, out, detail::and_not_op{}); }
+
+/// Copy src into dst (same length, any offsets)
+inline void copy(const arrow_bitmap_view &src, arrow_bitmap_mut_view dst) { detail::apply(src, src, dst, detail::and_op{}); }
+
+/// true if the two views hold the same bits, regardless of their offsets
+inline bool equal(const arrow_bitmap_view &a, const arrow_bitmap_view &b) noexcept {
+    if (a.length() != b.length()) return false;
+    for (std::size_t i = 0; i < a.length(); i += 64)
+        if (a.load(i) != b.load(i)) return false;
+    return true;
+}
+
+/// Copy a view into a compact_bitset of the same size (works on any host byte order)
+template <std::size_t N, typename T = typename compact_bitset<N>::word_type>
+compact_bitset<N, T> to_bitset(const arrow_bitmap_view &v) {
+    detail::check_lengths(v.length(), N);
+    compact_bitset<N, T> ret;
+    bitset_word_sink<N, T> sink(ret);
+    for (std::size_t i = 0; i < N; i += 64) sink.put(i / 64, v.load(i));
+    return ret;
+}
+
+} // namespace arrow_ops
@@ -0,0 +1,206 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "compact_bitset.h"
+
+#include <array>
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+// How threads sleep in atomic_bitset::wait_*: C++20 std::atomic::wait where the library has it, else a futex on
+// Linux, else a mutex + condition variable. Define one of the 3 macros below to 1 to force a choice.
+#if !COMPACT_BITSET_WAIT_ATOMIC && !COMPACT_BITSET_WAIT_FUTEX && !COMPACT_BITSET_WAIT_CONDVAR
+#if defined(__cpp_lib_atomic_wait)
+#define COMPACT_BITSET_WAIT_ATOMIC 1
+#elif defined(__linux__)
+#define COMPACT_BITSET_WAIT_FUTEX 1
+#else
+#define COMPACT_BITSET_WAIT_CONDVAR 1
+#endif
+#endif
+#if COMPACT_BITSET_WAIT_FUTEX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif COMPACT_BITSET_WAIT_CONDVAR
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace atomic_bitset_detail {
+/// A 32-bit generation counter that threads can sleep on until it changes: the one primitive that all the
+/// atomic_bitset waits are built on (futexes and most std::atomic::wait implementations work on 32-bit words).
+class wait_word {
+    std::atomic<std::uint32_t> gen{0};
+    std::atomic<std::uint32_t> nwaiters{0}; ///< lets bump() skip the wake-up (a syscall) when nobody is waiting
+#if COMPACT_BITSET_WAIT_CONDVAR
+    std::mutex mut;
+    std::condition_variable cond;
+#endif
+public:
+    std::uint32_t load() const noexcept { return gen.load(); }
+
+    /// sleeps until the generation is no longer `seen` (may also return spuriously)
+    void wait(std::uint32_t seen) noexcept {
+        nwaiters.fetch_add(1);
+        if (gen.load() == seen) {
+#if COMPACT_BITSET_WAIT_ATOMIC
+            gen.wait(seen);
+#elif COMPACT_BITSET_WAIT_FUTEX
+            static_assert(sizeof(gen) == sizeof(std::uint32_t) && std::atomic<std::uint32_t>::is_always_lock_free);
+            // returns at once with EAGAIN if gen != seen by the time the kernel looks; EINTR is a spurious wake-up
+            syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&gen), FUTEX_WAIT_PRIVATE, seen, nullptr, nullptr, 0);
+#else
+            std::unique_lock g(mut);
+            cond.wait(g, [&] { return gen.load() != seen; });
+#endif
+        }
+        nwaiters.fetch_sub(1);
+    }
+
+    /// advances the generation and wakes every waiter
+    void bump() noexcept {
+        gen.fetch_add(1);
+        if (!nwaiters.load()) return;
+#if COMPACT_BITSET_WAIT_ATOMIC
+        gen.notify_all();
+#elif COMPACT_BITSET_WAIT_FUTEX
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&gen), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+        { std::lock_guard g(mut); } // a waiter is either before its gen check or inside cond.wait()
+        cond.notify_all();
+#endif
+    }
+};
+} // namespace atomic_bitset_detail
+
+/// A fixed-size bitset of std::atomic<T> words, whose bits can be used as flags that other threads sleep on.
+///
+/// set/reset/flip(pos) are single atomic read-modify-writes returning the bit's previous value; load() and store()
+/// convert from/to compact_bitset<N, T> one word at a time (so neither is a snapshot across words). All operations
+/// are sequentially consistent.
+///
+/// wait_until_set(pos), wait_any(mask) and wait_all(mask) block until the condition holds, sleeping rather than
+/// spinning. Like std::atomic::wait they must be paired with a notify: a writer calls notify(pos) (or notify_all())
+/// after changing bits, or uses set_and_notify(pos). All waits on one atomic_bitset share a single 32-bit wait word,
+/// so a notify wakes every waiter to re-check its condition; notify() is just an atomic increment when nobody is
+/// waiting. T must be at least 32 bits wide.
+template <std::size_t N, typename T = std::uint64_t>
+class atomic_bitset
+{
+public:
+    using bitset_type = compact_bitset<N, T>;
+
+private:
+    static_assert(std::is_unsigned_v<T> && sizeof(T) >= 4, "atomic_bitset needs an unsigned word type of at least 32 bits");
+    static constexpr std::size_t NWords = bitset_type::num_words();
+    static constexpr std::size_t TBits = bitset_type::word_bits;
+    std::array<std::atomic<T>, NWords> words{};
+    atomic_bitset_detail::wait_word waitWord;
+
+    static constexpr T mask(std::size_t pos) noexcept { return T(T(1) << pos % TBits); }
+    static void throw_if_out_of_range(std::size_t pos) {
+        if (pos >= N) throw std::out_of_range("Out-of-range bit position specified to atomic_bitset");
+    }
+    // sleeps until pred(*this) holds
+    template <typename Pred>
+    void wait_for_condition(Pred && pred) noexcept {
+        while (true) {
+            const std::uint32_t seen = waitWord.load(); // read before the check, so that no notify can be missed
+            if (pred()) return;
+            waitWord.wait(seen);
+        }
+    }
+
+public:
+    atomic_bitset() noexcept = default;
+    explicit atomic_bitset(const bitset_type &bs) noexcept { store(bs); }
+    atomic_bitset(const atomic_bitset &) = delete;
+    atomic_bitset & operator=(const atomic_bitset &) = delete;
+
+    static constexpr std::size_t size() noexcept { return N; }
+
+    bool test(std::size_t pos) const { throw_if_out_of_range(pos); return words[pos / TBits].load() & mask(pos); }
+    /// the following 3 return the previous value of the bit
+    bool set(std::size_t pos) { throw_if_out_of_range(pos); return words[pos / TBits].fetch_or(mask(pos)) & mask(pos); }
+    bool reset(std::size_t pos) { throw_if_out_of_range(pos); return words[pos / TBits].fetch_and(T(~mask(pos))) & mask(pos); }
+    bool flip(std::size_t pos) { throw_if_out_of_range(pos); return words[pos / TBits].fetch_xor(mask(pos)) & mask(pos); }
+
+    bitset_type load() const noexcept {
+        bitset_type ret;
+        for (std::size_t w = 0; w < NWords; ++w) ret.set_word(w, words[w].load());
+        return ret;
+    }
+    void store(const bitset_type &bs) noexcept {
+        for (std::size_t w = 0; w < NWords; ++w) words[w].store(bs.word(w));
+    }
+    void reset() noexcept {
+        for (auto &w : words) w.store(0);
+    }
+    std::size_t count() const noexcept { return load().count(); }
+
+    /// wakes the threads waiting on this bitset, so they re-check their condition. pos is only range-checked:
+    /// waiters on any bit are woken.
+    void notify(std::size_t pos) { throw_if_out_of_range(pos); waitWord.bump(); }
+    void notify_all() noexcept { waitWord.bump(); }
+    /// set(pos) followed by notify(pos); returns the previous value of the bit
+    bool set_and_notify(std::size_t pos) { const bool ret = set(pos); waitWord.bump(); return ret; }
+
+    /// blocks until bit pos is set
+    void wait_until_set(std::size_t pos) {
+        throw_if_out_of_range(pos);
+        const auto &w = words[pos / TBits];
+        const T m = mask(pos);
+        wait_for_condition([&] { return w.load() & m; });
+    }
+    /// blocks until at least one bit of mask is set, and returns the bits of mask that were set at that point.
+    /// An empty mask returns at once.
+    bitset_type wait_any(const bitset_type &mask) noexcept {
+        bitset_type ret;
+        if (mask.none()) return ret;
+        wait_for_condition([&] {
+            bool any = false;
+            for (std::size_t w = 0; w < NWords; ++w) {
+                const T hit = T(words[w].load() & mask.word(w));
+                ret.set_word(w, hit);
+                any = any || hit;
+            }
+            return any;
+        });
+        return ret;
+    }
+    /// blocks until every bit of mask is set
+    void wait_all(const bitset_type &mask) noexcept {
+        wait_for_condition([&] {
+            for (std::size_t w = 0; w < NWords; ++w)
+                if (const T m = mask.word(w); (words[w].load() & m) != m) return false;
+            return true;
+        });
+    }
+};
@@ -0,0 +1,586 @@
+#include "arrow_bitmap.h"
+#include "atomic_bitset.h"
+#include "bitset_io.h"
+#if __has_include(<unistd.h>) // POSIX only
+#include "bitset_loader.h"
+#endif
+#include "bitset_text.h"
+#include "compact_bitset.h"
+#if __has_include(<unistd.h>) // POSIX only
+#include "disk_bitset.h"
+#endif
+#include "ewah_bitset.h"
+#include "list_ops.h"
+#include "packed_int_vector.h"
+#include "per_core_bitset.h"
+#include "priority_scheduler.h"
+#include "rcu_bitset.h"
+#include "sharded_bitset.h"
+#include "snapshot_stream.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <shared_mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+volatile std::uint64_t sink; // defeat dead-code elimination of the benchmark loops
+
+/// Run `f` `iters` times and print the average time per iteration, per item.
+template <typename F>
+void bench(const char *name, std::size_t items, std::size_t iters, F && f)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iters; ++i) f();
+    const auto t1 = std::chrono::steady_clock::now();
+    const double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    std::printf("%-48s %8.3f ns/item\n", name, ns / double(iters) / double(items));
+}
+
+/// Run f(t) on nthreads threads, t = 0 .. nthreads - 1, and wait for all of them.
+template <typename F>
+void run_threads(std::size_t nthreads, F && f)
+{
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < nthreads; ++t) threads.emplace_back([&f, t] { f(t); });
+    for (auto &th : threads) th.join();
+}
+
+template <std::size_t Width, typename Plain>
+void bench_packed_int_vector()
+{
+    constexpr std::size_t n = 1 << 20, iters = 20;
+    std::mt19937_64 rng(Width);
+    std::vector<Plain> plain(n);
+    for (auto &v : plain) v = Plain(rng() & ((std::uint64_t(1) << Width) - 1));
+    packed_int_vector<Width> packed(n);
+    packed.pack(0, n, plain.data());
+    packed_int_vector<0> rtpacked(Width, n);
+    rtpacked.pack(0, n, plain.data());
+    std::vector<Plain> out(n);
+
+    std::printf("--- %zu-bit values, %zu items: plain %zu bytes, packed %zu bytes\n", Width, n, n * sizeof(Plain), packed.bits_size());
+    char name[64];
+    std::snprintf(name, sizeof(name), "std::vector<uint%zu_t> sum", sizeof(Plain) * 8);
+    bench(name, n, iters, [&] { std::uint64_t s = 0; for (auto v : plain) s += v; sink = s; });
+    std::snprintf(name, sizeof(name), "packed_int_vector<%zu> operator[] sum", Width);
+    bench(name, n, iters, [&] { std::uint64_t s = 0; for (std::size_t i = 0; i < n; ++i) s += packed[i]; sink = s; });
+    std::snprintf(name, sizeof(name), "packed_int_vector<%zu> unpack", Width);
+    bench(name, n, iters, [&] { packed.unpack(0, n, out.data()); sink = out[n / 2]; });
+    std::snprintf(name, sizeof(name), "packed_int_vector<0>(%zu) unpack", Width);
+    bench(name, n, iters, [&] { rtpacked.unpack(0, n, out.data()); sink = out[n / 2]; });
+    std::snprintf(name, sizeof(name), "packed_int_vector<%zu> pack", Width);
+    bench(name, n, iters, [&] { packed.pack(0, n, plain.data()); sink = packed.bits_size(); });
+}
+
+/// Validity-mask-like data: long runs of valid (1) and null (0) words, with occasional noisy stretches.
+std::vector<std::uint64_t> make_run_heavy(std::size_t nwords, std::uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<std::uint64_t> words(nwords);
+    for (std::size_t i = 0; i < nwords; ) {
+        const std::size_t len = std::min<std::size_t>(nwords - i, 1 + rng() % 2000);
+        const int kind = rng() % 10 == 0 ? 2 : int(rng() % 2); // 10% of stretches are noise
+        for (std::size_t j = 0; j < len; ++j, ++i) words[i] = kind == 0 ? 0 : kind == 1 ? ~std::uint64_t(0) : rng();
+    }
+    return words;
+}
+
+void bench_ewah_bitset()
+{
+    constexpr std::size_t N = std::size_t(1) << 22, NWords = N / 64, iters = 10;
+    const auto wa = make_run_heavy(NWords, 1), wb = make_run_heavy(NWords, 2);
+    const ewah_bitset a(wa, N), b(wb, N);
+    auto ca = std::make_unique<compact_bitset<N>>(), cb = std::make_unique<compact_bitset<N>>();
+    for (std::size_t i = 0; i < NWords; ++i) { ca->set_word(i, wa[i]); cb->set_word(i, wb[i]); }
+    std::vector<std::uint64_t> out(NWords);
+    std::printf("--- run-heavy %zu-bit masks: raw %zu bytes, ewah %zu + %zu bytes\n", N, NWords * 8, a.bits_size(), b.bits_size());
+    bench("raw word array AND", N, iters, [&] { for (std::size_t i = 0; i < NWords; ++i) out[i] = wa[i] & wb[i]; sink = out[NWords / 2]; });
+    bench("compact_bitset operator&", N, iters, [&] { const auto r = std::make_unique<compact_bitset<N>>(*ca & *cb); sink = r->word(0); });
+    bench("ewah_bitset operator&", N, iters, [&] { sink = (a & b).bits_size(); });
+    bench("ewah_bitset operator|", N, iters, [&] { sink = (a | b).bits_size(); });
+    bench("ewah_bitset operator^", N, iters, [&] { sink = (a ^ b).bits_size(); });
+    bench("ewah_bitset count", N, iters, [&] { sink = a.count(); });
+    bench("ewah_bitset(words) compress", N, iters, [&] { sink = ewah_bitset(wa, N).bits_size(); });
+}
+
+void bench_list_ops()
+{
+    constexpr std::size_t N = std::size_t(1) << 24, iters = 20;
+    std::mt19937_64 rng(84);
+    auto bs = std::make_unique<compact_bitset<N>>();
+    for (std::size_t i = 0; i < bs->num_words(); ++i) bs->set_word(i, rng() & rng());
+    std::vector<std::uint32_t> list;
+    for (std::uint32_t v = 0; list.size() < 10000; v += 1 + std::uint32_t(rng() % 1600)) list.push_back(v);
+    std::printf("--- %zu-element sorted list vs %zu-bit bitset\n", list.size(), N);
+    bench("list -> bitset, then AND (per list item)", list.size(), iters, [&] {
+        auto tmp = std::make_unique<compact_bitset<N>>();
+        list_ops::set_all(*tmp, list.data(), list.size());
+        for (std::size_t i = 0; i < tmp->num_words(); ++i) tmp->set_word(i, tmp->word(i) & bs->word(i));
+        sink = tmp->word(1);
+    });
+    bench("list_ops::intersect (per list item)", list.size(), iters, [&] { sink = list_ops::intersect(list, *bs).size(); });
+    bench("list_ops::difference (per list item)", list.size(), iters, [&] { sink = list_ops::difference(list, *bs).size(); });
+    bench("list_ops::intersect_count (per list item)", list.size(), iters, [&] { sink = list_ops::intersect_count(list, *bs); });
+}
+
+void bench_snapshot_stream()
+{
+    constexpr std::size_t N = 4096, nsnaps = 10000, iters = 5;
+    std::mt19937_64 rng(86);
+    std::vector<compact_bitset<N>> snaps(nsnaps);
+    compact_bitset<N> cur;
+    for (auto &snap : snaps) {
+        for (std::size_t i = 0, n = rng() % 4; i < n; ++i) cur.flip(rng() % N);
+        snap = cur;
+    }
+    snapshot_encoder<N> enc0;
+    for (const auto &snap : snaps) enc0.append(snap);
+    const auto ss = enc0.finish();
+    std::printf("--- %zu snapshots of compact_bitset<%zu>, 0-3 bit flips each: raw %zu bytes, encoded %zu bytes\n",
+                nsnaps, N, nsnaps * snaps[0].bits_size(), ss.bytes_used());
+    bench("snapshot_encoder::append (per snapshot)", nsnaps, iters, [&] {
+        snapshot_encoder<N> enc;
+        for (const auto &snap : snaps) enc.append(snap);
+        sink = enc.bit_size();
+    });
+    bench("snapshot_stream cursor decode (per snapshot)", nsnaps, iters, [&] {
+        auto c = ss.begin_decode();
+        while (c.has_next()) sink = c.next_snapshot().word(0);
+    });
+    bench("snapshot_stream::at random access (per snapshot)", 1000, iters, [&] {
+        for (std::size_t i = 0; i < 1000; ++i) sink = ss.at(rng() % nsnaps).word(0);
+    });
+}
+
+void bench_bitset_io()
+{
+    constexpr std::size_t N = 1 << 24, iters = 5;
+    std::mt19937_64 rng(87);
+    // a quarter each of empty, sparse (0.1%), run-heavy and random 64Ki-bit blocks
+    auto bs = std::make_unique<compact_bitset<N>>();
+    for (std::size_t i = 0; i < N; ++i) {
+        const std::size_t block = i / 65536;
+        bs->set(i, block % 4 == 1 ? rng() % 1000 == 0 : block % 4 == 2 ? (i / 5000) % 2 : block % 4 == 3 && rng() % 2);
+    }
+    for (const auto enc : {bitset_io::encoding::raw, bitset_io::encoding::compressed}) {
+        const bool raw = enc == bitset_io::encoding::raw;
+        std::stringstream buf;
+        bitset_io::write(buf, *bs, enc);
+        const std::string bytes = buf.str();
+        std::printf("--- bitset_io %s, %zu bits: %zu bytes\n", raw ? "raw" : "compressed", N, bytes.size());
+        bench(raw ? "bitset_io::write raw (per 64 bits)" : "bitset_io::write compressed (per 64 bits)", N / 64, iters, [&] {
+            std::stringstream os;
+            bitset_io::write(os, *bs, enc);
+            sink = std::uint64_t(os.tellp());
+        });
+        auto back = std::make_unique<compact_bitset<N>>();
+        bench(raw ? "bitset_io::read raw (per 64 bits)" : "bitset_io::read compressed (per 64 bits)", N / 64, iters, [&] {
+            std::stringstream is(bytes);
+            bitset_io::read(is, *back);
+            sink = back->word(0);
+        });
+    }
+}
+
+#if __has_include(<unistd.h>) // POSIX only
+void bench_disk_bitset()
+{
+    namespace fs = std::filesystem;
+    constexpr std::size_t nwords = std::size_t(1) << 23, iters = 3; // 64 MiB per file
+    const fs::path dir = fs::temp_directory_path() / ("compact_bitset_bench_" + std::to_string(::getpid()));
+    fs::create_directories(dir);
+    std::mt19937_64 rng(88);
+    std::vector<std::string> paths;
+    std::vector<std::uint64_t> words(1 << 16);
+    for (int f = 0; f < 2; ++f) {
+        paths.push_back((dir / ("in" + std::to_string(f))).string());
+        disk_bitset::file_writer w(paths.back());
+        for (std::size_t i = 0; i < nwords; i += words.size()) {
+            for (auto &x : words) x = rng();
+            w.append(words.data(), words.size());
+        }
+    }
+    std::printf("--- disk_bitset, 2 files of %zu MiB (likely page-cached)\n", nwords * 8 >> 20);
+    bench("disk_bitset::count (per word)", nwords, iters, [&] { sink = disk_bitset::count(paths[0]); });
+    bench("disk_bitset::count_and 2 files (per word)", nwords, iters, [&] { sink = disk_bitset::count_and(paths); });
+    bench("disk_bitset::write_or 2 files (per word)", nwords, iters, [&] {
+        sink = disk_bitset::write_or(paths, (dir / "out").string());
+    });
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+#endif
+
+void bench_arrow_bitmap()
+{
+    constexpr std::size_t n = std::size_t(1) << 24, iters = 20;
+    std::mt19937_64 rng(90);
+    arrow_bitmap a(n + 64), b(n + 64), out(n + 64);
+    for (std::size_t i = 0; i < a.byte_size(); ++i) a.data()[i] = std::uint8_t(rng()), b.data()[i] = std::uint8_t(rng());
+    std::printf("--- Arrow bitmaps of %zu bits\n", n);
+    bench("arrow_ops::bitmap_and, aligned (per 64 bits)", n / 64, iters, [&] {
+        arrow_ops::bitmap_and(a.view().slice(0, n), b.view().slice(0, n), out.mut_view().slice(0, n));
+        sink = out.data()[0];
+    });
+    bench("arrow_ops::bitmap_and, offs 3/17/5 (per 64 bits)", n / 64, iters, [&] {
+        arrow_ops::bitmap_and(a.view().slice(3, n), b.view().slice(17, n), out.mut_view().slice(5, n));
+        sink = out.data()[0];
+    });
+    bench("arrow_ops::count_and, offs 3/17 (per 64 bits)", n / 64, iters, [&] {
+        sink = arrow_ops::count_and(a.view().slice(3, n), b.view().slice(17, n));
+    });
+}
+
+void bench_bitset_text()
+{
+    constexpr std::size_t N = 1 << 16, iters = 200;
+    std::mt19937_64 rng(91);
+    auto bs = std::make_unique<compact_bitset<N>>();
+    for (std::size_t i = 0; i < N; ++i) bs->set(i, rng() % 2);
+    const std::string hex = to_hex(*bs), b64 = to_base64(*bs);
+    std::string buf(N, '\0');
+    auto back = std::make_unique<compact_bitset<N>>();
+    std::printf("--- compact_bitset<%zu> text encodings\n", N);
+    bench("to_string (per 64 bits)", N / 64, iters, [&] { sink = bs->to_string().size(); });
+    bench("to_hex into buffer (per 64 bits)", N / 64, iters, [&] { sink = std::uint64_t(to_hex(*bs, buf.data()) - buf.data()); });
+    bench("to_base64 into buffer (per 64 bits)", N / 64, iters, [&] { sink = std::uint64_t(to_base64(*bs, buf.data()) - buf.data()); });
+    bench("from_hex (per 64 bits)", N / 64, iters, [&] { sink = std::uint64_t(from_hex(hex, *back)) + back->word(0); });
+    bench("from_base64 (per 64 bits)", N / 64, iters, [&] { sink = std::uint64_t(from_base64(b64, *back)) + back->word(0); });
+}
+
+#if __has_include(<unistd.h>) // POSIX only
+void bench_bitset_loader()
+{
+    constexpr std::size_t N = 256, nlines = 200000, iters = 3;
+    std::mt19937_64 rng(93);
+    std::string text;
+    text.reserve(nlines * (N + 1));
+    compact_bitset<N> bs;
+    for (std::size_t i = 0; i < nlines; ++i) {
+        for (std::size_t j = 0; j < N; ++j) bs.set(j, rng() % 2);
+        text += bs.to_string();
+        text += '\n';
+    }
+    std::printf("--- %zu lines of compact_bitset<%zu> text\n", nlines, N);
+    bench("operator>> loop (per line)", nlines, iters, [&] {
+        std::istringstream is(text);
+        std::vector<compact_bitset<N>> out;
+        compact_bitset<N> cur;
+        while (is >> cur) out.push_back(cur), is.ignore();
+        sink = out.size();
+    });
+    for (unsigned nthreads : {1u, 4u}) {
+        bitset_load_options opts;
+        opts.nthreads = nthreads;
+        bench(nthreads == 1 ? "parse_bitset_lines, 1 thread (per line)" : "parse_bitset_lines, 4 threads (per line)", nlines, iters,
+              [&] { sink = parse_bitset_lines<N>(text, opts).bitsets.size(); });
+    }
+}
+#endif
+
+void bench_bounds_check()
+{
+    constexpr std::size_t N = 1 << 16, nidx = 1 << 14, iters = 200;
+    std::mt19937_64 rng(94);
+    std::vector<std::uint32_t> idx(nidx);
+    for (auto &i : idx) i = std::uint32_t(rng() % N);
+    auto bs = std::make_unique<compact_bitset<N>>();
+    std::printf("--- compact_bitset<%zu> random access, COMPACT_BITSET_BOUNDS_CHECK=%d\n", N, COMPACT_BITSET_BOUNDS_CHECK);
+    bench("set + flip (per index)", nidx, iters, [&] { for (const auto i : idx) bs->set(i).flip(i ^ 1); sink = bs->word(0); });
+    bench("set_unchecked + flip_unchecked (per index)", nidx, iters, [&] {
+        for (const auto i : idx) bs->set_unchecked(i).flip_unchecked(i ^ 1);
+        sink = bs->word(0);
+    });
+    bench("test (per index)", nidx, iters, [&] {
+        std::size_t n = 0;
+        for (const auto i : idx) n += bs->test(i);
+        sink = n;
+    });
+    bench("test_unchecked (per index)", nidx, iters, [&] {
+        std::size_t n = 0;
+        for (const auto i : idx) n += bs->test_unchecked(i);
+        sink = n;
+    });
+}
+
+// a vector of single-word bitsets vs. the same bits stored as 8 byte-words each (which takes the multi-word paths)
+template <typename T>
+void bench_single_word_ops(const char *label)
+{
+    constexpr std::size_t n = 1 << 12, iters = 500;
+    using CB = compact_bitset<64, T>;
+    std::mt19937_64 rng(95);
+    std::vector<CB> a(n), b(n);
+    for (std::size_t i = 0; i < n; ++i) a[i] = CB(rng()), b[i] = CB(rng());
+    std::printf("--- compact_bitset<64, %s> x %zu\n", label, n);
+    bench("count (per bitset)", n, iters, [&] {
+        std::size_t c = 0;
+        for (const auto &x : a) c += x.count();
+        sink = c;
+    });
+    bench("== (per pair)", n, iters, [&] {
+        std::size_t c = 0;
+        for (std::size_t i = 0; i < n; ++i) c += a[i] == b[i];
+        sink = c;
+    });
+    bench("a & b, a ^ b, << 3, count (per pair)", n, iters, [&] {
+        std::size_t c = 0;
+        for (std::size_t i = 0; i < n; ++i) c += (((a[i] & b[i]) ^ a[i]) << 3).count();
+        sink = c;
+    });
+}
+
+// threads setting random bits: one shared atomic bitset vs. per_core_bitset shards, packed and cache-line padded
+void bench_per_core_bitset()
+{
+    constexpr std::size_t N = 256, nops = 1 << 16, iters = 20;
+    const std::size_t nthreads = std::max(4u, std::thread::hardware_concurrency());
+    std::vector<std::uint32_t> pos(nops);
+    std::mt19937_64 rng(96);
+    for (auto &p : pos) p = std::uint32_t(rng() % N);
+    const std::size_t items = nthreads * nops;
+    std::printf("--- %zu threads x %zu random sets into a %zu-bit bitset\n", nthreads, nops, N);
+    std::array<std::atomic<std::uint64_t>, N / 64> shared{};
+    bench("one shared atomic bitset (fetch_or)", items, iters, [&] {
+        run_threads(nthreads, [&](std::size_t) { for (const auto p : pos) shared[p / 64].fetch_or(std::uint64_t(1) << p % 64); });
+        sink = shared[0].load();
+    });
+    per_core_bitset<N, std::uint64_t, 1> packed(nthreads);
+    bench("per_core_bitset, packed shards (set_in)", items, iters, [&] {
+        run_threads(nthreads, [&](std::size_t t) { for (const auto p : pos) packed.set_in(t, p); });
+        sink = packed.count();
+    });
+    per_core_bitset<N, std::uint64_t> padded(nthreads);
+    bench("per_core_bitset, padded shards (set_in)", items, iters, [&] {
+        run_threads(nthreads, [&](std::size_t t) { for (const auto p : pos) padded.set_in(t, p); });
+        sink = padded.count();
+    });
+    per_core_bitset<N, std::uint64_t> percpu;
+    bench("per_core_bitset, padded shards (set)", items, iters, [&] {
+        run_threads(nthreads, [&](std::size_t) { for (const auto p : pos) percpu.set(p); });
+        sink = percpu.count();
+    });
+    bench("per_core_bitset merged() (per shard)", percpu.num_shards(), 100000, [&] { sink = percpu.merged().word(0); });
+}
+
+// write scaling: 1..8 threads flipping random bits in one shared atomic bitset vs. sharded_bitset; then read costs
+void bench_sharded_bitset()
+{
+    constexpr std::size_t N = 4096, nops = 1 << 16, iters = 10;
+    std::vector<std::uint32_t> pos(nops);
+    std::mt19937_64 rng(97);
+    for (auto &p : pos) p = std::uint32_t(rng() % N);
+    std::printf("--- random bit flips in a %zu-bit bitset, %zu per thread\n", N, nops);
+    char name[64];
+    for (std::size_t nthreads = 1; nthreads <= 8; nthreads *= 2) {
+        std::array<std::atomic<std::uint64_t>, N / 64> shared{};
+        std::snprintf(name, sizeof(name), "%zu thread(s): shared atomic fetch_xor", nthreads);
+        bench(name, nthreads * nops, iters, [&] {
+            run_threads(nthreads, [&](std::size_t) { for (const auto p : pos) shared[p / 64].fetch_xor(std::uint64_t(1) << p % 64); });
+            sink = shared[0].load();
+        });
+        sharded_bitset<N, std::uint64_t> sb(nthreads);
+        std::snprintf(name, sizeof(name), "%zu thread(s): sharded_bitset writer", nthreads);
+        bench(name, nthreads * nops, iters, [&] {
+            run_threads(nthreads, [&](std::size_t) {
+                auto w = sb.make_writer();
+                for (const auto p : pos) w.flip(p);
+            });
+            sink = sb.epoch();
+        });
+    }
+    sharded_bitset<N, std::uint64_t> sb(8);
+    std::vector<sharded_bitset<N, std::uint64_t>::writer> writers;
+    for (std::size_t t = 0; t < 8; ++t) writers.push_back(sb.make_writer());
+    for (std::size_t i = 0; i < nops; ++i) writers[i % 8].set(pos[i]);
+    bench("8 shards: merged() with no writes (cached)", 1, 100000, [&] { sink = sb.merged().word(0); });
+    std::size_t i = 0;
+    bench("8 shards: merged() after a write (re-merge)", 1, 100000, [&] {
+        writers[i % 8].flip(pos[i % nops]), ++i;
+        sink = sb.merged().word(0);
+    });
+}
+
+// readers testing bits of a compact_bitset<4096> that a writer replaces now and then: shared_mutex vs. rcu_bitset
+void bench_rcu_bitset()
+{
+    constexpr std::size_t N = 4096, nops = 1 << 16, iters = 10;
+    std::vector<std::uint32_t> pos(nops);
+    std::mt19937_64 rng(98);
+    for (auto &p : pos) p = std::uint32_t(rng() % N);
+    compact_bitset<N> initial;
+    for (std::size_t i = 0; i < N; i += 3) initial.set(i);
+    std::printf("--- readers testing random bits of a %zu-bit bitset while a writer publishes\n", N);
+    char name[64];
+    for (std::size_t nreaders = 1; nreaders <= 4; nreaders *= 2) {
+        // the writer replaces the bitset in a loop until the readers are done
+        const auto with_writer = [&](auto &&publish, auto &&read) {
+            std::atomic<bool> done{false};
+            std::thread writer([&] {
+                for (std::size_t i = 0; !done; ++i) { publish(i); std::this_thread::yield(); }
+            });
+            run_threads(nreaders, read);
+            done = true;
+            writer.join();
+        };
+        std::shared_mutex mut;
+        compact_bitset<N> locked = initial;
+        std::snprintf(name, sizeof(name), "%zu reader(s): shared_mutex + test", nreaders);
+        bench(name, nreaders * nops, iters, [&] {
+            with_writer([&](std::size_t i) { std::unique_lock g(mut); locked.flip(i % N); },
+                        [&](std::size_t) {
+                            std::size_t n = 0;
+                            for (const auto p : pos) { std::shared_lock g(mut); n += locked.test(p); }
+                            sink = n;
+                        });
+        });
+        rcu_bitset<N> rcu(nreaders, initial);
+        std::snprintf(name, sizeof(name), "%zu reader(s): rcu_bitset snapshot + test", nreaders);
+        bench(name, nreaders * nops, iters, [&] {
+            with_writer([&](std::size_t i) { rcu.update([i](auto &bs) { bs.flip(i % N); }); },
+                        [&](std::size_t) {
+                            const auto r = rcu.make_reader();
+                            std::size_t n = 0;
+                            for (const auto p : pos) n += r.read()->test(p);
+                            sink = n;
+                        });
+        });
+    }
+}
+
+// ping-pong between two threads through ready flags: atomic_bitset waits vs. spin + yield vs. mutex + condvar
+void bench_atomic_bitset()
+{
+    constexpr std::size_t N = 128, rounds = 1 << 13, iters = 5;
+    std::printf("--- two threads handing a token back and forth via ready bits (per round trip)\n");
+    atomic_bitset<N> abs;
+    // thread 0 raises even bits and waits for odd ones, thread 1 the reverse; each clears the bit it consumed
+    const auto ping_pong = [&](auto &&raise, auto &&await) {
+        run_threads(2, [&](std::size_t t) {
+            for (std::size_t r = 0; r < rounds; ++r) {
+                const std::size_t bit = 2 * r % N;
+                if (t == 0) { raise(bit); await(bit + 1); }
+                else { await(bit); raise(bit + 1); }
+            }
+        });
+    };
+    bench("atomic_bitset wait_until_set/set_and_notify", rounds, iters, [&] {
+        ping_pong([&](std::size_t b) { abs.set_and_notify(b); }, [&](std::size_t b) { abs.wait_until_set(b); abs.reset(b); });
+    });
+    bench("atomic_bitset test + yield (spin)", rounds, iters, [&] {
+        ping_pong([&](std::size_t b) { abs.set(b); }, [&](std::size_t b) {
+            while (!abs.test(b)) std::this_thread::yield();
+            abs.reset(b);
+        });
+    });
+    std::mutex mut;
+    std::condition_variable cond;
+    compact_bitset<N> flags;
+    bench("compact_bitset + mutex + condition_variable", rounds, iters, [&] {
+        ping_pong([&](std::size_t b) { { std::lock_guard g(mut); flags.set(b); } cond.notify_all(); },
+                  [&](std::size_t b) {
+                      std::unique_lock g(mut);
+                      cond.wait(g, [&] { return flags.test(b); });
+                      flags.reset(b);
+                  });
+    });
+    sink = abs.count() + flags.count();
+}
+
+// a scheduler in steady state: pop the most urgent task, push a new one at a random level (of 256)
+void bench_priority_scheduler()
+{
+    constexpr std::size_t Levels = 256, queued = 1 << 12, nops = 1 << 16, iters = 20;
+    std::vector<std::uint32_t> lvl(nops);
+    std::mt19937_64 rng(100);
+    for (auto &l : lvl) l = std::uint32_t(rng() % Levels);
+    std::printf("--- %zu priority levels, %zu queued tasks, pop + push (per pair)\n", Levels, queued);
+    // (level, -sequence number): FIFO within a level, like the schedulers
+    std::priority_queue<std::pair<std::uint32_t, std::int64_t>> pq;
+    std::int64_t seq = 0;
+    for (std::size_t i = 0; i < queued; ++i) pq.emplace(lvl[i], --seq);
+    bench("std::priority_queue", nops, iters, [&] {
+        for (const auto l : lvl) { pq.pop(); pq.emplace(l, --seq); }
+        sink = std::uint64_t(pq.top().second);
+    });
+    priority_scheduler<Levels, std::uint32_t> ps;
+    for (std::size_t i = 0; i < queued; ++i) ps.push(lvl[i], std::uint32_t(i));
+    bench("priority_scheduler", nops, iters, [&] {
+        std::uint32_t t = 0;
+        for (const auto l : lvl) { ps.try_pop(t); ps.push(l, t); }
+        sink = t;
+    });
+    // the lookup alone: highest non-empty level by scanning vs. two clz
+    priority_scheduler<Levels, std::uint32_t> sparse;
+    sparse.push(3, 0u);
+    bench("top_level(), one low level ready: scan", 1, 1000000, [&] {
+        std::size_t l = Levels;
+        while (l-- > 0 && !sparse.size(l)) {}
+        sink = l;
+    });
+    bench("top_level(), one low level ready: clz", 1, 1000000, [&] { sink = sparse.top_level(); });
+
+    char name[64];
+    for (std::size_t nthreads = 1; nthreads <= 4; nthreads *= 2) {
+        std::mutex mut;
+        std::snprintf(name, sizeof(name), "%zu thread(s): std::priority_queue + mutex", nthreads);
+        bench(name, nthreads * nops, iters / 4, [&] {
+            run_threads(nthreads, [&](std::size_t) {
+                for (const auto l : lvl) { std::lock_guard g(mut); pq.pop(); pq.emplace(l, --seq); }
+            });
+            sink = std::uint64_t(pq.top().second);
+        });
+        concurrent_priority_scheduler<Levels, std::uint32_t> cps;
+        for (std::size_t i = 0; i < queued; ++i) cps.push(lvl[i], std::uint32_t(i));
+        std::snprintf(name, sizeof(name), "%zu thread(s): concurrent_priority_scheduler", nthreads);
+        bench(name, nthreads * nops, iters / 4, [&] {
+            run_threads(nthreads, [&](std::size_t) {
+                std::uint32_t t = 0;
+                for (const auto l : lvl) { cps.try_pop(t); cps.push(l, t); }
+            });
+            sink = cps.top_level();
+        });
+    }
+}
+
+} // namespace
+
+int main()
+{
+    bench_packed_int_vector<13, std::uint16_t>();
+    bench_packed_int_vector<21, std::uint32_t>();
+    bench_ewah_bitset();
+    bench_list_ops();
+    bench_snapshot_stream();
+    bench_bitset_io();
+#if __has_include(<unistd.h>) // POSIX only
+    bench_disk_bitset();
+#endif
+    bench_arrow_bitmap();
+    bench_bitset_text();
+#if __has_include(<unistd.h>) // POSIX only
+    bench_bitset_loader();
+#endif
+    bench_bounds_check();
+    bench_single_word_ops<std::uint64_t>("uint64_t");
+    bench_single_word_ops<std::uint8_t>("uint8_t");
+    bench_per_core_bitset();
+    bench_sharded_bitset();
+    bench_rcu_bitset();
+    bench_atomic_bitset();
+    bench_priority_scheduler();
+    return 0;
+}
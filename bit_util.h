@@ -0,0 +1,85 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include <cstdint>
+
+#if defined(__BMI2__) && (defined(__x86_64__) || defined(_M_X64))
+#include <immintrin.h> // for _pdep_u64
+#endif
+
+/// Word-level helpers shared by the data structures built on top of compact_bitset-style word arrays.
+/// On gcc & clang these use intrinsics, with a portable (slow) fallback for other compilers.
+namespace bit_util {
+
+/// returns the number of set bits in w
+inline int popcount(std::uint64_t w) noexcept {
+#if defined(__clang__) || defined(__GNUC__)
+    return __builtin_popcountll(static_cast<unsigned long long>(w));
+#else
+    int ret = 0;
+    for (; w; w &= w - 1) ++ret;
+    return ret;
+#endif
+}
+
+/// returns the index of the lowest set bit in w. w must not be 0.
+inline int ctz(std::uint64_t w) noexcept {
+#if defined(__clang__) || defined(__GNUC__)
+    return __builtin_ctzll(static_cast<unsigned long long>(w));
+#else
+    int ret = 0;
+    for (; !(w & 0x1); w >>= 1) ++ret;
+    return ret;
+#endif
+}
+
+/// returns the number of leading zero bits in w. w must not be 0.
+inline int clz(std::uint64_t w) noexcept {
+#if defined(__clang__) || defined(__GNUC__)
+    return __builtin_clzll(static_cast<unsigned long long>(w));
+#else
+    int ret = 0;
+    for (; !(w & (std::uint64_t(1) << 63)); w <<= 1) ++ret;
+    return ret;
+#endif
+}
+
+/// returns the index of the highest set bit in w (floor(log2(w))). w must not be 0.
+inline int log2(std::uint64_t w) noexcept { return 63 - clz(w); }
+
+/// returns the index of the k-th (0-based) set bit in w. k must be < popcount(w).
+inline int select_in_word(std::uint64_t w, unsigned k) noexcept {
+#if defined(__BMI2__) && (defined(__x86_64__) || defined(_M_X64))
+    return ctz(_pdep_u64(std::uint64_t(1) << k, w));
+#else
+    for (; k; --k) w &= w - 1; // clear the lowest k set bits
+    return ctz(w);
+#endif
+}
+
+/// returns a mask with the low n bits set, for n in the range [0, 64]
+constexpr std::uint64_t low_mask(unsigned n) noexcept { return n >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << n) - 1; }
+
+} // namespace bit_util
@@ -0,0 +1,250 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bitset_text.h"
+#include "bitstream.h"
+#include "compact_bitset.h"
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+#if __cplusplus >= 202002L && __has_include(<format>)
+#include <format>
+#endif
+#if __has_include(<fmt/format.h>) && !defined(COMPACT_BITSET_NO_FMT)
+#include <fmt/format.h>
+#define COMPACT_BITSET_HAS_FMT 1
+#endif
+
+/// Formatting of compact_bitset for std::format (C++20) and {fmt}, writing straight to the output iterator.
+///
+/// The format spec is `[[fill]align][width][sep group][type]`:
+///  - type `b` (the default) is the to_string() text, `x` / `X` is to_hex(), and `l` is the list of set bit indices
+///    with runs collapsed, e.g. "{1,5,9-12}"
+///  - sep is `_` or `'`, and inserts that character every `group` digits (counting from the start), e.g. `{:_8b}`
+///  - fill (default ' ') and align ('<' the default, '>' or '^') pad the result out to `width`
+///
+/// Nothing is allocated: digits are generated a word at a time into a small local buffer, and when padding is
+/// needed the output length is computed with an extra pass over the bits rather than by formatting into a string.
+/// The std::formatter and fmt::formatter specializations are only defined when <format> (with __cpp_lib_format) or
+/// <fmt/format.h> is available; format_to() below works with any output iterator in C++17.
+namespace bitset_format {
+
+struct spec {
+    char fill = ' ', align = '<', sep = 0, type = 'b';
+    std::size_t width = 0, group = 0;
+};
+
+/// Parse a format spec in [first, last), stopping at a '}' or the end; returns where it stopped. On error, `error`
+/// is set to a description and the return value is meaningless. Usable at compile time.
+template <typename It>
+constexpr It parse_spec(It first, It last, spec &s, const char *&error) {
+    error = nullptr;
+    const auto is_align = [](char c) { return c == '<' || c == '>' || c == '^'; };
+    const auto parse_num = [&](std::size_t &n) {
+        for (n = 0; first != last && *first >= '0' && *first <= '9'; ++first) n = n * 10 + std::size_t(*first - '0');
+    };
+    if (first != last && first + 1 != last && is_align(first[1]) && *first != '{' && *first != '}')
+        s.fill = *first, s.align = first[1], first += 2;
+    else if (first != last && is_align(*first))
+        s.align = *first++;
+    parse_num(s.width);
+    if (first != last && (*first == '_' || *first == '\'')) {
+        s.sep = *first++;
+        parse_num(s.group);
+        if (!s.group) { error = "compact_bitset format: a group separator must be followed by a group size"; return first; }
+    }
+    if (first != last && (*first == 'b' || *first == 'x' || *first == 'X' || *first == 'l')) s.type = *first++;
+    if (first != last && *first != '}') { error = "compact_bitset format: invalid format spec"; return first; }
+    if (s.type == 'l' && s.sep) error = "compact_bitset format: grouping isn't supported for the 'l' type";
+    return first;
+}
+
+namespace detail {
+constexpr std::size_t num_digits(std::size_t v) noexcept {
+    std::size_t n = 1;
+    for (; v >= 10; v /= 10) ++n;
+    return n;
+}
+/// Call f(first, last) for each run of consecutive set bits [first, last]
+template <std::size_t N, typename T, typename F>
+void for_each_run(const compact_bitset<N, T> &bs, F &&f) {
+    const bitset_word_source<N, T> src(bs);
+    bool inRun = false;
+    std::size_t runStart = 0;
+    for (std::size_t i = 0; i < (N + 63) / 64; ++i) {
+        std::uint64_t w = src.fetch(i);
+        std::size_t pos = i * 64;
+        const std::size_t end = std::min(N, pos + 64);
+        // alternately skip to the next 1 (when not in a run) or the next 0 (when in one)
+        while (pos < end) {
+            const std::uint64_t m = inRun ? ~w : w;
+            const std::size_t next = m ? std::min(end, i * 64 + unsigned(bit_util::ctz(m))) : end;
+            if (next < end) {
+                if (inRun) f(runStart, next - 1);
+                else runStart = next;
+                inRun = !inRun;
+                // clear everything below `next` so the next search starts there
+                const unsigned sh = unsigned(next - i * 64);
+                w = inRun ? w | bit_util::low_mask(sh) : w & ~bit_util::low_mask(sh);
+            }
+            pos = next;
+        }
+    }
+    if (inRun) f(runStart, N - 1);
+}
+/// Output iterator wrapper that inserts a separator every `group` characters
+template <typename OutputIt>
+struct grouped_out {
+    OutputIt out;
+    char sep;
+    std::size_t group, col = 0;
+    void put(char c) {
+        if (group && col && col % group == 0) *out++ = sep;
+        *out++ = c;
+        ++col;
+    }
+};
+template <typename OutputIt>
+OutputIt fill(OutputIt out, char c, std::size_t n) {
+    for (; n; --n) *out++ = c;
+    return out;
+}
+} // namespace detail
+
+/// Length of the formatted text, excluding padding
+template <std::size_t N, typename T>
+std::size_t content_size(const compact_bitset<N, T> &bs, const spec &s) {
+    if (s.type == 'l') {
+        std::size_t ret = 2, runs = 0;
+        detail::for_each_run(bs, [&](std::size_t a, std::size_t b) {
+            ret += detail::num_digits(a) + (a != b ? 1 + detail::num_digits(b) : 0);
+            ++runs;
+        });
+        return ret + (runs ? runs - 1 : 0);
+    }
+    const std::size_t n = s.type == 'b' ? N : hex_size(N);
+    return n + (s.group && n ? (n - 1) / s.group : 0);
+}
+
+/// Write bs formatted per `s` to `out`, returning the end
+template <typename OutputIt, std::size_t N, typename T>
+OutputIt format_to(OutputIt out, const compact_bitset<N, T> &bs, const spec &s) {
+    std::size_t before = 0, after = 0;
+    if (s.width) {
+        const std::size_t len = content_size(bs, s), pad = s.width > len ? s.width - len : 0;
+        before = s.align == '>' ? pad : s.align == '^' ? pad / 2 : 0;
+        after = pad - before;
+    }
+    out = detail::fill(out, s.fill, before);
+    if (s.type == 'l') {
+        *out++ = '{';
+        bool first = true;
+        detail::for_each_run(bs, [&](std::size_t a, std::size_t b) {
+            char buf[48];
+            char *p = buf;
+            if (!first) *p++ = ',';
+            first = false;
+            p = std::to_chars(p, buf + sizeof(buf), a).ptr;
+            if (a != b) *p++ = '-', p = std::to_chars(p, buf + sizeof(buf), b).ptr;
+            for (const char *c = buf; c != p; ++c) *out++ = *c;
+        });
+        *out++ = '}';
+    } else {
+        detail::grouped_out<OutputIt> g{out, s.sep, s.group};
+        const bitset_word_source<N, T> src(bs);
+        if (s.type == 'b') {
+            for (std::size_t i = 0; i < (N + 63) / 64; ++i) {
+                const std::uint64_t w = src.fetch(i);
+                for (std::size_t j = 0, n = std::min<std::size_t>(64, N - i * 64); j < n; ++j) g.put(char('0' + (w >> j & 1)));
+            }
+        } else {
+            const auto &tables = bitset_text_detail::get_tables();
+            const char *lut = s.type == 'X' ? tables.hexUpper : tables.hexLower;
+            std::uint8_t bytes[16] = {};
+            char digits[32];
+            const std::size_t ndigits = hex_size(N);
+            for (std::size_t i = 0; i < (N + 63) / 64; i += 2) {
+                for (std::size_t j = 0; j < 2; ++j) {
+                    const std::uint64_t w = i + j < (N + 63) / 64 ? src.fetch(i + j) : 0;
+                    for (int b = 0; b < 8; ++b) bytes[8 * j + b] = std::uint8_t(w >> (8 * b));
+                }
+                bitset_text_detail::encode_hex_16(bytes, digits, lut);
+                for (std::size_t k = 0, n = std::min<std::size_t>(32, ndigits - i * 16); k < n; ++k) g.put(digits[k]);
+            }
+        }
+        out = g.out;
+    }
+    return detail::fill(out, s.fill, after);
+}
+
+/// As above, parsing the spec from text (without braces, e.g. "x_4") at runtime
+/// @throws std::invalid_argument if the spec is invalid
+template <typename OutputIt, std::size_t N, typename T>
+OutputIt format_to(OutputIt out, const compact_bitset<N, T> &bs, std::string_view specText) {
+    spec s;
+    const char *error;
+    const char *end = parse_spec(specText.data(), specText.data() + specText.size(), s, error);
+    if (!error && end != specText.data() + specText.size()) error = "compact_bitset format: invalid format spec";
+    if (error) throw std::invalid_argument(error);
+    return format_to(out, bs, s);
+}
+
+} // namespace bitset_format
+
+#ifdef __cpp_lib_format
+template <std::size_t N, typename T>
+struct std::formatter<compact_bitset<N, T>, char> {
+    bitset_format::spec s;
+    constexpr auto parse(std::format_parse_context &ctx) {
+        const char *error;
+        const auto end = bitset_format::parse_spec(ctx.begin(), ctx.end(), s, error);
+        if (error) throw std::format_error(error);
+        return end;
+    }
+    template <typename FormatContext>
+    auto format(const compact_bitset<N, T> &bs, FormatContext &ctx) const { return bitset_format::format_to(ctx.out(), bs, s); }
+};
+#endif
+
+#ifdef COMPACT_BITSET_HAS_FMT
+template <std::size_t N, typename T>
+struct fmt::formatter<compact_bitset<N, T>> {
+    bitset_format::spec s;
+    constexpr auto parse(fmt::format_parse_context &ctx) -> decltype(ctx.begin()) {
+        const char *error;
+        const auto end = bitset_format::parse_spec(ctx.begin(), ctx.end(), s, error);
+        if (error) throw fmt::format_error(error);
+        return end;
+    }
+    template <typename FormatContext>
+    auto format(const compact_bitset<N, T> &bs, FormatContext &ctx) const -> decltype(ctx.out()) {
+        return bitset_format::format_to(ctx.out(), bs, s);
+    }
+};
+#endif
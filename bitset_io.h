@@ -0,0 +1,300 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bit_util.h"
+#include "bitstream.h"
+#include "compact_bitset.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+/// Binary serialization of bitsets, with optional self-contained compression.
+///
+/// The format is a header (the 4 bytes "CBS1", an encoding byte, and the number of bits as a little-endian uint64),
+/// followed by the payload. With encoding::raw the payload is the bits as little-endian 64-bit words. With
+/// encoding::compressed the bits are split into blocks of 64Ki bits, and each block is stored in whichever of these
+/// is smallest:
+///  - raw: the block's words, little-endian
+///  - runs: the number of runs, then the length of each run of equal bits, alternating, starting with a run of zeros
+///    (which may be empty)
+///  - sparse: the number of set bits, then the gap before each set bit
+/// Every count, length and gap is a LEB128 varint, and each block is prefixed by its type and payload length.
+///
+/// Compression and decompression stream block by block: only one block's worth of encoded bytes is ever buffered,
+/// and decompression writes straight into the destination bitset.
+namespace bitset_io {
+
+enum class encoding : std::uint8_t { raw = 0, compressed = 1 };
+
+namespace detail {
+constexpr char Magic[4] = {'C', 'B', 'S', '1'};
+constexpr std::size_t BlockWords = 1024, BlockBits = BlockWords * 64;
+enum BlockType : std::uint8_t { RawBlock = 0, RunsBlock = 1, SparseBlock = 2 };
+
+inline std::size_t varint_size(std::uint64_t v) noexcept { return v ? std::size_t(bit_util::log2(v)) / 7 + 1 : 1; }
+inline void put_varint(std::vector<std::uint8_t> &out, std::uint64_t v) {
+    for (; v >= 0x80; v >>= 7) out.push_back(std::uint8_t(v | 0x80));
+    out.push_back(std::uint8_t(v));
+}
+inline void put_le64(std::uint8_t *p, std::uint64_t v) noexcept {
+    for (int i = 0; i < 8; ++i) p[i] = std::uint8_t(v >> (8 * i));
+}
+inline void put_le64(std::vector<std::uint8_t> &out, std::uint64_t v) {
+    out.resize(out.size() + 8);
+    put_le64(out.data() + out.size() - 8, v);
+}
+// appends nw words as little-endian bytes
+inline void put_words(std::vector<std::uint8_t> &out, const std::uint64_t *w, std::size_t nw) {
+    const std::size_t at = out.size();
+    out.resize(at + nw * 8);
+    for (std::size_t i = 0; i < nw; ++i) put_le64(out.data() + at + 8 * i, w[i]);
+}
+inline std::uint64_t get_le64(const std::uint8_t *p) noexcept {
+    std::uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= std::uint64_t(p[i]) << (8 * i);
+    return v;
+}
+[[noreturn]] inline void throw_corrupt() { throw std::invalid_argument("Corrupt or truncated bitset_io data"); }
+
+/// Reads varints from an in-memory block payload, with bounds checking.
+class payload_reader {
+    const std::uint8_t *p, *end;
+public:
+    payload_reader(const std::vector<std::uint8_t> &buf) noexcept : p(buf.data()), end(buf.data() + buf.size()) {}
+    std::uint64_t varint() {
+        std::uint64_t ret = 0;
+        for (unsigned shift = 0; ; shift += 7) {
+            if (p == end || shift > 63) throw_corrupt();
+            const std::uint8_t byte = *p++;
+            ret |= std::uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return ret;
+        }
+    }
+    bool done() const noexcept { return p == end; }
+};
+inline std::uint64_t read_varint(std::istream &is) {
+    std::uint64_t ret = 0;
+    for (unsigned shift = 0; ; shift += 7) {
+        const auto ch = is.get();
+        if (ch == std::istream::traits_type::eof() || shift > 63) throw_corrupt();
+        ret |= std::uint64_t(ch & 0x7F) << shift;
+        if (!(ch & 0x80)) return ret;
+    }
+}
+// sets bits [from, to) of a word array
+inline void set_range(std::uint64_t *w, std::size_t from, std::size_t to) noexcept {
+    for (; from < to && from % 64; ++from) w[from / 64] |= std::uint64_t(1) << (from % 64);
+    for (; from + 64 <= to; from += 64) w[from / 64] = ~std::uint64_t(0);
+    for (; from < to; ++from) w[from / 64] |= std::uint64_t(1) << (from % 64);
+}
+
+// Encodes one block of nb bits held in words w into out (type, length, payload), picking the smallest encoding.
+inline void encode_block(const std::uint64_t *w, std::size_t nb, std::vector<std::uint8_t> &payload, std::vector<std::uint8_t> &out) {
+    const std::size_t nw = (nb + 63) / 64, rawSize = nw * 8;
+    // one pass to size the runs and sparse encodings, giving up on either once it can't beat raw
+    std::size_t ones = 0, sparseSize = 0, runsSize = 0, nruns = 0, lastOne = 0, lastTransition = 0;
+    bool prevBit = false;
+    for (std::size_t i = 0; i < nw && (sparseSize <= rawSize || runsSize <= rawSize); ++i) {
+        const std::uint64_t x = w[i];
+        if (sparseSize <= rawSize)
+            for (std::uint64_t m = x; m; m &= m - 1) {
+                const std::size_t pos = i * 64 + unsigned(bit_util::ctz(m));
+                sparseSize += varint_size(pos - lastOne);
+                lastOne = pos + 1;
+                ++ones;
+            }
+        // bit j of t is set where bit j differs from the bit before it
+        const std::uint64_t t = (x ^ (x << 1 | std::uint64_t(prevBit))) & bit_util::low_mask(unsigned(std::min<std::size_t>(64, nb - i * 64)));
+        for (std::uint64_t m = t; m; m &= m - 1) {
+            const std::size_t pos = i * 64 + unsigned(bit_util::ctz(m));
+            runsSize += varint_size(pos - lastTransition);
+            lastTransition = pos;
+            ++nruns;
+        }
+        prevBit = x >> 63;
+    }
+    ++nruns; // the final run
+    runsSize += varint_size(nb - lastTransition) + varint_size(nruns);
+    sparseSize += varint_size(ones);
+    payload.clear();
+    BlockType type = RawBlock;
+    if (sparseSize <= rawSize && sparseSize <= runsSize) {
+        type = SparseBlock;
+        put_varint(payload, ones);
+        std::size_t last = 0;
+        for (std::size_t i = 0; i < nw; ++i)
+            for (std::uint64_t m = w[i]; m; m &= m - 1) {
+                const std::size_t pos = i * 64 + unsigned(bit_util::ctz(m));
+                put_varint(payload, pos - last);
+                last = pos + 1;
+            }
+    } else if (runsSize < rawSize) {
+        type = RunsBlock;
+        put_varint(payload, nruns);
+        std::size_t last = 0;
+        prevBit = false;
+        for (std::size_t i = 0; i < nw; ++i) {
+            const std::uint64_t x = w[i];
+            const std::uint64_t t = (x ^ (x << 1 | std::uint64_t(prevBit))) & bit_util::low_mask(unsigned(std::min<std::size_t>(64, nb - i * 64)));
+            for (std::uint64_t m = t; m; m &= m - 1) {
+                const std::size_t pos = i * 64 + unsigned(bit_util::ctz(m));
+                put_varint(payload, pos - last);
+                last = pos;
+            }
+            prevBit = x >> 63;
+        }
+        put_varint(payload, nb - last);
+    } else {
+        put_words(payload, w, nw);
+    }
+    out.clear();
+    out.push_back(type);
+    put_varint(out, payload.size());
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+// Decodes one block of nb bits from is into words w (which are zeroed first).
+inline void decode_block(std::istream &is, std::uint64_t *w, std::size_t nb, std::vector<std::uint8_t> &payload) {
+    const std::size_t nw = (nb + 63) / 64;
+    std::fill(w, w + nw, std::uint64_t(0));
+    const auto type = is.get();
+    const std::uint64_t len = read_varint(is);
+    if (len > nw * 8) throw_corrupt(); // the encoder never writes anything larger than raw
+    payload.resize(std::size_t(len));
+    if (!is.read(reinterpret_cast<char *>(payload.data()), std::streamsize(len))) throw_corrupt();
+    payload_reader r(payload);
+    if (type == RawBlock) {
+        if (len != nw * 8) throw_corrupt();
+        for (std::size_t i = 0; i < nw; ++i) w[i] = get_le64(payload.data() + 8 * i);
+        if (nb % 64) w[nw - 1] &= bit_util::low_mask(unsigned(nb % 64)); // keep unused bits 0
+    } else if (type == RunsBlock) {
+        const std::uint64_t nruns = r.varint();
+        std::size_t pos = 0;
+        for (std::uint64_t i = 0; i < nruns; ++i) {
+            const std::uint64_t runLen = r.varint();
+            if (runLen > nb - pos) throw_corrupt();
+            if (i % 2) set_range(w, pos, pos + std::size_t(runLen));
+            pos += std::size_t(runLen);
+        }
+        if (pos != nb || !r.done()) throw_corrupt();
+    } else if (type == SparseBlock) {
+        const std::uint64_t ones = r.varint();
+        std::size_t pos = 0;
+        for (std::uint64_t i = 0; i < ones; ++i) {
+            const std::uint64_t gap = r.varint();
+            if (gap >= nb - pos) throw_corrupt();
+            pos += std::size_t(gap);
+            w[pos / 64] |= std::uint64_t(1) << (pos % 64);
+            ++pos;
+        }
+        if (!r.done()) throw_corrupt();
+    } else {
+        throw_corrupt();
+    }
+}
+
+template <typename Source>
+void write_impl(std::ostream &os, const Source &src, std::size_t nbits, encoding enc) {
+    std::vector<std::uint8_t> header(Magic, Magic + 4), payload, out;
+    header.push_back(std::uint8_t(enc));
+    put_le64(header, nbits);
+    os.write(reinterpret_cast<const char *>(header.data()), std::streamsize(header.size()));
+    std::vector<std::uint64_t> block(BlockWords);
+    for (std::size_t pos = 0; pos < nbits && os; pos += BlockBits) {
+        const std::size_t nb = std::min(BlockBits, nbits - pos), nw = (nb + 63) / 64;
+        for (std::size_t i = 0; i < nw; ++i) block[i] = src.fetch(pos / 64 + i);
+        if (nb % 64) block[nw - 1] &= bit_util::low_mask(unsigned(nb % 64)); // words past nbits may hold garbage
+        if (enc == encoding::compressed) {
+            encode_block(block.data(), nb, payload, out);
+        } else {
+            out.clear();
+            put_words(out, block.data(), nw);
+        }
+        os.write(reinterpret_cast<const char *>(out.data()), std::streamsize(out.size()));
+    }
+}
+// reads the header, returning the number of bits and the encoding
+inline std::uint64_t read_header(std::istream &is, encoding &enc) {
+    std::uint8_t header[13];
+    if (!is.read(reinterpret_cast<char *>(header), sizeof(header)) || !std::equal(Magic, Magic + 4, header) || header[4] > 1)
+        throw std::invalid_argument("Not bitset_io data");
+    enc = encoding(header[4]);
+    return get_le64(header + 5);
+}
+template <typename Sink>
+void read_impl(std::istream &is, Sink &sink, std::size_t nbits, encoding enc) {
+    std::vector<std::uint8_t> payload;
+    std::vector<std::uint64_t> block(BlockWords);
+    for (std::size_t pos = 0; pos < nbits; pos += BlockBits) {
+        const std::size_t nb = std::min(BlockBits, nbits - pos), nw = (nb + 63) / 64;
+        if (enc == encoding::compressed) {
+            decode_block(is, block.data(), nb, payload);
+        } else {
+            payload.resize(nw * 8);
+            if (!is.read(reinterpret_cast<char *>(payload.data()), std::streamsize(payload.size()))) throw_corrupt();
+            for (std::size_t i = 0; i < nw; ++i) block[i] = get_le64(payload.data() + 8 * i);
+            if (nb % 64) block[nw - 1] &= bit_util::low_mask(unsigned(nb % 64));
+        }
+        for (std::size_t i = 0; i < nw; ++i) sink.put(pos / 64 + i, block[i]);
+    }
+}
+} // namespace detail
+
+/// Serialize bs to os. Sets os's failbit/badbit on I/O error, like operator<<.
+template <std::size_t N, typename T>
+void write(std::ostream &os, const compact_bitset<N, T> &bs, encoding enc = encoding::compressed) {
+    detail::write_impl(os, bitset_word_source<N, T>(bs), N, enc);
+}
+/// Serialize `nbits` bits stored in `words` (bit j of words[i] is bit i * 64 + j).
+inline void write(std::ostream &os, const std::uint64_t *words, std::size_t nbits, encoding enc = encoding::compressed) {
+    detail::write_impl(os, word_span_source(words), nbits, enc);
+}
+/// Deserialize into bs, decompressing straight into its words.
+/// @throws std::invalid_argument if the data is not valid, or does not hold exactly N bits
+template <std::size_t N, typename T>
+void read(std::istream &is, compact_bitset<N, T> &bs) {
+    encoding enc;
+    if (detail::read_header(is, enc) != N) throw std::invalid_argument("bitset_io data has a different number of bits");
+    bitset_word_sink<N, T> sink(bs);
+    detail::read_impl(is, sink, N, enc);
+}
+/// Deserialize a bitset of any size into a word array; its number of bits is stored to `nbits`.
+/// @throws std::invalid_argument if the data is not valid
+inline std::vector<std::uint64_t> read_words(std::istream &is, std::size_t &nbits) {
+    encoding enc;
+    const std::uint64_t n = detail::read_header(is, enc);
+    vector_word_sink sink;
+    sink.reserve(std::size_t((n + 63) / 64));
+    detail::read_impl(is, sink, std::size_t(n), enc);
+    nbits = std::size_t(n);
+    return sink.release();
+}
+
+} // namespace bitset_io
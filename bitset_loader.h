@@ -0,0 +1,206 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bitstream.h"
+#include "compact_bitset.h"
+#include "disk_bitset.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/// Bulk parsing of newline-delimited files of bitsets in to_string() form, one bitset per line (POSIX only).
+///
+/// The text is split into one byte range per thread, each range ending at a newline. A first pass counts each
+/// range's lines so that every thread knows the index of its first line; then the result vector is allocated once
+/// at its final size, and each thread parses its lines straight into their slots. Files are mmap'd rather than read.
+///
+/// Each line must be exactly N '0'/'1' characters (a trailing '\r' is allowed); the first character is bit 0, as
+/// with the compact_bitset string constructor. Lines are parsed 32 (AVX2) or 16 (SSE2) characters at a time with a
+/// compare and movemask, which validates and packs the bits in the same step. A malformed line doesn't throw: its
+/// bitset is left all-0 and the line is reported with its byte offset.
+struct bitset_load_error {
+    std::size_t line;   ///< 0-based line number
+    std::size_t offset; ///< byte offset of the first bad character (or of the end of the line, if it's the wrong length)
+    const char *reason;
+};
+
+struct bitset_load_options {
+    unsigned nthreads = 0;        ///< 0: use std::thread::hardware_concurrency()
+    std::size_t max_errors = 1000; ///< errors beyond this many are counted but not recorded
+};
+
+template <std::size_t N, typename T>
+struct bitset_load_result {
+    std::vector<compact_bitset<N, T>> bitsets; ///< one per line, all-0 for malformed lines
+    std::vector<bitset_load_error> errors;     ///< sorted by line
+    std::size_t error_count = 0;               ///< may exceed errors.size() if max_errors was hit
+};
+
+namespace bitset_loader_detail {
+/// Parse n <= 64 chars of '0'/'1' into a word (bit j = p[j]); sets `bad` if any char is something else
+inline std::uint64_t parse_word(const char *p, std::size_t n, bool &bad) noexcept {
+    std::uint64_t w = 0;
+    std::size_t j = 0;
+#if defined(__AVX2__)
+    for (; j + 32 <= n; j += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + j));
+        const std::uint32_t ones = std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('1'))));
+        const std::uint32_t zeros = std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('0'))));
+        bad |= (ones | zeros) != 0xFFFFFFFFu;
+        w |= std::uint64_t(ones) << j;
+    }
+#elif defined(__SSE2__)
+    for (; j + 16 <= n; j += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + j));
+        const unsigned ones = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('1'))));
+        const unsigned zeros = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('0'))));
+        bad |= (ones | zeros) != 0xFFFFu;
+        w |= std::uint64_t(ones) << j;
+    }
+#endif
+    unsigned badBits = 0;
+    for (; j < n; ++j) {
+        const unsigned d = unsigned(std::uint8_t(p[j])) - unsigned('0');
+        badBits |= d;
+        w |= std::uint64_t(d & 1) << j;
+    }
+    bad |= badBits > 1;
+    return w;
+}
+
+// Parse one line (without its '\n') into bs; returns nullptr on success, or the reason and sets badAt
+template <std::size_t N, typename T>
+const char * parse_line(const char *p, std::size_t len, compact_bitset<N, T> &bs, std::size_t &badAt) noexcept {
+    if (len && p[len - 1] == '\r') --len;
+    if (len != N) { badAt = len; return len < N ? "line too short" : "line too long"; }
+    bitset_word_sink<N, T> sink(bs);
+    bool bad = false;
+    for (std::size_t i = 0; i < (N + 63) / 64; ++i) {
+        const std::size_t n = std::min<std::size_t>(64, N - i * 64);
+        sink.put(i, parse_word(p + i * 64, n, bad));
+        if (bad) {
+            for (badAt = i * 64; p[badAt] == '0' || p[badAt] == '1'; ++badAt) {}
+            bs.reset();
+            return "invalid character";
+        }
+    }
+    return nullptr;
+}
+
+// Runs f(t) for t in [0, nthreads), each on its own thread
+template <typename F>
+void run_threads(unsigned nthreads, F &&f) {
+    if (nthreads <= 1) { f(0u); return; }
+    std::vector<std::thread> threads;
+    threads.reserve(nthreads - 1);
+    for (unsigned t = 1; t < nthreads; ++t) threads.emplace_back([&f, t] { f(t); });
+    f(0u);
+    for (auto &th : threads) th.join();
+}
+} // namespace bitset_loader_detail
+
+/// Parse text holding one bitset per line (the last line needn't end in '\n')
+template <std::size_t N, typename T = typename compact_bitset<N>::word_type>
+bitset_load_result<N, T> parse_bitset_lines(std::string_view text, const bitset_load_options &opts = {}) {
+    namespace d = bitset_loader_detail;
+    unsigned nthreads = opts.nthreads ? opts.nthreads : std::max(1u, std::thread::hardware_concurrency());
+    nthreads = unsigned(std::max<std::size_t>(1, std::min<std::size_t>(nthreads, text.size() / 65536))); // don't bother for small inputs
+    // chunk t is [bounds[t], bounds[t + 1]); each boundary is just past a newline
+    std::vector<std::size_t> bounds(nthreads + 1, text.size()), firstLine(nthreads + 1, 0);
+    bounds[0] = 0;
+    for (unsigned t = 1; t < nthreads; ++t) {
+        const std::size_t nl = text.find('\n', std::max(bounds[t - 1], text.size() / nthreads * t));
+        bounds[t] = nl == text.npos ? text.size() : nl + 1;
+    }
+    // pass 1: count lines per chunk
+    d::run_threads(nthreads, [&](unsigned t) {
+        std::size_t n = 0;
+        const char *p = text.data() + bounds[t], *end = text.data() + bounds[t + 1];
+        while (p != end) {
+            const char *nl = static_cast<const char *>(std::memchr(p, '\n', std::size_t(end - p)));
+            ++n;
+            p = nl ? nl + 1 : end;
+        }
+        firstLine[t + 1] = n;
+    });
+    for (unsigned t = 0; t < nthreads; ++t) firstLine[t + 1] += firstLine[t];
+    bitset_load_result<N, T> ret;
+    ret.bitsets.resize(firstLine[nthreads]);
+    // pass 2: parse, collecting errors per thread
+    std::vector<std::vector<bitset_load_error>> errors(nthreads);
+    std::vector<std::size_t> errorCounts(nthreads);
+    d::run_threads(nthreads, [&](unsigned t) {
+        std::size_t line = firstLine[t];
+        const char *p = text.data() + bounds[t], *end = text.data() + bounds[t + 1];
+        while (p != end) {
+            const char *nl = static_cast<const char *>(std::memchr(p, '\n', std::size_t(end - p)));
+            const char *lineEnd = nl ? nl : end;
+            std::size_t badAt;
+            if (const char *reason = d::parse_line(p, std::size_t(lineEnd - p), ret.bitsets[line], badAt)) {
+                if (errors[t].size() < opts.max_errors)
+                    errors[t].push_back({line, std::size_t(p - text.data()) + badAt, reason});
+                ++errorCounts[t];
+            }
+            ++line;
+            p = nl ? nl + 1 : end;
+        }
+    });
+    for (unsigned t = 0; t < nthreads; ++t) {
+        ret.error_count += errorCounts[t];
+        const std::size_t n = std::min(errors[t].size(), opts.max_errors - ret.errors.size());
+        ret.errors.insert(ret.errors.end(), errors[t].begin(), errors[t].begin() + std::ptrdiff_t(n));
+    }
+    return ret;
+}
+
+/// mmap a file and parse it as above. @throws std::system_error if the file can't be opened or mapped
+template <std::size_t N, typename T = typename compact_bitset<N>::word_type>
+bitset_load_result<N, T> load_bitset_lines(const std::string &path, const bitset_load_options &opts = {}) {
+    const disk_bitset::detail::fd_handle fd(path, O_RDONLY, false);
+    struct stat st;
+    if (::fstat(fd.get(), &st) != 0) disk_bitset::detail::throw_errno("load_bitset_lines: cannot stat " + path);
+    const std::size_t size = std::size_t(st.st_size);
+    if (!size) return {};
+    void *p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+    if (p == MAP_FAILED) disk_bitset::detail::throw_errno("load_bitset_lines: cannot mmap " + path);
+    struct unmapper { void *p; std::size_t n; ~unmapper() { ::munmap(p, n); } } unmap{p, size};
+#ifdef MADV_SEQUENTIAL
+    ::madvise(p, size, MADV_SEQUENTIAL); // each thread streams through its range once
+#endif
+    return parse_bitset_lines<N, T>(std::string_view(static_cast<const char *>(p), size), opts);
+}
@@ -0,0 +1,274 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bitstream.h"
+#include "compact_bitset.h"
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#ifdef __SSSE3__
+#include <immintrin.h>
+#endif
+
+/// Hex and base64 text encodings of a compact_bitset, 4x and ~5.3x denser than to_string().
+///
+/// Both follow to_string()'s bit order: they are what you get by taking the to_string() text ("1" for bit 0 first),
+/// padding it on the right with '0's and reading it off 4 (hex) or 6 (base64) characters at a time, first character
+/// most significant. So to_hex() of a bitset whose to_string() is "10000011" is "83", and hex digit k always covers
+/// bits 4k..4k+3. Base64 is of the bytes formed the same way, 8 characters at a time, with standard '=' padding.
+///
+/// The encoders have SSSE3 kernels (a pshufb nibble lookup for hex; the pshufb/multiply scheme for base64) and
+/// otherwise use branch-free table lookups. The parsers work like std::from_chars: they return the end of what they
+/// parsed and a std::errc, and leave the bitset untouched on error.
+namespace bitset_text_detail {
+constexpr std::uint8_t rev4(unsigned n) noexcept { return std::uint8_t((n & 1) << 3 | (n & 2) << 1 | (n & 4) >> 1 | (n & 8) >> 3); }
+constexpr std::uint8_t rev8(unsigned n) noexcept { return std::uint8_t(rev4(n & 0xF) << 4 | rev4(n >> 4)); }
+constexpr char Base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+constexpr std::uint8_t Invalid = 0xFF;
+
+struct tables {
+    char hexLower[16] = {}, hexUpper[16] = {}; // nibble -> digit of the bit-reversed nibble
+    std::uint8_t rev8[256] = {};
+    std::uint8_t hexValue[256] = {}; // digit -> bit-reversed nibble, or Invalid
+    std::uint8_t base64Value[256] = {}; // char -> 6-bit value, or Invalid
+    constexpr tables() {
+        constexpr char lower[] = "0123456789abcdef", upper[] = "0123456789ABCDEF";
+        for (unsigned n = 0; n < 16; ++n) hexLower[n] = lower[rev4(n)], hexUpper[n] = upper[rev4(n)];
+        for (unsigned i = 0; i < 256; ++i) rev8[i] = bitset_text_detail::rev8(i), hexValue[i] = base64Value[i] = Invalid;
+        for (unsigned n = 0; n < 16; ++n) hexValue[std::uint8_t(lower[n])] = hexValue[std::uint8_t(upper[n])] = rev4(n);
+        for (unsigned n = 0; n < 64; ++n) base64Value[std::uint8_t(Base64Chars[n])] = std::uint8_t(n);
+    }
+};
+inline const tables & get_tables() noexcept {
+    static constexpr tables t{};
+    return t;
+}
+
+// 16 little-endian bytes -> 32 hex digits, low nibble of each byte first
+inline void encode_hex_16(const std::uint8_t *in, char *out, const char *lut) noexcept {
+#ifdef __SSSE3__
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in)), mask = _mm_set1_epi8(0x0F);
+    const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lut));
+    const __m128i lo = _mm_shuffle_epi8(l, _mm_and_si128(v, mask)), hi = _mm_shuffle_epi8(l, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi8(lo, hi));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 16), _mm_unpackhi_epi8(lo, hi));
+#else
+    for (int i = 0; i < 16; ++i) out[2 * i] = lut[in[i] & 0xF], out[2 * i + 1] = lut[in[i] >> 4];
+#endif
+}
+
+// 12 bytes -> 16 base64 chars (reads 16 bytes of `in`)
+inline void encode_base64_12(const std::uint8_t *in, char *out) noexcept {
+#ifdef __SSSE3__
+    // split each 3 bytes into four 6-bit indices with shuffles and multiplies, then map indices to ASCII by adding
+    // a per-range offset looked up with pshufb
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+    v = _mm_shuffle_epi8(v, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    const __m128i t1 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    const __m128i t3 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    const __m128i idx = _mm_or_si128(t1, t3);
+    __m128i r = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+    r = _mm_or_si128(r, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_add_epi8(_mm_shuffle_epi8(offsets, r), idx));
+#else
+    for (int g = 0; g < 4; ++g, in += 3, out += 4) {
+        const unsigned v = unsigned(in[0]) << 16 | unsigned(in[1]) << 8 | in[2];
+        out[0] = Base64Chars[v >> 18], out[1] = Base64Chars[v >> 12 & 63], out[2] = Base64Chars[v >> 6 & 63], out[3] = Base64Chars[v & 63];
+    }
+#endif
+}
+// end of the run of hex digits starting at first
+inline const char * hex_end(const char *first, const char *last) noexcept {
+    const auto &hv = get_tables().hexValue;
+    while (first != last && hv[std::uint8_t(*first)] != Invalid) ++first;
+    return first;
+}
+// end of the run of base64 characters starting at first, plus up to 2 '='s
+inline const char * base64_end(const char *first, const char *last, std::size_t &nchars, std::size_t &pad) noexcept {
+    const auto &bv = get_tables().base64Value;
+    const char *end = first;
+    while (end != last && bv[std::uint8_t(*end)] != Invalid) ++end;
+    nchars = std::size_t(end - first), pad = 0;
+    while (pad < 2 && end != last && *end == '=') ++end, ++pad;
+    return end;
+}
+} // namespace bitset_text_detail
+
+/// Number of characters to_hex() produces
+constexpr std::size_t hex_size(std::size_t nbits) noexcept { return (nbits + 3) / 4; }
+/// Number of characters to_base64() produces (including padding)
+constexpr std::size_t base64_size(std::size_t nbits) noexcept { return ((nbits + 7) / 8 + 2) / 3 * 4; }
+
+/// Write hex_size(N) hex digits to `out` (no terminator), returning the end
+template <std::size_t N, typename T>
+char * to_hex(const compact_bitset<N, T> &bs, char *out, bool upper = false) noexcept {
+    namespace d = bitset_text_detail;
+    const char *lut = upper ? d::get_tables().hexUpper : d::get_tables().hexLower;
+    const bitset_word_source<N, T> src(bs);
+    const std::size_t nwords = (N + 63) / 64, ndigits = hex_size(N);
+    std::uint8_t bytes[16];
+    char digits[32];
+    for (std::size_t i = 0; i < nwords; i += 2) {
+        for (std::size_t j = 0; j < 2; ++j) {
+            const std::uint64_t w = i + j < nwords ? src.fetch(i + j) : 0;
+            for (int b = 0; b < 8; ++b) bytes[8 * j + b] = std::uint8_t(w >> (8 * b));
+        }
+        const std::size_t k = i * 16, n = std::min<std::size_t>(32, ndigits - k);
+        if (n == 32) {
+            d::encode_hex_16(bytes, out + k, lut);
+        } else {
+            d::encode_hex_16(bytes, digits, lut);
+            std::copy(digits, digits + n, out + k);
+        }
+    }
+    return out + ndigits;
+}
+template <std::size_t N, typename T>
+std::string to_hex(const compact_bitset<N, T> &bs, bool upper = false) {
+    std::string ret(hex_size(N), '\0');
+    to_hex(bs, ret.data(), upper);
+    return ret;
+}
+
+/// Write base64_size(N) base64 characters to `out` (no terminator), returning the end
+template <std::size_t N, typename T>
+char * to_base64(const compact_bitset<N, T> &bs, char *out) noexcept {
+    namespace d = bitset_text_detail;
+    const auto &rev8 = d::get_tables().rev8;
+    const bitset_word_source<N, T> src(bs);
+    const std::size_t nbytes = (N + 7) / 8, nchars = base64_size(N);
+    // 48 bytes (6 words) become 64 chars; the buffer has slack because the SSSE3 kernel reads 16 bytes per 12
+    std::uint8_t bytes[48 + 16] = {};
+    char chars[64];
+    for (std::size_t pos = 0; pos < nbytes; pos += 48) {
+        const std::size_t n = std::min<std::size_t>(48, nbytes - pos);
+        for (std::size_t i = 0; i < 6; ++i) {
+            const std::size_t wi = pos / 8 + i;
+            const std::uint64_t w = wi * 8 < nbytes ? src.fetch(wi) : 0;
+            for (int b = 0; b < 8; ++b) bytes[8 * i + b] = rev8[std::uint8_t(w >> (8 * b))];
+        }
+        for (std::size_t g = 0; g < 4; ++g) d::encode_base64_12(bytes + 12 * g, chars + 16 * g);
+        const std::size_t k = pos / 3 * 4, nc = std::min<std::size_t>(64, nchars - k);
+        std::copy(chars, chars + nc, out + k);
+        if (n < 48 && n % 3) { // pad the final group; bytes past the end were 0 so its data chars are right already
+            out[k + nc - 1] = '=';
+            if (n % 3 == 1) out[k + nc - 2] = '=';
+        }
+    }
+    return out + nchars;
+}
+template <std::size_t N, typename T>
+std::string to_base64(const compact_bitset<N, T> &bs) {
+    std::string ret(base64_size(N), '\0');
+    to_base64(bs, ret.data());
+    return ret;
+}
+
+/// Parse the hex digits at the start of [first, last) into bs, like std::from_chars: ptr is left at the first
+/// non-digit. Fewer than hex_size(N) digits leave the remaining bits 0.
+/// ec is std::errc::invalid_argument if there are no digits, or std::errc::result_out_of_range if there are more than
+/// hex_size(N) or they set bits past N; in either case bs is unchanged.
+template <std::size_t N, typename T>
+std::from_chars_result from_hex(const char *first, const char *last, compact_bitset<N, T> &bs) noexcept {
+    const auto &hv = bitset_text_detail::get_tables().hexValue;
+    const char *end = bitset_text_detail::hex_end(first, last);
+    const std::size_t ndigits = std::size_t(end - first);
+    if (!ndigits) return {first, std::errc::invalid_argument};
+    if (ndigits > hex_size(N) || (N % 4 && ndigits == hex_size(N) && hv[std::uint8_t(end[-1])] >> (N % 4)))
+        return {end, std::errc::result_out_of_range};
+    bitset_word_sink<N, T> sink(bs);
+    for (std::size_t i = 0; i < (N + 63) / 64; ++i) {
+        std::uint64_t w = 0;
+        const std::size_t k0 = i * 16;
+        if (k0 + 16 <= ndigits) {
+            for (std::size_t k = 0; k < 16; ++k) w |= std::uint64_t(hv[std::uint8_t(first[k0 + k])]) << (4 * k);
+        } else {
+            for (std::size_t k = k0; k < ndigits; ++k) w |= std::uint64_t(hv[std::uint8_t(first[k])]) << (4 * (k - k0));
+        }
+        sink.put(i, w);
+    }
+    return {end, std::errc{}};
+}
+
+/// Parse base64 at the start of [first, last) into bs, like std::from_chars. The text must be a whole number of
+/// 4-character groups, the last of which may be '='-padded, decoding to at most (N + 7) / 8 bytes.
+/// ec is std::errc::invalid_argument for malformed input (including non-zero padding bits), or
+/// std::errc::result_out_of_range if it decodes to more than N bits' worth of data; in either case bs is unchanged.
+template <std::size_t N, typename T>
+std::from_chars_result from_base64(const char *first, const char *last, compact_bitset<N, T> &bs) noexcept {
+    namespace d = bitset_text_detail;
+    const auto &bv = d::get_tables().base64Value;
+    const auto &rev8 = d::get_tables().rev8;
+    std::size_t nchars, pad;
+    const char *end = d::base64_end(first, last, nchars, pad);
+    if (!nchars || (nchars + pad) % 4 || (pad && nchars % 4 + pad != 4)) return {first, std::errc::invalid_argument};
+    // the data bits of the last char that fall past the last whole byte must be 0
+    if (pad && bv[std::uint8_t(first[nchars - 1])] & (pad == 1 ? 0x3 : 0xF)) return {first, std::errc::invalid_argument};
+    const std::size_t nbytes = nchars / 4 * 3 + (nchars % 4 ? nchars % 4 - 1 : 0);
+    const auto group = [&](std::size_t c) { // the (up to) 3 bytes of the 4-char group at c, as 24 bits
+        return unsigned(bv[std::uint8_t(first[c])]) << 18 | unsigned(bv[std::uint8_t(first[c + 1])]) << 12
+               | (c + 2 < nchars ? unsigned(bv[std::uint8_t(first[c + 2])]) << 6 : 0u)
+               | (c + 3 < nchars ? unsigned(bv[std::uint8_t(first[c + 3])]) : 0u);
+    };
+    if (nbytes > (N + 7) / 8) return {end, std::errc::result_out_of_range};
+    if (N % 8 && nbytes == (N + 7) / 8) {
+        const std::size_t j = nbytes - 1;
+        if (rev8[std::uint8_t(group(j / 3 * 4) >> (16 - 8 * (j % 3)))] >> (N % 8)) return {end, std::errc::result_out_of_range};
+    }
+    bitset_word_sink<N, T> sink(bs);
+    std::uint64_t w = 0;
+    for (std::size_t c = 0, j = 0; c < nchars; c += 4) {
+        const unsigned v = group(c);
+        for (unsigned r = 0; r < 3 && j < nbytes; ++r, ++j) {
+            w |= std::uint64_t(rev8[std::uint8_t(v >> (16 - 8 * r))]) << (8 * (j % 8));
+            if (j % 8 == 7) sink.put(j / 8, w), w = 0;
+        }
+    }
+    for (std::size_t i = nbytes / 8; i < (N + 63) / 64; ++i, w = 0) sink.put(i, w); // the partial word, then zeros
+    return {end, std::errc{}};
+}
+
+/// Parse a whole string; trailing characters are an error (std::errc::invalid_argument), and leave bs unchanged
+template <std::size_t N, typename T>
+std::errc from_hex(std::string_view s, compact_bitset<N, T> &bs) noexcept {
+    const char *first = s.data(), *last = first + s.size();
+    if (bitset_text_detail::hex_end(first, last) != last) return std::errc::invalid_argument;
+    return from_hex(first, last, bs).ec;
+}
+template <std::size_t N, typename T>
+std::errc from_base64(std::string_view s, compact_bitset<N, T> &bs) noexcept {
+    const char *first = s.data(), *last = first + s.size();
+    std::size_t nchars, pad;
+    if (bitset_text_detail::base64_end(first, last, nchars, pad) != last) return std::errc::invalid_argument;
+    return from_base64(first, last, bs).ec;
+}
@@ -0,0 +1,308 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bit_util.h"
+#include "compact_bitset.h"
+#include "rank_select.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// Bit-level writer/reader for variable-length codes, using the same layout as compact_bitset: bit i of the stream
+/// is bit i % 64 of 64-bit word i / 64 (or, for smaller compact_bitset words, the same bit of the same byte range).
+///
+/// Both sides work through a 64-bit accumulator, so writing or reading up to 64 bits is a couple of shifts rather than
+/// a loop over bits. A writer either owns a growable word vector, whose storage can be handed off without copying, or
+/// writes in place into an existing compact_bitset.
+
+/// bit_writer sink that appends to a std::vector<std::uint64_t> it owns
+class vector_word_sink
+{
+    std::vector<std::uint64_t> words;
+public:
+    static constexpr std::size_t capacity() noexcept { return ~std::size_t(0); }
+    /// store word i; i is either the index of the last word stored (to update a partial word), or one past it
+    void put(std::size_t i, std::uint64_t w) {
+        if (i < words.size()) words[i] = w;
+        else words.push_back(w);
+    }
+    void reserve(std::size_t nwords) { words.reserve(nwords); }
+    std::vector<std::uint64_t> release() noexcept { return std::move(words); }
+    const std::vector<std::uint64_t> & get() const noexcept { return words; }
+};
+
+/// bit_writer sink that writes in place into an existing compact_bitset (whose capacity is N bits)
+template <std::size_t N, typename T>
+class bitset_word_sink
+{
+    static constexpr std::size_t TBits = compact_bitset<N, T>::word_bits, PerWord = 64 / TBits;
+    compact_bitset<N, T> *bs;
+public:
+    explicit bitset_word_sink(compact_bitset<N, T> &b) noexcept : bs(&b) {}
+    static constexpr std::size_t capacity() noexcept { return N; }
+    void put(std::size_t i, std::uint64_t w) noexcept {
+        for (std::size_t j = 0; j < PerWord && i * PerWord + j < bs->num_words(); ++j)
+            bs->set_word(i * PerWord + j, T(w >> (j * TBits)));
+    }
+    compact_bitset<N, T> & get() const noexcept { return *bs; }
+};
+
+/// bit_reader source over an array of 64-bit words
+class word_span_source
+{
+    const std::uint64_t *words;
+public:
+    explicit word_span_source(const std::uint64_t *w) noexcept : words(w) {}
+    std::uint64_t fetch(std::size_t i) const noexcept { return words[i]; }
+};
+
+/// bit_reader source over a compact_bitset
+template <std::size_t N, typename T>
+class bitset_word_source
+{
+    static constexpr std::size_t TBits = compact_bitset<N, T>::word_bits, PerWord = 64 / TBits;
+    const compact_bitset<N, T> *bs;
+public:
+    explicit bitset_word_source(const compact_bitset<N, T> &b) noexcept : bs(&b) {}
+    std::uint64_t fetch(std::size_t i) const noexcept {
+        std::uint64_t ret = 0;
+        for (std::size_t j = 0; j < PerWord && i * PerWord + j < bs->num_words(); ++j)
+            ret |= std::uint64_t(bs->word(i * PerWord + j)) << (j * TBits);
+        return ret;
+    }
+};
+
+/// Appends bits and variable-length codes to a Sink, 64 bits at a time.
+///
+/// Codes are written least-significant-bit first, so that a reader can decode them with shifts and ctz:
+///  - unary(v): v zero bits, then a one bit
+///  - gamma(v), v >= 1: unary(floor(log2 v)), then the bits of v below its leading one
+///  - delta(v), v >= 1: gamma(floor(log2 v) + 1), then the bits of v below its leading one
+///  - rice(v, k): unary(v >> k), then the low k bits of v
+///  - varint(v): groups of 7 bits, low group first, each followed by a continuation bit (i.e. LEB128 bytes)
+template <typename Sink = vector_word_sink>
+class bit_writer
+{
+    Sink sink;
+    std::uint64_t acc = 0; ///< bits not yet stored as a full word
+    unsigned accBits = 0;
+    std::size_t nfull = 0; ///< number of full words stored
+
+    void throw_if_full(std::size_t n) const {
+        if (n > sink.capacity() - size()) throw std::out_of_range("bit_writer capacity exceeded");
+    }
+public:
+    bit_writer() = default;
+    /// construct the Sink from `arg`, e.g. the compact_bitset to write into
+    template <typename Arg, std::enable_if_t<!std::is_same_v<std::decay_t<Arg>, bit_writer>, int> = 0>
+    explicit bit_writer(Arg &&arg) : sink(std::forward<Arg>(arg)) {}
+
+    /// returns the number of bits written so far
+    std::size_t size() const noexcept { return nfull * 64 + accBits; }
+
+    /// write the low n (<= 64) bits of v
+    bit_writer & write(std::uint64_t v, unsigned n) {
+        if (!n) return *this;
+        throw_if_full(n);
+        v &= bit_util::low_mask(n);
+        acc |= v << accBits; // accBits < 64 always
+        if (accBits + n < 64) {
+            accBits += n;
+            return *this;
+        }
+        sink.put(nfull++, acc);
+        const unsigned used = 64 - accBits; // bits of v that went into the stored word
+        acc = used < 64 ? v >> used : 0;
+        accBits = n - used;
+        return *this;
+    }
+    bit_writer & write_bit(bool b) { return write(b, 1); }
+    /// write v zero bits then a one bit
+    bit_writer & write_unary(std::uint64_t v) {
+        for (; v >= 64; v -= 64) write(0, 64);
+        return write(std::uint64_t(1) << v, unsigned(v) + 1);
+    }
+    /// Elias gamma code of v -- throws std::invalid_argument if v == 0
+    bit_writer & write_gamma(std::uint64_t v) {
+        if (!v) throw std::invalid_argument("Elias gamma code cannot represent 0");
+        const unsigned nb = unsigned(bit_util::log2(v));
+        write_unary(nb);
+        return write(v, nb);
+    }
+    /// Elias delta code of v -- throws std::invalid_argument if v == 0
+    bit_writer & write_delta(std::uint64_t v) {
+        if (!v) throw std::invalid_argument("Elias delta code cannot represent 0");
+        const unsigned nb = unsigned(bit_util::log2(v));
+        write_gamma(nb + 1);
+        return write(v, nb);
+    }
+    /// Golomb-Rice code of v with parameter k (< 64)
+    bit_writer & write_rice(std::uint64_t v, unsigned k) {
+        write_unary(v >> k);
+        return write(v, k);
+    }
+    /// LEB128-style varint of v
+    bit_writer & write_varint(std::uint64_t v) {
+        for (; v >= 0x80; v >>= 7) write((v & 0x7F) | 0x80, 8);
+        return write(v, 8);
+    }
+
+    /// Store any partially filled last word to the sink. Writing may continue afterwards.
+    bit_writer & flush() {
+        if (accBits) sink.put(nfull, acc);
+        return *this;
+    }
+    /// access the sink (call flush() first to see the last partial word)
+    const Sink & get_sink() const noexcept { return sink; }
+
+    /// Flush, and hand off the words written, leaving the writer empty. Only for a vector_word_sink.
+    template <typename S = Sink, std::enable_if_t<std::is_same_v<S, vector_word_sink>, int> = 0>
+    std::vector<std::uint64_t> release() {
+        flush();
+        acc = 0;
+        accBits = 0;
+        nfull = 0;
+        return sink.release();
+    }
+    /// Flush, and move the words written into a rank_select_bitvector without copying them. Only for a
+    /// vector_word_sink.
+    template <typename S = Sink, std::enable_if_t<std::is_same_v<S, vector_word_sink>, int> = 0>
+    rank_select_bitvector release_bitvector() {
+        const std::size_t n = size();
+        return rank_select_bitvector(release(), n);
+    }
+};
+
+/// Reads bits and the variable-length codes written by bit_writer from a Source, 64 bits at a time.
+/// Reading past the end throws std::out_of_range.
+template <typename Source = word_span_source>
+class bit_reader
+{
+    Source src;
+    std::size_t nbits;
+    std::size_t pos = 0; ///< number of bits consumed
+    std::size_t nextWord = 0;
+    std::uint64_t acc = 0; ///< the next accBits bits of the stream, in the low bits
+    unsigned accBits = 0;
+
+    void throw_if_past_end(std::size_t n) const {
+        if (n > nbits - pos) throw std::out_of_range("bit_reader read past the end of the stream");
+    }
+public:
+    /// read `n` bits from a Source constructed from `args`
+    template <typename... Args>
+    explicit bit_reader(std::size_t n, Args &&...args) : src(std::forward<Args>(args)...), nbits(n) {}
+
+    std::size_t size() const noexcept { return nbits; }
+    /// returns the number of bits read so far
+    std::size_t position() const noexcept { return pos; }
+    bool at_end() const noexcept { return pos >= nbits; }
+    /// continue reading from bit position p -- throws std::out_of_range if p > size()
+    void seek(std::size_t p) {
+        if (p > nbits) throw std::out_of_range("bit_reader seek past the end of the stream");
+        pos = p;
+        nextWord = p / 64;
+        acc = 0;
+        accBits = 0;
+        if (const unsigned skip = unsigned(p % 64)) {
+            acc = src.fetch(nextWord++) >> skip;
+            accBits = 64 - skip;
+        }
+    }
+
+    /// read n (<= 64) bits
+    std::uint64_t read(unsigned n) {
+        if (!n) return 0;
+        throw_if_past_end(n);
+        pos += n;
+        if (n <= accBits) {
+            const std::uint64_t ret = acc & bit_util::low_mask(n);
+            acc = n < 64 ? acc >> n : 0;
+            accBits -= n;
+            return ret;
+        }
+        const std::uint64_t w = src.fetch(nextWord++);
+        const unsigned have = accBits, need = n - have;
+        const std::uint64_t ret = (acc | w << have) & bit_util::low_mask(n); // have < 64 here
+        acc = need < 64 ? w >> need : 0;
+        accBits = 64 - need;
+        return ret;
+    }
+    bool read_bit() { return read(1); }
+    /// read a unary code: the number of zero bits before the next one bit
+    std::uint64_t read_unary() {
+        std::uint64_t ret = 0;
+        while (!acc) {
+            // no one bit buffered: consume what's buffered, and refill
+            throw_if_past_end(accBits + 1);
+            ret += accBits;
+            pos += accBits;
+            acc = src.fetch(nextWord++);
+            accBits = 64;
+        }
+        const unsigned z = unsigned(bit_util::ctz(acc));
+        throw_if_past_end(z + 1);
+        read(z + 1);
+        return ret + z;
+    }
+    std::uint64_t read_gamma() {
+        const unsigned nb = unsigned(read_unary());
+        if (nb > 63) throw std::invalid_argument("Invalid Elias gamma code");
+        return std::uint64_t(1) << nb | read(nb);
+    }
+    std::uint64_t read_delta() {
+        const std::uint64_t nb = read_gamma() - 1;
+        if (nb > 63) throw std::invalid_argument("Invalid Elias delta code");
+        return std::uint64_t(1) << nb | read(unsigned(nb));
+    }
+    std::uint64_t read_rice(unsigned k) {
+        const std::uint64_t q = read_unary();
+        return q << k | read(k);
+    }
+    std::uint64_t read_varint() {
+        std::uint64_t ret = 0;
+        for (unsigned shift = 0; ; shift += 7) {
+            const std::uint64_t byte = read(8);
+            if (shift < 64) ret |= (byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return ret;
+        }
+    }
+};
+
+/// convenience: a reader over a word vector
+inline bit_reader<word_span_source> make_bit_reader(const std::vector<std::uint64_t> &words, std::size_t nbits) {
+    if (nbits > words.size() * 64) throw std::invalid_argument("Word array is too small for the specified number of bits");
+    return bit_reader<word_span_source>(nbits, words.data());
+}
+/// convenience: a reader over all N bits of a compact_bitset
+template <std::size_t N, typename T>
+bit_reader<bitset_word_source<N, T>> make_bit_reader(const compact_bitset<N, T> &bs) { return bit_reader<bitset_word_source<N, T>>(N, bs); }
+/// convenience: a writer that writes in place into a compact_bitset, starting at bit 0
+template <std::size_t N, typename T>
+bit_writer<bitset_word_sink<N, T>> make_bit_writer(compact_bitset<N, T> &bs) { return bit_writer<bitset_word_sink<N, T>>(bs); }
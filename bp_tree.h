@@ -0,0 +1,267 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bit_util.h"
+#include "compact_bitset.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef> // for std::byte
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/// A static ordinal tree stored succinctly as a balanced-parentheses (BP) bit sequence: a depth-first traversal that
+/// writes a 1 ("(") on entering a node and a 0 (")") on leaving it, so a tree of n nodes takes 2n bits.
+///
+/// Nodes are identified by the position of their opening parenthesis (the root is 0). Navigation reduces to searching
+/// for the nearest position with a given excess (opens minus closes so far), which is answered with a range-min tree
+/// over 1024-bit blocks, plus byte lookup tables within a block. The index adds ~0.2 bits per node on top of the 2
+/// bits per node for the parentheses themselves. Trees of up to 2^32 - 1 nodes are supported.
+class bp_tree
+{
+public:
+    /// a node handle: the position of the node's opening parenthesis
+    using node = std::size_t;
+    /// returned by navigation functions when there is no such node
+    static constexpr node npos = std::numeric_limits<node>::max();
+private:
+    using Word = std::uint64_t;
+    using Excess = std::int64_t;
+    static constexpr std::size_t WBits = 64, BlockWords = 16, BlockBits = BlockWords * WBits;
+    static constexpr std::uint32_t NoMin = std::numeric_limits<std::uint32_t>::max(); ///< min-tree padding
+
+    std::vector<Word> words; // unused bits in this array are always 0
+    std::size_t nbits = 0;
+    std::vector<std::uint32_t> blockExcess; ///< excess before each block, plus a final entry for the end
+    std::vector<std::uint32_t> minTree; ///< complete binary tree: leaf L + b holds the min excess within block b
+    std::size_t nleaves = 1;
+
+    /// byte lookup tables for scanning 8 parentheses at a time
+    struct ByteTables {
+        std::array<std::int8_t, 256> delta{}; ///< excess change over the byte
+        std::array<std::int8_t, 256> fwdMin{}; ///< min excess change over prefixes of length 1..8
+        std::array<std::int8_t, 256> bwdMax{}; ///< max excess change over suffixes of length 1..8
+        constexpr ByteTables() {
+            for (unsigned b = 0; b < 256; ++b) {
+                int e = 0, mn = 8, s = 0, mx = -8;
+                for (unsigned i = 0; i < 8; ++i) {
+                    e += (b >> i & 0x1) ? 1 : -1;
+                    mn = std::min(mn, e);
+                    s += (b >> (7 - i) & 0x1) ? 1 : -1;
+                    mx = std::max(mx, s);
+                }
+                delta[b] = std::int8_t(e);
+                fwdMin[b] = std::int8_t(mn);
+                bwdMax[b] = std::int8_t(mx);
+            }
+        }
+    };
+    static const ByteTables & byte_tables() noexcept { static constexpr ByteTables t{}; return t; }
+
+    bool bit(std::size_t pos) const noexcept { return words[pos / WBits] >> (pos % WBits) & 0x1; }
+    static Excess step(bool b) noexcept { return b ? 1 : -1; }
+    unsigned byte_at(std::size_t pos) const noexcept { return unsigned(words[pos / WBits] >> (pos % WBits)) & 0xFF; } // pos % 8 == 0
+    std::size_t num_blocks() const noexcept { return (nbits + BlockBits - 1) / BlockBits; }
+    std::size_t block_end(std::size_t b) const noexcept { return std::min(nbits, (b + 1) * BlockBits); }
+
+    // Returns the first position j in [from, to) with excess(j) == t, given e = excess(from - 1) > t, or npos.
+    std::size_t fwd_scan(std::size_t from, std::size_t to, Excess e, Excess t) const noexcept {
+        const ByteTables &tables = byte_tables();
+        std::size_t j = from;
+        for (; j < to && j % 8; ++j)
+            if ((e += step(bit(j))) == t) return j;
+        for (; j + 8 <= to; j += 8) {
+            const unsigned byte = byte_at(j);
+            if (e + tables.fwdMin[byte] <= t) break; // it's in this byte
+            e += tables.delta[byte];
+        }
+        for (; j < to; ++j)
+            if ((e += step(bit(j))) == t) return j;
+        return npos;
+    }
+    // Returns the last position j in [lo, p) with excess(j) == t, given e = excess(p) > t, or npos.
+    std::size_t bwd_scan(std::size_t p, std::size_t lo, Excess e, Excess t) const noexcept {
+        const ByteTables &tables = byte_tables();
+        for (; p > lo && p % 8 != 7; )
+            if ((e -= step(bit(p--))) == t) return p;
+        for (; p >= lo + 8 && p % 8 == 7; p -= 8) {
+            const unsigned byte = byte_at(p - 7);
+            if (e - tables.bwdMax[byte] <= t) break; // it's in this byte
+            e -= tables.delta[byte];
+        }
+        for (; p > lo; )
+            if ((e -= step(bit(p--))) == t) return p;
+        return npos;
+    }
+    // Returns the first position j > i with excess(j) == t, where t < excess(i), or npos.
+    std::size_t fwd_search(std::size_t i, Excess t) const noexcept {
+        std::size_t b = i / BlockBits;
+        if (const auto j = fwd_scan(i + 1, block_end(b), excess(i), t); j != npos) return j;
+        // climb the min tree to the nearest block to the right that dips to t, then descend to its leftmost such leaf
+        std::size_t v = nleaves + b;
+        for (; v > 1; v /= 2)
+            if (!(v & 0x1) && minTree[v + 1] <= t) { ++v; break; }
+        if (v <= 1) return npos;
+        while (v < nleaves) v = minTree[2 * v] <= t ? 2 * v : 2 * v + 1;
+        b = v - nleaves;
+        return fwd_scan(b * BlockBits, block_end(b), blockExcess[b], t);
+    }
+    // Returns the last position j < i with excess(j) == t, where 0 <= t < excess(i). Returns npos if that is the
+    // (virtual) position -1, whose excess is 0.
+    std::size_t bwd_search(std::size_t i, Excess t) const noexcept {
+        std::size_t b = i / BlockBits;
+        if (const auto j = bwd_scan(i, b * BlockBits, excess(i), t); j != npos) return j;
+        // climb the min tree to the nearest block to the left that dips to t, then descend to its rightmost such leaf
+        std::size_t v = nleaves + b;
+        for (; v > 1; v /= 2)
+            if ((v & 0x1) && minTree[v - 1] <= t) { --v; break; }
+        if (v <= 1) return npos;
+        while (v < nleaves) v = minTree[2 * v + 1] <= t ? 2 * v + 1 : 2 * v;
+        b = v - nleaves;
+        const std::size_t last = block_end(b) - 1;
+        if (Excess(blockExcess[b + 1]) == t) return last;
+        return bwd_scan(last, b * BlockBits, blockExcess[b + 1], t);
+    }
+    void build_index() {
+        if (nbits / 2 >= NoMin) throw std::length_error("bp_tree supports at most 2^32 - 1 nodes");
+        const std::size_t nblocks = num_blocks();
+        nleaves = 1;
+        while (nleaves < nblocks) nleaves *= 2;
+        blockExcess.assign(nblocks + 1, 0);
+        minTree.assign(2 * nleaves, NoMin);
+        Excess e = 0;
+        for (std::size_t b = 0; b < nblocks; ++b) {
+            blockExcess[b] = std::uint32_t(e);
+            Excess mn = std::numeric_limits<Excess>::max();
+            for (std::size_t j = b * BlockBits; j < block_end(b); ++j) {
+                e += step(bit(j));
+                if (e < 0) throw std::invalid_argument("Unbalanced parentheses specified to bp_tree");
+                mn = std::min(mn, e);
+            }
+            minTree[nleaves + b] = std::uint32_t(mn);
+        }
+        if (e != 0) throw std::invalid_argument("Unbalanced parentheses specified to bp_tree");
+        blockExcess[nblocks] = 0;
+        for (std::size_t v = nleaves; v-- > 1; )
+            minTree[v] = std::min(minTree[2 * v], minTree[2 * v + 1]);
+    }
+    void throw_if_not_node(node v) const {
+        if (v >= nbits || !bit(v)) throw std::out_of_range("Invalid node specified to bp_tree");
+    }
+public:
+    /// Appends parentheses one at a time, e.g. while walking a pointer-based tree depth-first, then builds a bp_tree.
+    class builder {
+        std::vector<Word> words;
+        std::size_t nbits = 0;
+        void push(bool b) {
+            if (nbits % WBits == 0) words.push_back(0);
+            words.back() |= Word(b) << (nbits++ % WBits);
+        }
+    public:
+        /// enter a new node (a child of the current node, or the root)
+        void open() { push(true); }
+        /// leave the current node
+        void close() { push(false); }
+        /// @throws std::invalid_argument if the parentheses are not balanced
+        bp_tree build() { return bp_tree(std::move(words), std::exchange(nbits, 0)); }
+    };
+
+    /// construct an empty tree
+    bp_tree() : blockExcess(1, 0), minTree(2, NoMin) {}
+    /// Take ownership of `nbits` parentheses stored in `words` (1 = open, 0 = close; bit j of words[i] is parenthesis
+    /// i * 64 + j), and build the index.
+    /// @throws std::invalid_argument if the parentheses are not balanced
+    bp_tree(std::vector<std::uint64_t> wordsIn, std::size_t nbitsIn) : words(std::move(wordsIn)), nbits(nbitsIn) {
+        if (words.size() * WBits < nbits) throw std::invalid_argument("Word array is too small for the specified number of bits");
+        words.resize((nbits + WBits - 1) / WBits);
+        if (const std::size_t rem = nbits % WBits; rem) words.back() &= bit_util::low_mask(unsigned(rem));
+        build_index();
+    }
+    /// copy the parentheses from a compact_bitset, and build the index
+    /// @throws std::invalid_argument if the parentheses are not balanced
+    template <std::size_t N, typename T>
+    explicit bp_tree(const compact_bitset<N, T> &bs) : words((N + WBits - 1) / WBits), nbits(N) {
+        for (std::size_t i = 0; i < bs.num_words(); ++i) {
+            const std::size_t bitpos = i * bs.word_bits;
+            words[bitpos / WBits] |= Word(bs.word(i)) << (bitpos % WBits);
+        }
+        build_index();
+    }
+
+    /// returns the number of nodes in the tree
+    std::size_t size() const noexcept { return nbits / 2; }
+    bool empty() const noexcept { return nbits == 0; }
+    /// returns the root node, or npos if the tree is empty
+    node root() const noexcept { return nbits ? 0 : npos; }
+    /// returns the number of bytes used, including the index
+    std::size_t bytes_used() const noexcept {
+        return words.size() * sizeof(Word) + (blockExcess.size() + minTree.size()) * sizeof(std::uint32_t);
+    }
+
+    /// returns the excess (number of opens minus number of closes) over positions [0, i]. i must be < 2 * size().
+    Excess excess(std::size_t i) const noexcept {
+        const std::size_t b = i / BlockBits, wEnd = i / WBits;
+        std::size_t ones = 0;
+        for (std::size_t w = b * BlockWords; w < wEnd; ++w) ones += unsigned(bit_util::popcount(words[w]));
+        ones += unsigned(bit_util::popcount(words[wEnd] & bit_util::low_mask(unsigned(i % WBits + 1))));
+        return Excess(blockExcess[b]) + 2 * Excess(ones) - Excess(i - b * BlockBits + 1);
+    }
+
+    /// returns the position of the parenthesis that closes node v
+    std::size_t find_close(node v) const { throw_if_not_node(v); return fwd_search(v, excess(v) - 1); }
+    /// returns the depth of node v (the root has depth 0)
+    std::size_t depth(node v) const { throw_if_not_node(v); return std::size_t(excess(v) - 1); }
+    /// returns the number of nodes in the subtree rooted at v, including v
+    std::size_t subtree_size(node v) const { return (find_close(v) - v + 1) / 2; }
+    /// returns the index of node v in a preorder traversal (the root is 0)
+    std::size_t preorder(node v) const { throw_if_not_node(v); return std::size_t(Excess(v) + excess(v) - 1) / 2; }
+    /// returns true if node v has no children
+    bool is_leaf(node v) const { throw_if_not_node(v); return !bit(v + 1); }
+
+    /// returns the parent of node v, or npos if v is a root
+    node parent(node v) const {
+        throw_if_not_node(v);
+        const Excess e = excess(v);
+        if (e == 1) return npos; // v is a root
+        // the parent opened right after the last position before v whose excess was 2 less than v's
+        const std::size_t j = bwd_search(v, e - 2);
+        return j == npos ? 0 : j + 1;
+    }
+    /// returns the first child of node v, or npos if v is a leaf
+    node first_child(node v) const { return is_leaf(v) ? npos : v + 1; }
+    /// returns the next sibling of node v, or npos if v is the last child of its parent
+    node next_sibling(node v) const {
+        const std::size_t c = find_close(v);
+        return c + 1 < nbits && bit(c + 1) ? c + 1 : npos;
+    }
+
+    /// access to the underlying parentheses. Note that bits in this array that are unused are guaranteed to be 0
+    const std::byte *bits() const noexcept { return reinterpret_cast<const std::byte *>(words.data()); }
+    /// returns the number of bytes in the .bits() array
+    std::size_t bits_size() const noexcept { return words.size() * sizeof(Word); }
+};
@@ -0,0 +1,60 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include <cstddef>
+#include <utility>
+
+/// The cache line size assumed for padding, in bytes. 64 is right for x86-64 and most ARM cores; define this to 128
+/// on Apple silicon or when adjacent-line prefetching makes pairs of lines behave as one.
+/// (std::hardware_destructive_interference_size is deliberately not used: its value may differ between translation
+/// units built with different -mtune flags, which would make the layouts below an ODR hazard.)
+#ifndef COMPACT_BITSET_CACHE_LINE
+#define COMPACT_BITSET_CACHE_LINE 64
+#endif
+
+constexpr std::size_t cache_line_size = COMPACT_BITSET_CACHE_LINE;
+static_assert(cache_line_size && !(cache_line_size & (cache_line_size - 1)), "COMPACT_BITSET_CACHE_LINE must be a power of 2");
+
+/// Alignment/padding policy: a V that starts on an Align-byte boundary and whose size is rounded up to a multiple of
+/// Align, so that no two cache_padded objects ever share a cache line. Use it for arrays of objects that are written
+/// by different threads, e.g. std::array<cache_padded<compact_bitset<256>>, 64> instead of
+/// std::array<compact_bitset<256>, 64>, where neighbouring 32-byte bitsets would otherwise share lines ("false
+/// sharing") and every write by one core would invalidate the line in the cache of the other.
+///
+/// Align = 1 means "no padding" (the natural alignment of V still applies), which is handy for comparing layouts.
+template <typename V, std::size_t Align = cache_line_size>
+struct alignas(Align > alignof(V) ? Align : alignof(V)) cache_padded {
+    static_assert(Align && !(Align & (Align - 1)), "Align must be a power of 2");
+    V value{};
+
+    constexpr cache_padded() = default;
+    template <typename... Args>
+    constexpr explicit cache_padded(std::in_place_t, Args &&...args) : value(std::forward<Args>(args)...) {}
+
+    constexpr V & operator*() noexcept { return value; }
+    constexpr const V & operator*() const noexcept { return value; }
+    constexpr V * operator->() noexcept { return &value; }
+    constexpr const V * operator->() const noexcept { return &value; }
+};
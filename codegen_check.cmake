@@ -0,0 +1,33 @@
+# Disassembles the library built from codegen_check.cpp and checks that each single-word compact_bitset function
+# compiled to straight-line code using the expected instruction.
+# Usage: cmake -DOBJDUMP=<objdump> -DOBJ=<libcompact_bitset_codegen.a> -P codegen_check.cmake
+execute_process(COMMAND "${OBJDUMP}" -d --no-show-raw-insn "${OBJ}"
+                OUTPUT_VARIABLE disasm RESULT_VARIABLE rc)
+if (NOT rc EQUAL 0)
+    message(FATAL_ERROR "${OBJDUMP} failed on ${OBJ}")
+endif()
+
+# function name -> instruction that must appear in its body
+set(expected
+    cb_count64 popcnt  cb_equal64 cmp  cb_and64 and
+    cb_count20 popcnt  cb_equal20 cmp  cb_and20 and)
+
+list(LENGTH expected n)
+math(EXPR last "${n} - 1")
+foreach (i RANGE 0 ${last} 2)
+    math(EXPR j "${i} + 1")
+    list(GET expected ${i} func)
+    list(GET expected ${j} insn)
+    # the body is everything between "<func>:" and the next blank line
+    string(REGEX MATCH "<${func}>:\n[^\n]+(\n[^\n]+)*" body "${disasm}")
+    if (NOT body)
+        message(FATAL_ERROR "${func}: not found in disassembly")
+    endif()
+    if (NOT body MATCHES "[ \t]${insn}[a-z]*[ \t]")
+        message(FATAL_ERROR "${func}: expected a '${insn}' instruction:\n${body}")
+    endif()
+    if (body MATCHES "[ \t](j[a-z]+|call[a-z]*|loop[a-z]*)[ \t]")
+        message(FATAL_ERROR "${func}: expected straight-line code, found a branch or call:\n${body}")
+    endif()
+    message(STATUS "${func}: ok")
+endforeach()
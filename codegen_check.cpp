@@ -0,0 +1,16 @@
+// Not a test program: this translation unit is only compiled into a static library so that the "codegen" test
+// (see codegen_check.cmake) can disassemble it and check that single-word compact_bitset operations compile down to
+// the same handful of instructions as the equivalent operations on a bare integer.
+#include "compact_bitset.h"
+
+#include <cstddef>
+
+extern "C" {
+std::size_t cb_count64(const compact_bitset<64> &a) { return a.count(); }
+bool cb_equal64(const compact_bitset<64> &a, const compact_bitset<64> &b) { return a == b; }
+compact_bitset<64> cb_and64(const compact_bitset<64> &a, const compact_bitset<64> &b) { return a & b; }
+
+std::size_t cb_count20(const compact_bitset<20> &a) { return a.count(); }
+bool cb_equal20(const compact_bitset<20> &a, const compact_bitset<20> &b) { return a == b; }
+compact_bitset<20> cb_and20(const compact_bitset<20> &a, const compact_bitset<20> &b) { return a & b; }
+}
@@ -25,6 +25,7 @@
 #pragma once
 #include <algorithm>
 #include <array>
+#include <cassert>
 #include <cstddef> // for std::byte
 #include <cstdint>
 #include <cstring> // for std::memcpy
@@ -36,6 +37,17 @@
 #include <string>
 #include <type_traits>
 
+/// Bounds checking of the position passed to set(pos), reset(pos), flip(pos) and test(pos):
+///   2 - throw std::out_of_range, like std::bitset (the default)
+///   1 - assert() only, so checked in debug builds and free in NDEBUG builds
+///   0 - no checking at all
+/// This must be the same in every translation unit of a program. Regardless of the setting, the *_unchecked()
+/// members and operator[] never check.
+#ifndef COMPACT_BITSET_BOUNDS_CHECK
+#define COMPACT_BITSET_BOUNDS_CHECK 2
+#endif
+static_assert(COMPACT_BITSET_BOUNDS_CHECK >= 0 && COMPACT_BITSET_BOUNDS_CHECK <= 2, "COMPACT_BITSET_BOUNDS_CHECK must be 0, 1 or 2");
+
 /// A drop-in replacement for std::bitset that doesn't waste memory if the bitset is small. It tries to use
 /// the minimal word size it can for small bitsets, otherwise it defaults to using 64-bit words.
 template<std::size_t N,
@@ -54,6 +66,10 @@ class compact_bitset
     static constexpr std::size_t NWords = NFullyUsedWords + bool(NBitsRem);
     static constexpr T AllMask = ~T(0);
     static constexpr T LastWordMask = (T(1) << NBitsRem) - 1;
+    // When the whole bitset fits in one word (always the case for N <= 64), every operation below reduces to one or
+    // two instructions on data[0] via `if constexpr (SingleWord)`; std::array<T, 1> has the same layout as a bare T.
+    static constexpr bool SingleWord = NWords == 1;
+    static constexpr T UsedMask = LastWordMask != 0 ? LastWordMask : AllMask; ///< the used bits of the (only) word
     using DataArray = std::array<T, NWords>;
     DataArray data; // unused bits in this array are always 0
 public:
@@ -77,14 +93,20 @@ public:
 private:
     constexpr reference make_ref(std::size_t i) noexcept { return reference(data[i / TBits], i % TBits); }
     constexpr const reference make_ref(std::size_t i) const noexcept { return const_cast<compact_bitset &>(*this).make_ref(i); }
-    void throw_if_out_of_range(std::size_t pos) const {
+    static constexpr bool ChecksThrow = COMPACT_BITSET_BOUNDS_CHECK == 2;
+    constexpr void throw_if_out_of_range([[maybe_unused]] std::size_t pos) const noexcept(!ChecksThrow) {
+#if COMPACT_BITSET_BOUNDS_CHECK == 2
         if (pos >= size()) throw std::out_of_range("Out-of-range bit position specified to compact_bitset");
+#elif COMPACT_BITSET_BOUNDS_CHECK == 1
+        assert(pos < size());
+#endif
     }
     template <typename Int>
-    Int do_int_convert() const noexcept {
+    constexpr Int do_int_convert() const noexcept {
         if constexpr (N == 0) return 0;
+        if constexpr (SingleWord) return Int(data[0]); // callers ensure N fits in Int
         Int ret{};
-        static constexpr std::size_t IntBits = sizeof(ret) * 8;
+        constexpr std::size_t IntBits = sizeof(ret) * 8;
         std::size_t bitOffset = 0;
         const auto handle_word = [&bitOffset, &ret](auto word) {
             while (word) {
@@ -107,7 +129,7 @@ private:
     }
     // helper that uses intrinsics to count the number of set bits in a word
     template <typename Int, std::enable_if_t<std::is_integral_v<Int>, int> = 0>
-    static int get_popcount(const Int word) {
+    static constexpr int get_popcount(const Int word) noexcept {
 #if defined(__clang__) || defined(__GNUC__)
         if constexpr (sizeof(Int) <= sizeof(unsigned long long)) {
             using UInt = std::make_unsigned_t<Int>;
@@ -129,7 +151,7 @@ private:
     }
     // helper that uses intrinsics to get one-plus the index of the first set bit
     template <typename Int, std::enable_if_t<std::is_integral_v<Int>, int> = 0>
-    static int ffs(const Int word) {
+    static constexpr int ffs(const Int word) noexcept {
 #if defined(__clang__) || defined(__GNUC__)
         if constexpr (sizeof(Int) <= sizeof(unsigned long long)) {
             using SInt = std::make_signed_t<Int>;
@@ -150,14 +172,34 @@ private:
         }
         return 0;
     }
-    struct Uninitialized_t {};
-    static constexpr Uninitialized_t Uninitialized{};
-    constexpr compact_bitset(const Uninitialized_t &) noexcept {} // uninitialized c'tor
+    // helper that uses intrinsics to get one-plus the index of the last (most significant) set bit, or 0 if none
+    template <typename Int, std::enable_if_t<std::is_integral_v<Int>, int> = 0>
+    static constexpr int fls(const Int word) noexcept {
+        if (!word) return 0;
+#if defined(__clang__) || defined(__GNUC__)
+        if constexpr (sizeof(Int) <= sizeof(unsigned long long)) {
+            using UInt = std::make_unsigned_t<Int>;
+            const UInt uword = static_cast<UInt>(word);
+            if constexpr (sizeof(uword) <= sizeof(unsigned int))
+                return int(sizeof(unsigned int) * 8) - __builtin_clz(static_cast<unsigned int>(uword));
+            else
+                return int(sizeof(unsigned long long) * 8) - __builtin_clzll(static_cast<unsigned long long>(uword));
+        }
+#endif
+        // fall back to slow method if no builtin_clz or if operating on __int128_t
+        int i = int(sizeof(word) * 8);
+        while (!(word & (Int(0x1) << (i - 1)))) --i;
+        return i;
+    }
 public:
     // default-construct: all bits are 0
     constexpr compact_bitset() noexcept : data{{}} {}
     // initialize with bits from val
     constexpr compact_bitset(unsigned long long val) noexcept : compact_bitset() {
+        if constexpr (SingleWord) {
+            data[0] = T(val) & UsedMask; // bits of val that we cannot store are dropped
+            return;
+        }
         // on gcc & clang the below is hopefully fast as it uses intrinsics
         while (val) {
             const auto bit = std::size_t(ffs(val) - 1); // will be in the range [0, 63]
@@ -191,45 +233,54 @@ public:
                             CharT zero = CharT('0'), CharT one = CharT('1'))
         : compact_bitset(n == std::basic_string<CharT>::npos ? std::basic_string<CharT>(str) : std::basic_string<CharT>(str, n), 0, n, zero, one) {}
 
-    // copy-construct
-    constexpr compact_bitset(const compact_bitset &o) noexcept { *this = o; }
-
-    // copy-assign
-    constexpr compact_bitset &operator=(const compact_bitset &o) noexcept {
-        // we do it this way rather than use std::copy in order to support constexpr on pre-C++20
-        if constexpr (N > 0) data = o.data;
-        return *this;
-    }
+    // copy-construct & copy-assign: defaulted so that the class stays trivially copyable (a single-word bitset
+    // is then passed and returned in a register, just like the bare word it wraps)
+    constexpr compact_bitset(const compact_bitset &) noexcept = default;
+    constexpr compact_bitset &operator=(const compact_bitset &) noexcept = default;
 
     constexpr reference operator[](std::size_t pos) noexcept { return make_ref(pos); }
     constexpr bool operator[](std::size_t pos) const noexcept { return make_ref(pos); }
     static constexpr std::size_t size() noexcept { return N; }
 
-    bool test(std::size_t pos) const { throw_if_out_of_range(pos); return (*this)[pos]; }
+    /// returns the bit at position pos -- throws std::out_of_range if pos >= size() (see COMPACT_BITSET_BOUNDS_CHECK)
+    bool test(std::size_t pos) const noexcept(!ChecksThrow) { throw_if_out_of_range(pos); return (*this)[pos]; }
+    /// like test(pos) but never checks pos, for hot loops whose indices are already known to be valid
+    constexpr bool test_unchecked(std::size_t pos) const noexcept { return (*this)[pos]; }
 
     /// returns the number of bits set to true
-    std::size_t count() const noexcept;
+    constexpr std::size_t count() const noexcept;
     /// returns true if all bits are true (return true also if size() == 0)
-    bool all() const noexcept;
+    constexpr bool all() const noexcept;
     /// returns true if any of the bits are true
-    bool any() const noexcept;
+    constexpr bool any() const noexcept;
     /// returns true if none of the bits are true
-    bool none() const noexcept { return !any(); }
+    constexpr bool none() const noexcept { return !any(); }
+
+    /// returns the index of the lowest set bit, or size() if no bits are set
+    constexpr std::size_t find_first() const noexcept;
+    /// returns the index of the highest set bit, or size() if no bits are set
+    constexpr std::size_t find_last() const noexcept;
 
     /// set all bits to true
-    compact_bitset & set() noexcept;
+    constexpr compact_bitset & set() noexcept;
     /// set a specific bit -- throws std::out_of_range if pos >= size()
-    compact_bitset & set(std::size_t pos, bool value = true) { throw_if_out_of_range(pos); (*this)[pos] = value; return *this; }
+    compact_bitset & set(std::size_t pos, bool value = true) noexcept(!ChecksThrow) { throw_if_out_of_range(pos); (*this)[pos] = value; return *this; }
+    /// like set(pos, value) but never checks pos
+    constexpr compact_bitset & set_unchecked(std::size_t pos, bool value = true) noexcept { (*this)[pos] = value; return *this; }
 
     /// sets all bits to false
-    compact_bitset & reset() noexcept { return *this = compact_bitset(); }
+    constexpr compact_bitset & reset() noexcept { return *this = compact_bitset(); }
     /// sets the bit at position pos to false
-    compact_bitset & reset(std::size_t pos) { throw_if_out_of_range(pos); (*this)[pos] = false; return *this; }
+    compact_bitset & reset(std::size_t pos) noexcept(!ChecksThrow) { throw_if_out_of_range(pos); (*this)[pos] = false; return *this; }
+    /// like reset(pos) but never checks pos
+    constexpr compact_bitset & reset_unchecked(std::size_t pos) noexcept { (*this)[pos] = false; return *this; }
 
     /// flips all bits (like operator~, but in-place)
-    compact_bitset & flip() noexcept;
+    constexpr compact_bitset & flip() noexcept;
     /// flips the bit at position pos -- throws std::out_of_range if pos >= size()
-    compact_bitset & flip(std::size_t pos) { throw_if_out_of_range(pos); (*this)[pos].flip(); return *this; }
+    compact_bitset & flip(std::size_t pos) noexcept(!ChecksThrow) { throw_if_out_of_range(pos); (*this)[pos].flip(); return *this; }
+    /// like flip(pos) but never checks pos
+    constexpr compact_bitset & flip_unchecked(std::size_t pos) noexcept { (*this)[pos].flip(); return *this; }
 
     /// returns a string representation of the bitset e.g. "00101001101", etc
     template<class CharT = char, class Traits = std::char_traits<CharT>, class Allocator = std::allocator<CharT>>
@@ -246,74 +297,75 @@ public:
     /// The first bit of the bitset corresponds to the least significant digit of the number and the last bit
     /// corresponds to the most significant digit.
     /// @throws std::overflow_error if the value can not be represented in unsigned long.
+    /// (Each of these is an overload pair, so that only the non-throwing one, for bitsets that fit, is constexpr.)
+    template <std::size_t M = N, std::enable_if_t<(M <= sizeof(unsigned long) * 8), int> = 0>
+    constexpr unsigned long to_ulong() const noexcept { return do_int_convert<unsigned long>(); }
+    template <std::size_t M = N, std::enable_if_t<(M > sizeof(unsigned long) * 8), int> = 0>
     unsigned long to_ulong() const {
-        if constexpr (constexpr std::size_t LBits = sizeof(unsigned long) * 8; size() > LBits)
-            throw std::overflow_error("This compact_bitset cannot be represented by an unsigned long");
-        else
-            return do_int_convert<unsigned long>();
+        throw std::overflow_error("This compact_bitset cannot be represented by an unsigned long");
     }
     /// Identical to above but returns an unsigned long long.
+    template <std::size_t M = N, std::enable_if_t<(M <= sizeof(unsigned long long) * 8), int> = 0>
+    constexpr unsigned long long to_ullong() const noexcept { return do_int_convert<unsigned long long>(); }
+    template <std::size_t M = N, std::enable_if_t<(M > sizeof(unsigned long long) * 8), int> = 0>
     unsigned long long to_ullong() const {
-        if constexpr (constexpr std::size_t LLBits = sizeof(unsigned long long) * 8; size() > LLBits)
-            throw std::overflow_error("This compact_bitset cannot be represented by an unsigned long long");
-        else
-            return do_int_convert<unsigned long long>();
+        throw std::overflow_error("This compact_bitset cannot be represented by an unsigned long long");
     }
 
 
     // -- bitwise operator support
-    friend inline compact_bitset operator&(const compact_bitset & lhs, const compact_bitset & rhs) noexcept {
-        compact_bitset ret(compact_bitset::Uninitialized);
-        for (std::size_t i = 0; i < ret.size(); ++i)
-            ret[i] = lhs[i] & rhs[i];
-        if constexpr (ret.LastWordMask != 0) ret.data[ret.NWords-1] &= ret.LastWordMask; // guarantee 0 for unused bits
+    friend constexpr compact_bitset operator&(const compact_bitset & lhs, const compact_bitset & rhs) noexcept {
+        compact_bitset ret;
+        // word at a time; unused bits are 0 in both operands, so they stay 0
+        for (std::size_t w = 0; w < NWords; ++w) ret.data[w] = T(lhs.data[w] & rhs.data[w]);
         return ret;
     }
-    friend inline compact_bitset operator|(const compact_bitset & lhs, const compact_bitset & rhs) noexcept {
-        compact_bitset ret(compact_bitset::Uninitialized);
-        for (std::size_t i = 0; i < ret.size(); ++i)
-            ret[i] = lhs[i] | rhs[i];
-        if constexpr (ret.LastWordMask != 0) ret.data[ret.NWords-1] &= ret.LastWordMask; // guarantee 0 for unused bits
+    friend constexpr compact_bitset operator|(const compact_bitset & lhs, const compact_bitset & rhs) noexcept {
+        compact_bitset ret;
+        // word at a time; unused bits are 0 in both operands, so they stay 0
+        for (std::size_t w = 0; w < NWords; ++w) ret.data[w] = T(lhs.data[w] | rhs.data[w]);
         return ret;
     }
-    friend inline compact_bitset operator^(const compact_bitset & lhs, const compact_bitset & rhs) noexcept {
-        compact_bitset ret(compact_bitset::Uninitialized);
-        for (std::size_t i = 0; i < ret.size(); ++i)
-            ret[i] = lhs[i] ^ rhs[i];
-        if constexpr (ret.LastWordMask != 0) ret.data[ret.NWords-1] &= ret.LastWordMask; // guarantee 0 for unused bits
+    friend constexpr compact_bitset operator^(const compact_bitset & lhs, const compact_bitset & rhs) noexcept {
+        compact_bitset ret;
+        // word at a time; unused bits are 0 in both operands, so they stay 0
+        for (std::size_t w = 0; w < NWords; ++w) ret.data[w] = T(lhs.data[w] ^ rhs.data[w]);
         return ret;
     }
-    compact_bitset & operator&=(const compact_bitset & rhs) noexcept { return *this = *this & rhs; }
-    compact_bitset & operator|=(const compact_bitset & rhs) noexcept { return *this = *this | rhs; }
-    compact_bitset & operator^=(const compact_bitset & rhs) noexcept { return *this = *this ^ rhs; }
-    compact_bitset operator~() const noexcept { return compact_bitset{*this}.flip(); }
+    constexpr compact_bitset & operator&=(const compact_bitset & rhs) noexcept { return *this = *this & rhs; }
+    constexpr compact_bitset & operator|=(const compact_bitset & rhs) noexcept { return *this = *this | rhs; }
+    constexpr compact_bitset & operator^=(const compact_bitset & rhs) noexcept { return *this = *this ^ rhs; }
+    constexpr compact_bitset operator~() const noexcept { return compact_bitset{*this}.flip(); }
 
     // -- bitshift operators
-    compact_bitset operator<<(std::size_t shift) const noexcept {
-        compact_bitset ret{Uninitialized};
-        for (std::size_t i = 0; i < shift && i < N; ++i)
-            ret[i] = false;
+    constexpr compact_bitset operator<<(std::size_t shift) const noexcept {
+        if constexpr (SingleWord) {
+            compact_bitset ret;
+            if (shift < N) ret.data[0] = T(data[0] << shift) & UsedMask;
+            return ret;
+        }
+        compact_bitset ret; // zero-filled, so the vacated low bits (and the unused bits) are already 0
         for (std::size_t i = 0; i + shift < N; ++i)
             ret[i + shift] = (*this)[i];
-        if constexpr (LastWordMask != 0) ret.data[NWords-1] &= LastWordMask; // guarantee 0 for unused bits
         return ret;
     }
-    compact_bitset& operator<<=(std::size_t shift) noexcept { return *this = (*this) << shift; }
-    compact_bitset operator>>(std::size_t shift) const noexcept {
-        compact_bitset ret{Uninitialized};
+    constexpr compact_bitset& operator<<=(std::size_t shift) noexcept { return *this = (*this) << shift; }
+    constexpr compact_bitset operator>>(std::size_t shift) const noexcept {
+        if constexpr (SingleWord) {
+            compact_bitset ret;
+            if (shift < N) ret.data[0] = T(data[0] >> shift);
+            return ret;
+        }
+        compact_bitset ret; // zero-filled, so the vacated high bits (and the unused bits) are already 0
         const std::size_t endpos = N >= shift ? N - shift : 0;
-        // pad left
-        for (std::size_t i = endpos; i < N; ++i)
-            ret[i] = false;
         for (std::size_t i = 0; i < endpos; ++i)
             ret[i] = (*this)[i + shift];
-        if constexpr (LastWordMask != 0) ret.data[NWords-1] &= LastWordMask; // guarantee 0 for unused bits
         return ret;
     }
-    compact_bitset& operator>>=(std::size_t shift) noexcept { return *this = (*this) >> shift; }
+    constexpr compact_bitset& operator>>=(std::size_t shift) noexcept { return *this = (*this) >> shift; }
 
-    bool operator==(const compact_bitset &o) const noexcept;
-    bool operator!=(const compact_bitset &o) const noexcept { return !(*this == o); }
+    constexpr bool operator==(const compact_bitset &o) const noexcept;
+    constexpr bool operator!=(const compact_bitset &o) const noexcept { return !(*this == o); }
 
     /// std::hash support
     std::size_t hash_code() const noexcept;
@@ -324,11 +376,28 @@ public:
     std::byte *bits() noexcept { return reinterpret_cast<std::byte *>(data.data()); }
     /// returns the number of bytes in the .bits() array
     std::size_t bits_size() const noexcept { return data.size() * sizeof(T); }
+
+    /// word-level access, for data structures built on top of compact_bitset
+    using word_type = T;
+    static constexpr std::size_t word_bits = TBits;
+    /// returns the number of words in the underlying array
+    static constexpr std::size_t num_words() noexcept { return NWords; }
+    /// returns word i of the underlying array (bit j of word i is bit i * word_bits + j of the bitset)
+    constexpr T word(std::size_t i) const noexcept { return data[i]; }
+    /// assigns word i of the underlying array. Bits past size() are discarded, so the unused bits remain 0.
+    constexpr compact_bitset & set_word(std::size_t i, T w) noexcept {
+        if constexpr (LastWordMask != 0) {
+            if (i == NWords - 1) w &= LastWordMask;
+        }
+        data[i] = w;
+        return *this;
+    }
 };
 
 template <std::size_t N, typename T>
 inline
-std::size_t compact_bitset<N, T>::count() const noexcept {
+constexpr std::size_t compact_bitset<N, T>::count() const noexcept {
+    if constexpr (SingleWord) return std::size_t(get_popcount(data[0]));
     std::size_t ret = 0;
     for (std::size_t i = 0; i < NFullyUsedWords; ++i) ret += get_popcount(data[i]);
     if constexpr (LastWordMask != 0) ret += get_popcount(data[NWords-1] & LastWordMask);
@@ -337,7 +406,24 @@ std::size_t compact_bitset<N, T>::count() const noexcept {
 
 template <std::size_t N, typename T>
 inline
-bool compact_bitset<N, T>::all() const noexcept {
+constexpr std::size_t compact_bitset<N, T>::find_first() const noexcept {
+    for (std::size_t w = 0; w < NWords; ++w) // unused bits are 0, so they are never found
+        if (data[w]) return w * TBits + std::size_t(ffs(data[w]) - 1);
+    return N;
+}
+
+template <std::size_t N, typename T>
+inline
+constexpr std::size_t compact_bitset<N, T>::find_last() const noexcept {
+    for (std::size_t w = NWords; w-- > 0; )
+        if (data[w]) return w * TBits + std::size_t(fls(data[w]) - 1);
+    return N;
+}
+
+template <std::size_t N, typename T>
+inline
+constexpr bool compact_bitset<N, T>::all() const noexcept {
+    if constexpr (SingleWord) return data[0] == UsedMask;
     std::size_t w = 0;
     if constexpr (NFullyUsedWords > 0) {
         for (; w < NFullyUsedWords; ++w)
@@ -351,7 +437,8 @@ bool compact_bitset<N, T>::all() const noexcept {
 
 template <std::size_t N, typename T>
 inline
-bool compact_bitset<N, T>::operator==(const compact_bitset &o) const noexcept {
+constexpr bool compact_bitset<N, T>::operator==(const compact_bitset &o) const noexcept {
+    if constexpr (SingleWord) return data[0] == o.data[0];
     std::size_t w = 0;
     if constexpr (NFullyUsedWords > 0) {
         for (; w < NFullyUsedWords; ++w)
@@ -365,7 +452,8 @@ bool compact_bitset<N, T>::operator==(const compact_bitset &o) const noexcept {
 
 template <std::size_t N, typename T>
 inline
-bool compact_bitset<N, T>::any() const noexcept {
+constexpr bool compact_bitset<N, T>::any() const noexcept {
+    if constexpr (SingleWord) return data[0] != 0;
     std::size_t w = 0;
     if constexpr (NFullyUsedWords > 0) {
         for (; w < NFullyUsedWords; ++w)
@@ -379,7 +467,8 @@ bool compact_bitset<N, T>::any() const noexcept {
 
 template <std::size_t N, typename T>
 inline
-auto compact_bitset<N, T>::set() noexcept -> compact_bitset & {
+constexpr auto compact_bitset<N, T>::set() noexcept -> compact_bitset & {
+    if constexpr (SingleWord) { data[0] = UsedMask; return *this; }
     std::size_t w = 0;
     if constexpr (NFullyUsedWords > 0) {
         for (; w < NFullyUsedWords; ++w)
@@ -393,7 +482,8 @@ auto compact_bitset<N, T>::set() noexcept -> compact_bitset & {
 
 template <std::size_t N, typename T>
 inline
-auto compact_bitset<N, T>::flip() noexcept -> compact_bitset & {
+constexpr auto compact_bitset<N, T>::flip() noexcept -> compact_bitset & {
+    if constexpr (SingleWord) { data[0] = T(~data[0]) & UsedMask; return *this; }
     std::size_t w = 0;
     if constexpr (NFullyUsedWords > 0) {
         for (; w < NFullyUsedWords; ++w)
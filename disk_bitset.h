@@ -0,0 +1,345 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bit_util.h"
+#include "bitstream.h"
+#include "compact_bitset.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+/// Bitsets stored in files, for bitmaps too big to hold in memory (POSIX only).
+///
+/// A file is just the bitset's 64-bit words in host byte order, so block k of a file starts at byte offset
+/// k * block_words * 8 and can be fetched with a single pread(). Reads and writes go through block-sized buffers,
+/// optionally with O_DIRECT to bypass the page cache for data that will only be streamed through once.
+///
+/// The streaming operations (count, count_and, write_and, ...) process any number of equally sized files block by
+/// block, while a background thread reads the next block of every input into the other half of a double buffer, so
+/// I/O and computation overlap. Memory use is 2 * block_words * 8 bytes per input, however large the files are.
+namespace disk_bitset {
+
+struct options {
+    std::size_t block_words = std::size_t(1) << 17; ///< words per block (1 MiB); rounded up to 512 with `direct`
+    bool direct = false; ///< open files with O_DIRECT (or F_NOCACHE), where the platform and filesystem support it
+};
+
+namespace detail {
+constexpr std::size_t DirectAlign = 4096;
+
+inline std::size_t block_words(const options &opts) {
+    if (!opts.block_words) throw std::invalid_argument("disk_bitset block_words must not be 0");
+    const std::size_t a = DirectAlign / 8;
+    return opts.direct ? (opts.block_words + a - 1) / a * a : opts.block_words;
+}
+
+[[noreturn]] inline void throw_errno(const std::string &what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+/// Owns a file descriptor
+class fd_handle {
+    int fd = -1;
+public:
+    fd_handle(const std::string &path, int flags, bool direct) {
+#ifdef O_DIRECT
+        if (direct) flags |= O_DIRECT;
+#endif
+        fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+        if (fd < 0) throw_errno("disk_bitset: cannot open " + path);
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+        if (direct) ::fcntl(fd, F_NOCACHE, 1);
+#endif
+    }
+    fd_handle(fd_handle &&o) noexcept : fd(o.fd) { o.fd = -1; }
+    fd_handle &operator=(fd_handle &&o) noexcept { std::swap(fd, o.fd); return *this; }
+    ~fd_handle() { if (fd >= 0) ::close(fd); }
+    int get() const noexcept { return fd; }
+    int release() noexcept { const int ret = fd; fd = -1; return ret; }
+};
+
+/// Word buffer aligned for O_DIRECT
+class aligned_words {
+    struct deleter { void operator()(std::uint64_t *p) const noexcept { std::free(p); } };
+    std::unique_ptr<std::uint64_t[], deleter> p;
+public:
+    aligned_words() noexcept = default;
+    explicit aligned_words(std::size_t n) {
+        const std::size_t bytes = std::max<std::size_t>(1, (n * 8 + DirectAlign - 1) / DirectAlign) * DirectAlign;
+        p.reset(static_cast<std::uint64_t *>(std::aligned_alloc(DirectAlign, bytes)));
+        if (!p) throw std::bad_alloc();
+    }
+    std::uint64_t *get() const noexcept { return p.get(); }
+};
+} // namespace detail
+
+/// Random-access, read-only view of a bitset file
+class file_reader {
+    detail::fd_handle fd;
+    bool direct;
+    std::size_t nwords;
+public:
+    explicit file_reader(const std::string &path, bool direct_ = false) : fd(path, O_RDONLY, direct_), direct(direct_) {
+        struct stat st;
+        if (::fstat(fd.get(), &st) != 0) detail::throw_errno("disk_bitset: cannot stat " + path);
+        if (st.st_size % 8) throw std::invalid_argument("disk_bitset: size of " + path + " is not a whole number of words");
+        nwords = std::size_t(st.st_size / 8);
+    }
+    std::size_t num_words() const noexcept { return nwords; }
+    std::size_t bits_size() const noexcept { return nwords * 64; }
+    /// Read words [first, first + n) into dst, which must be aligned to 4096 bytes (and n rounded up to 512) if the
+    /// file was opened with `direct`. Reading stops at the end of the file; returns the number of words read.
+    std::size_t read(std::size_t first, std::uint64_t *dst, std::size_t n) const {
+        n = first < nwords ? std::min(n, nwords - first) : 0;
+        char *p = reinterpret_cast<char *>(dst);
+        const std::size_t want = n * 8, align = detail::DirectAlign;
+        // O_DIRECT transfers must be whole aligned blocks, so a final partial block is requested rounded up and the
+        // read comes up short at the end of the file
+        const std::size_t request = direct ? (want + align - 1) / align * align : want;
+        for (std::size_t done = 0; done < want; ) {
+            const ssize_t r = ::pread(fd.get(), p + done, request - done, off_t(first * 8 + done));
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0) detail::throw_errno("disk_bitset: read failed");
+            if (r == 0) throw std::runtime_error("disk_bitset: file shrank while reading");
+            done += std::size_t(r);
+        }
+        return n;
+    }
+};
+
+/// Sequential writer of a bitset file, buffered in blocks. The file is truncated when opened.
+class file_writer {
+    detail::fd_handle fd;
+    bool direct;
+    std::size_t blockWords, nbuf = 0, nwritten = 0;
+    detail::aligned_words buf;
+
+    void write_all(const std::uint64_t *words, std::size_t n) {
+        const char *p = reinterpret_cast<const char *>(words);
+        std::size_t done = 0, want = n * 8;
+        while (done < want) {
+            const ssize_t r = ::pwrite(fd.get(), p + done, want - done, off_t(nwritten * 8 + done));
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) detail::throw_errno("disk_bitset: write failed");
+            done += std::size_t(r);
+        }
+        nwritten += n;
+    }
+public:
+    explicit file_writer(const std::string &path, const options &opts = {})
+        : fd(path, O_WRONLY | O_CREAT | O_TRUNC, opts.direct), direct(opts.direct), blockWords(detail::block_words(opts)),
+          buf(blockWords) {}
+    file_writer(file_writer &&) noexcept = default;
+    /// Flushes; errors are swallowed here, so call close() to see them.
+    ~file_writer() { if (fd.get() >= 0) try { close(); } catch (...) {} }
+
+    void append(const std::uint64_t *words, std::size_t n) {
+        while (n) {
+            if (!nbuf && n >= blockWords) { // whole blocks can skip the buffer unless they must stay aligned
+                if (!direct) { write_all(words, n); return; }
+            }
+            const std::size_t k = std::min(n, blockWords - nbuf);
+            std::copy(words, words + k, buf.get() + nbuf);
+            nbuf += k, words += k, n -= k;
+            if (nbuf == blockWords) flush_block();
+        }
+    }
+    void append(std::uint64_t w) { append(&w, 1); }
+    /// Append all of bs's bits (padded with zeros to a multiple of 64)
+    template <std::size_t N, typename T>
+    void append(const compact_bitset<N, T> &bs) {
+        bitset_word_source<N, T> src(bs);
+        for (std::size_t i = 0; i < (N + 63) / 64; ++i) append(src.fetch(i));
+    }
+    /// Write out the buffered block (if it's full, or this is the last one)
+    void flush_block() {
+        if (!nbuf) return;
+#ifdef O_DIRECT
+        // O_DIRECT needs whole aligned blocks; only a final partial block can get here, so write it through the cache
+        if (direct && nbuf * 8 % detail::DirectAlign)
+            ::fcntl(fd.get(), F_SETFL, ::fcntl(fd.get(), F_GETFL) & ~O_DIRECT);
+#endif
+        write_all(buf.get(), nbuf);
+        nbuf = 0;
+    }
+    std::size_t num_words() const noexcept { return nwritten + nbuf; }
+    /// Flush and close the file. @throws std::system_error on failure
+    void close() {
+        flush_block();
+        if (::close(fd.release()) != 0) detail::throw_errno("disk_bitset: close failed");
+    }
+};
+
+namespace detail {
+/// Reads the same block of several files into one half of a double buffer on a background thread, while the caller
+/// works on the other half.
+class double_buffered_blocks {
+    std::vector<file_reader> files;
+    std::size_t nwords, blockWords, nblocks, produced = 0, consumed = 0;
+    aligned_words bufs[2];
+    std::exception_ptr err;
+    bool stop = false;
+    std::mutex mut;
+    std::condition_variable cond;
+    std::thread worker;
+
+    std::uint64_t *slot(std::size_t block, std::size_t file) const noexcept { return bufs[block % 2].get() + file * blockWords; }
+
+    void run() noexcept {
+        try {
+            for (std::size_t k = 0; k < nblocks; ++k) {
+                {
+                    std::unique_lock<std::mutex> g(mut);
+                    cond.wait(g, [&] { return stop || k < consumed + 2; });
+                    if (stop) return;
+                }
+                for (std::size_t f = 0; f < files.size(); ++f) files[f].read(k * blockWords, slot(k, f), blockWords);
+                std::lock_guard<std::mutex> g(mut);
+                produced = k + 1;
+                cond.notify_all();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> g(mut);
+            err = std::current_exception();
+            cond.notify_all();
+        }
+    }
+public:
+    double_buffered_blocks(const std::vector<std::string> &paths, const options &opts) : blockWords(block_words(opts)) {
+        if (paths.empty()) throw std::invalid_argument("disk_bitset: no input files");
+        for (const auto &p : paths) files.emplace_back(p, opts.direct);
+        nwords = files.front().num_words();
+        for (const auto &f : files)
+            if (f.num_words() != nwords) throw std::invalid_argument("disk_bitset: input files differ in size");
+        nblocks = (nwords + blockWords - 1) / blockWords;
+        bufs[0] = aligned_words(files.size() * blockWords);
+        bufs[1] = aligned_words(files.size() * blockWords);
+        worker = std::thread([this] { run(); });
+    }
+    ~double_buffered_blocks() {
+        {
+            std::lock_guard<std::mutex> g(mut);
+            stop = true;
+        }
+        cond.notify_all();
+        worker.join();
+    }
+    std::size_t num_words() const noexcept { return nwords; }
+    std::size_t num_files() const noexcept { return files.size(); }
+
+    /// Call f(inputs, first, n) for each block in order, where inputs[i] points to words [first, first + n) of file i
+    template <typename F>
+    void for_each(F &&f) {
+        std::vector<const std::uint64_t *> inputs(files.size());
+        for (std::size_t k = 0; k < nblocks; ++k) {
+            {
+                std::unique_lock<std::mutex> g(mut);
+                cond.wait(g, [&] { return err || produced > k; });
+                if (err) std::rethrow_exception(err);
+            }
+            for (std::size_t i = 0; i < files.size(); ++i) inputs[i] = slot(k, i);
+            f(inputs.data(), k * blockWords, std::min(blockWords, nwords - k * blockWords));
+            std::lock_guard<std::mutex> g(mut);
+            consumed = k + 1;
+            cond.notify_all();
+        }
+    }
+};
+
+template <typename Op>
+std::uint64_t count_reduce(const std::vector<std::string> &paths, const options &opts, Op op) {
+    double_buffered_blocks blocks(paths, opts);
+    std::uint64_t ret = 0;
+    blocks.for_each([&](const std::uint64_t *const *in, std::size_t, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            std::uint64_t w = in[0][i];
+            for (std::size_t f = 1; f < blocks.num_files(); ++f) w = op(w, in[f][i]);
+            ret += unsigned(bit_util::popcount(w));
+        }
+    });
+    return ret;
+}
+
+template <typename Op>
+std::uint64_t write_reduce(const std::vector<std::string> &paths, const std::string &out, const options &opts, Op op) {
+    double_buffered_blocks blocks(paths, opts);
+    file_writer writer(out, opts);
+    aligned_words result(block_words(opts));
+    std::uint64_t ret = 0;
+    blocks.for_each([&](const std::uint64_t *const *in, std::size_t, std::size_t n) {
+        std::uint64_t *r = result.get();
+        std::copy(in[0], in[0] + n, r);
+        for (std::size_t f = 1; f < blocks.num_files(); ++f)
+            for (std::size_t i = 0; i < n; ++i) r[i] = op(r[i], in[f][i]);
+        for (std::size_t i = 0; i < n; ++i) ret += unsigned(bit_util::popcount(r[i]));
+        writer.append(r, n);
+    });
+    writer.close();
+    return ret;
+}
+struct and_op { std::uint64_t operator()(std::uint64_t a, std::uint64_t b) const noexcept { return a & b; } };
+struct or_op { std::uint64_t operator()(std::uint64_t a, std::uint64_t b) const noexcept { return a | b; } };
+struct xor_op { std::uint64_t operator()(std::uint64_t a, std::uint64_t b) const noexcept { return a ^ b; } };
+} // namespace detail
+
+/// Number of set bits in a bitset file
+inline std::uint64_t count(const std::string &path, const options &opts = {}) {
+    return detail::count_reduce({path}, opts, detail::or_op{});
+}
+/// Number of set bits in the AND / OR of equally sized bitset files, without writing the result anywhere
+inline std::uint64_t count_and(const std::vector<std::string> &paths, const options &opts = {}) {
+    return detail::count_reduce(paths, opts, detail::and_op{});
+}
+inline std::uint64_t count_or(const std::vector<std::string> &paths, const options &opts = {}) {
+    return detail::count_reduce(paths, opts, detail::or_op{});
+}
+/// Write the AND / OR / XOR of equally sized bitset files to `out`, returning its number of set bits
+inline std::uint64_t write_and(const std::vector<std::string> &paths, const std::string &out, const options &opts = {}) {
+    return detail::write_reduce(paths, out, opts, detail::and_op{});
+}
+inline std::uint64_t write_or(const std::vector<std::string> &paths, const std::string &out, const options &opts = {}) {
+    return detail::write_reduce(paths, out, opts, detail::or_op{});
+}
+inline std::uint64_t write_xor(const std::vector<std::string> &paths, const std::string &out, const options &opts = {}) {
+    return detail::write_reduce(paths, out, opts, detail::xor_op{});
+}
+
+} // namespace disk_bitset
@@ -0,0 +1,470 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bit_util.h"
+#include "compact_bitset.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/// A runtime-sized bit vector that supports inserting and erasing bits anywhere, as well as rank and select, all in
+/// O(log N) time.
+///
+/// Bits live in compact_bitset<512> leaves, each between 1/4 full and full, which are the leaves of a B-tree. Each
+/// inner node records the number of bits and the number of ones below each of its children, so positions and ranks
+/// are found by descending the tree. Inserting into a full leaf splits it; erasing from a leaf that becomes less than
+/// 1/4 full merges it with (or borrows from) a sibling, and likewise for inner nodes.
+class dynamic_bitvector
+{
+    using Word = std::uint64_t;
+    static constexpr std::size_t WBits = 64;
+    static constexpr std::size_t LeafBits = 512, LeafWords = LeafBits / WBits, MinLeafBits = LeafBits / 4;
+    static constexpr std::size_t MaxFanout = 32, MinFanout = MaxFanout / 4;
+    using LeafBitset = compact_bitset<LeafBits, Word>;
+
+    struct Node {
+        const bool isLeaf;
+        explicit Node(bool leaf) noexcept : isLeaf(leaf) {}
+        virtual ~Node() = default;
+    };
+    struct Leaf final : Node {
+        LeafBitset bits; // unused bits are always 0
+        std::size_t nbits = 0;
+        Leaf() noexcept : Node(true) {}
+    };
+    struct Inner final : Node {
+        std::size_t nchildren = 0;
+        std::array<std::unique_ptr<Node>, MaxFanout + 1> children; // + 1 so that an insert may overflow before the split
+        std::array<std::size_t, MaxFanout + 1> sizes{}, ones{}; ///< number of bits, and of ones, below each child
+        Inner() noexcept : Node(false) {}
+        void insert_child(std::size_t i, std::unique_ptr<Node> child) {
+            for (std::size_t j = nchildren; j > i; --j) {
+                children[j] = std::move(children[j - 1]);
+                sizes[j] = sizes[j - 1];
+                ones[j] = ones[j - 1];
+            }
+            sizes[i] = node_size(*child);
+            ones[i] = node_ones(*child);
+            children[i] = std::move(child);
+            ++nchildren;
+        }
+        std::unique_ptr<Node> remove_child(std::size_t i) {
+            auto ret = std::move(children[i]);
+            for (std::size_t j = i; j + 1 < nchildren; ++j) {
+                children[j] = std::move(children[j + 1]);
+                sizes[j] = sizes[j + 1];
+                ones[j] = ones[j + 1];
+            }
+            --nchildren;
+            return ret;
+        }
+        void refresh(std::size_t i) { sizes[i] = node_size(*children[i]); ones[i] = node_ones(*children[i]); }
+    };
+    std::unique_ptr<Node> root;
+    std::size_t nbits = 0, nones = 0;
+
+    static Leaf & as_leaf(Node &n) noexcept { return static_cast<Leaf &>(n); }
+    static const Leaf & as_leaf(const Node &n) noexcept { return static_cast<const Leaf &>(n); }
+    static Inner & as_inner(Node &n) noexcept { return static_cast<Inner &>(n); }
+    static const Inner & as_inner(const Node &n) noexcept { return static_cast<const Inner &>(n); }
+    static std::size_t node_size(const Node &n) noexcept {
+        if (n.isLeaf) return as_leaf(n).nbits;
+        const Inner &in = as_inner(n);
+        std::size_t ret = 0;
+        for (std::size_t i = 0; i < in.nchildren; ++i) ret += in.sizes[i];
+        return ret;
+    }
+    static std::size_t node_ones(const Node &n) noexcept {
+        if (n.isLeaf) return as_leaf(n).bits.count();
+        const Inner &in = as_inner(n);
+        std::size_t ret = 0;
+        for (std::size_t i = 0; i < in.nchildren; ++i) ret += in.ones[i];
+        return ret;
+    }
+    static bool underfull(const Node &n) noexcept {
+        return n.isLeaf ? as_leaf(n).nbits < MinLeafBits : as_inner(n).nchildren < MinFanout;
+    }
+    static std::unique_ptr<Node> clone(const Node &n) {
+        if (n.isLeaf) return std::make_unique<Leaf>(as_leaf(n));
+        const Inner &in = as_inner(n);
+        auto ret = std::make_unique<Inner>();
+        ret->nchildren = in.nchildren;
+        ret->sizes = in.sizes;
+        ret->ones = in.ones;
+        for (std::size_t i = 0; i < in.nchildren; ++i) ret->children[i] = clone(*in.children[i]);
+        return ret;
+    }
+
+    // -- bit-level helpers for word arrays
+    // returns the `len` (<= 64) bits at bit offset `off` of `src`
+    static Word read_bits(const Word *src, std::size_t off, std::size_t len) noexcept {
+        const std::size_t w = off / WBits, o = off % WBits;
+        Word v = src[w] >> o;
+        if (o && o + len > WBits) v |= src[w + 1] << (WBits - o);
+        return v & bit_util::low_mask(unsigned(len));
+    }
+    // ORs the `len` (<= 64) low bits of `v` into `dst` at bit offset `off`
+    static void or_bits(Word *dst, std::size_t off, std::size_t len, Word v) noexcept {
+        v &= bit_util::low_mask(unsigned(len));
+        const std::size_t w = off / WBits, o = off % WBits;
+        dst[w] |= v << o;
+        if (o && o + len > WBits) dst[w + 1] |= v >> (WBits - o);
+    }
+    // copies `len` bits from `src` at offset `srcOff` into the (zeroed) `dst` at offset `dstOff`
+    static void copy_bits(Word *dst, std::size_t dstOff, const Word *src, std::size_t srcOff, std::size_t len) noexcept {
+        for (std::size_t i = 0; i < len; i += WBits) {
+            const std::size_t n = std::min(WBits, len - i);
+            or_bits(dst, dstOff + i, n, read_bits(src, srcOff + i, n));
+        }
+    }
+    static void load(const Leaf &l, Word *w) noexcept { for (std::size_t i = 0; i < LeafWords; ++i) w[i] = l.bits.word(i); }
+    static void store(Leaf &l, const Word *w) noexcept { for (std::size_t i = 0; i < LeafWords; ++i) l.bits.set_word(i, w[i]); }
+
+    // -- leaf operations
+    static void leaf_insert(Leaf &l, std::size_t pos, bool b) noexcept {
+        Word w[LeafWords];
+        load(l, w);
+        const std::size_t wi = pos / WBits, o = pos % WBits;
+        for (std::size_t i = LeafWords - 1; i > wi; --i) w[i] = w[i] << 1 | w[i - 1] >> (WBits - 1);
+        const Word lo = w[wi] & bit_util::low_mask(unsigned(o));
+        w[wi] = lo | (w[wi] & ~bit_util::low_mask(unsigned(o))) << 1 | Word(b) << o;
+        store(l, w);
+        ++l.nbits;
+    }
+    static bool leaf_erase(Leaf &l, std::size_t pos) noexcept {
+        Word w[LeafWords];
+        load(l, w);
+        const std::size_t wi = pos / WBits, o = pos % WBits;
+        const bool ret = w[wi] >> o & 0x1;
+        const Word lo = w[wi] & bit_util::low_mask(unsigned(o));
+        w[wi] = lo | (w[wi] >> 1 & ~bit_util::low_mask(unsigned(o)));
+        for (std::size_t i = wi; i + 1 < LeafWords; ++i) {
+            w[i] |= w[i + 1] << (WBits - 1);
+            w[i + 1] >>= 1;
+        }
+        store(l, w);
+        --l.nbits;
+        return ret;
+    }
+    // moves the upper half of a full leaf into a new leaf, which is returned
+    static std::unique_ptr<Leaf> leaf_split(Leaf &l) {
+        auto right = std::make_unique<Leaf>();
+        for (std::size_t i = 0; i < LeafWords / 2; ++i) {
+            right->bits.set_word(i, l.bits.word(i + LeafWords / 2));
+            l.bits.set_word(i + LeafWords / 2, 0);
+        }
+        right->nbits = l.nbits - LeafBits / 2;
+        l.nbits = LeafBits / 2;
+        return right;
+    }
+    // Merges `r` into `l` if they fit in one leaf (returning true), otherwise splits their bits evenly between them.
+    static bool leaf_rebalance(Leaf &l, Leaf &r) noexcept {
+        Word a[LeafWords], b[LeafWords], buf[2 * LeafWords + 1] = {};
+        load(l, a);
+        load(r, b);
+        const std::size_t total = l.nbits + r.nbits;
+        copy_bits(buf, 0, a, 0, l.nbits);
+        copy_bits(buf, l.nbits, b, 0, r.nbits);
+        const std::size_t nl = total <= LeafBits ? total : total / 2;
+        std::fill(std::begin(a), std::end(a), Word(0));
+        std::fill(std::begin(b), std::end(b), Word(0));
+        copy_bits(a, 0, buf, 0, nl);
+        copy_bits(b, 0, buf, nl, total - nl);
+        store(l, a);
+        store(r, b);
+        l.nbits = nl;
+        r.nbits = total - nl;
+        return total <= LeafBits;
+    }
+    // Merges the children of `r` into `l` if they fit in one node (returning true), otherwise evens them out.
+    static bool inner_rebalance(Inner &l, Inner &r) {
+        const std::size_t total = l.nchildren + r.nchildren;
+        const std::size_t nl = total <= MaxFanout ? total : total / 2;
+        while (l.nchildren < nl) l.insert_child(l.nchildren, r.remove_child(0));
+        while (l.nchildren > nl) r.insert_child(0, l.remove_child(l.nchildren - 1));
+        return r.nchildren == 0;
+    }
+
+    // -- recursive tree operations
+    // finds the child of `in` containing position pos, and makes pos relative to it. If `forInsert`, pos may be at
+    // the end of a child.
+    static std::size_t find_child(const Inner &in, std::size_t &pos, bool forInsert = false) noexcept {
+        std::size_t i = 0;
+        while (i + 1 < in.nchildren && (forInsert ? pos > in.sizes[i] : pos >= in.sizes[i])) pos -= in.sizes[i++];
+        return i;
+    }
+    // returns a new right sibling of `n` if it had to be split
+    static std::unique_ptr<Node> insert_rec(Node &n, std::size_t pos, bool b) {
+        if (n.isLeaf) {
+            Leaf &l = as_leaf(n);
+            if (l.nbits < LeafBits) { leaf_insert(l, pos, b); return nullptr; }
+            auto right = leaf_split(l);
+            if (pos <= l.nbits) leaf_insert(l, pos, b);
+            else leaf_insert(*right, pos - l.nbits, b);
+            return right;
+        }
+        Inner &in = as_inner(n);
+        const std::size_t i = find_child(in, pos, true);
+        if (auto split = insert_rec(*in.children[i], pos, b)) {
+            in.refresh(i);
+            in.insert_child(i + 1, std::move(split));
+        } else {
+            ++in.sizes[i];
+            in.ones[i] += b;
+        }
+        if (in.nchildren <= MaxFanout) return nullptr;
+        auto right = std::make_unique<Inner>();
+        while (in.nchildren > right->nchildren + 1) right->insert_child(0, in.remove_child(in.nchildren - 1));
+        return right;
+    }
+    static bool erase_rec(Node &n, std::size_t pos) {
+        if (n.isLeaf) return leaf_erase(as_leaf(n), pos);
+        Inner &in = as_inner(n);
+        const std::size_t i = find_child(in, pos);
+        const bool ret = erase_rec(*in.children[i], pos);
+        --in.sizes[i];
+        in.ones[i] -= ret;
+        if (underfull(*in.children[i]) && in.nchildren > 1) {
+            const std::size_t l = i + 1 < in.nchildren ? i : i - 1;
+            Node &ln = *in.children[l], &rn = *in.children[l + 1];
+            const bool merged = ln.isLeaf ? leaf_rebalance(as_leaf(ln), as_leaf(rn)) : inner_rebalance(as_inner(ln), as_inner(rn));
+            if (merged) in.remove_child(l + 1);
+            else in.refresh(l + 1);
+            in.refresh(l);
+        }
+        return ret;
+    }
+    static int set_rec(Node &n, std::size_t pos, bool b) noexcept {
+        if (n.isLeaf) {
+            auto ref = as_leaf(n).bits[pos];
+            const int delta = int(b) - int(bool(ref));
+            ref = b;
+            return delta;
+        }
+        Inner &in = as_inner(n);
+        const std::size_t i = find_child(in, pos);
+        const int delta = set_rec(*in.children[i], pos, b);
+        in.ones[i] = std::size_t(std::ptrdiff_t(in.ones[i]) + delta);
+        return delta;
+    }
+    template <bool Bit>
+    std::size_t select_impl(std::size_t k) const {
+        if (k >= (Bit ? nones : nbits - nones)) throw std::out_of_range("Out-of-range rank specified to dynamic_bitvector::select");
+        std::size_t pos = 0;
+        const Node *n = root.get();
+        while (!n->isLeaf) {
+            const Inner &in = as_inner(*n);
+            std::size_t i = 0;
+            for (std::size_t c; k >= (c = Bit ? in.ones[i] : in.sizes[i] - in.ones[i]); ++i) {
+                k -= c;
+                pos += in.sizes[i];
+            }
+            n = in.children[i].get();
+        }
+        const Leaf &l = as_leaf(*n);
+        for (std::size_t w = 0; ; ++w) {
+            const Word word = Bit ? l.bits.word(w) : ~l.bits.word(w);
+            if (const std::size_t c = unsigned(bit_util::popcount(word)); k < c)
+                return pos + w * WBits + unsigned(bit_util::select_in_word(word, unsigned(k)));
+            else
+                k -= c;
+        }
+    }
+    void throw_if_out_of_range(std::size_t pos, std::size_t limit) const {
+        if (pos >= limit) throw std::out_of_range("Out-of-range bit position specified to dynamic_bitvector");
+    }
+    // build a balanced tree bottom-up from words; leaves are filled completely
+    void assign_words(const Word *words, std::size_t n) {
+        std::vector<std::unique_ptr<Node>> level;
+        for (std::size_t pos = 0; pos < n || level.empty(); pos += LeafBits) {
+            auto l = std::make_unique<Leaf>();
+            l->nbits = std::min(LeafBits, n - pos);
+            for (std::size_t i = 0; i * WBits < l->nbits; ++i) {
+                const std::size_t rem = l->nbits - i * WBits;
+                l->bits.set_word(i, words[pos / WBits + i] & bit_util::low_mask(unsigned(std::min(rem, WBits))));
+            }
+            level.push_back(std::move(l));
+        }
+        while (level.size() > 1) {
+            std::vector<std::unique_ptr<Node>> parents;
+            for (std::size_t i = 0; i < level.size(); i += MaxFanout) {
+                auto in = std::make_unique<Inner>();
+                for (std::size_t j = i; j < std::min(level.size(), i + MaxFanout); ++j) in->insert_child(in->nchildren, std::move(level[j]));
+                parents.push_back(std::move(in));
+            }
+            level.swap(parents);
+        }
+        root = std::move(level.front());
+        nbits = n;
+        nones = node_ones(*root);
+    }
+public:
+    /// construct an empty bit vector
+    dynamic_bitvector() : root(std::make_unique<Leaf>()) {}
+    /// construct a bit vector of `n` bits, all set to `value`
+    explicit dynamic_bitvector(std::size_t n, bool value = false) {
+        const std::vector<Word> words((n + WBits - 1) / WBits, value ? ~Word(0) : Word(0));
+        assign_words(words.data(), n);
+    }
+    /// construct from `n` bits stored in `words` (bit j of words[i] is bit i * 64 + j)
+    dynamic_bitvector(const std::vector<std::uint64_t> &words, std::size_t n) {
+        if (words.size() * WBits < n) throw std::invalid_argument("Word array is too small for the specified number of bits");
+        assign_words(words.data(), n);
+    }
+    /// construct from the bits of a compact_bitset
+    template <std::size_t N, typename T>
+    explicit dynamic_bitvector(const compact_bitset<N, T> &bs) {
+        std::vector<Word> words((N + WBits - 1) / WBits);
+        for (std::size_t i = 0; i < bs.num_words(); ++i) or_bits(words.data(), i * bs.word_bits, bs.word_bits, bs.word(i));
+        assign_words(words.data(), N);
+    }
+    dynamic_bitvector(const dynamic_bitvector &o) : root(clone(*o.root)), nbits(o.nbits), nones(o.nones) {}
+    /// moves leave `o` a valid, empty bit vector. That takes a fresh root leaf, so unlike swap() they may throw
+    /// std::bad_alloc.
+    dynamic_bitvector(dynamic_bitvector &&o) : dynamic_bitvector() { swap(o); }
+    dynamic_bitvector & operator=(const dynamic_bitvector &o) {
+        dynamic_bitvector tmp(o);
+        swap(tmp);
+        return *this;
+    }
+    dynamic_bitvector & operator=(dynamic_bitvector &&o) {
+        if (this != &o) {
+            dynamic_bitvector tmp(std::move(o));
+            swap(tmp);
+        }
+        return *this;
+    }
+    void swap(dynamic_bitvector &o) noexcept {
+        root.swap(o.root);
+        std::swap(nbits, o.nbits);
+        std::swap(nones, o.nones);
+    }
+
+    std::size_t size() const noexcept { return nbits; }
+    bool empty() const noexcept { return nbits == 0; }
+    /// returns the number of bits set to true
+    std::size_t count() const noexcept { return nones; }
+
+    /// returns the bit at pos -- throws std::out_of_range if pos >= size()
+    bool test(std::size_t pos) const {
+        throw_if_out_of_range(pos, nbits);
+        const Node *n = root.get();
+        while (!n->isLeaf) {
+            const Inner &in = as_inner(*n);
+            n = in.children[find_child(in, pos)].get();
+        }
+        return as_leaf(*n).bits[pos];
+    }
+    bool operator[](std::size_t pos) const { return test(pos); }
+    /// set a specific bit -- throws std::out_of_range if pos >= size()
+    dynamic_bitvector & set(std::size_t pos, bool value = true) {
+        throw_if_out_of_range(pos, nbits);
+        nones = std::size_t(std::ptrdiff_t(nones) + set_rec(*root, pos, value));
+        return *this;
+    }
+    /// sets the bit at position pos to false -- throws std::out_of_range if pos >= size()
+    dynamic_bitvector & reset(std::size_t pos) { return set(pos, false); }
+    /// flips the bit at position pos -- throws std::out_of_range if pos >= size()
+    dynamic_bitvector & flip(std::size_t pos) { return set(pos, !test(pos)); }
+
+    /// inserts a bit before position pos, shifting later bits up by one -- throws std::out_of_range if pos > size()
+    dynamic_bitvector & insert(std::size_t pos, bool value) {
+        throw_if_out_of_range(pos, nbits + 1);
+        if (auto split = insert_rec(*root, pos, value)) {
+            auto newRoot = std::make_unique<Inner>();
+            newRoot->insert_child(0, std::move(root));
+            newRoot->insert_child(1, std::move(split));
+            root = std::move(newRoot);
+        }
+        ++nbits;
+        nones += value;
+        return *this;
+    }
+    /// removes the bit at position pos, shifting later bits down by one -- throws std::out_of_range if pos >= size()
+    dynamic_bitvector & erase(std::size_t pos) {
+        throw_if_out_of_range(pos, nbits);
+        nones -= erase_rec(*root, pos);
+        --nbits;
+        if (!root->isLeaf && as_inner(*root).nchildren == 1) root = std::move(as_inner(*root).children[0]);
+        return *this;
+    }
+    void push_back(bool value) { insert(nbits, value); }
+    void pop_back() { erase(nbits - 1); }
+
+    /// returns the number of ones in positions [0, pos) -- throws std::out_of_range if pos > size()
+    std::size_t rank1(std::size_t pos) const {
+        throw_if_out_of_range(pos, nbits + 1);
+        if (pos == nbits) return nones;
+        std::size_t ret = 0;
+        const Node *n = root.get();
+        while (!n->isLeaf) {
+            const Inner &in = as_inner(*n);
+            std::size_t i = 0;
+            for (; pos >= in.sizes[i]; ++i) {
+                pos -= in.sizes[i];
+                ret += in.ones[i];
+            }
+            n = in.children[i].get();
+        }
+        const Leaf &l = as_leaf(*n);
+        for (std::size_t w = 0; w < pos / WBits; ++w) ret += unsigned(bit_util::popcount(l.bits.word(w)));
+        if (const std::size_t rem = pos % WBits; rem)
+            ret += unsigned(bit_util::popcount(l.bits.word(pos / WBits) & bit_util::low_mask(unsigned(rem))));
+        return ret;
+    }
+    /// returns the number of zeros in positions [0, pos) -- throws std::out_of_range if pos > size()
+    std::size_t rank0(std::size_t pos) const { return pos - rank1(pos); }
+    /// returns the position of the k-th (0-based) one -- throws std::out_of_range if k >= count()
+    std::size_t select1(std::size_t k) const { return select_impl<true>(k); }
+    /// returns the position of the k-th (0-based) zero -- throws std::out_of_range if k >= size() - count()
+    std::size_t select0(std::size_t k) const { return select_impl<false>(k); }
+
+    /// returns the contents as a word array (bit j of word i is bit i * 64 + j); unused bits are 0
+    std::vector<std::uint64_t> to_words() const {
+        std::vector<Word> ret((nbits + WBits - 1) / WBits + 1);
+        std::size_t pos = 0;
+        const auto visit = [&](const Node &n, const auto &self) -> void {
+            if (n.isLeaf) {
+                const Leaf &l = as_leaf(n);
+                Word w[LeafWords];
+                load(l, w);
+                copy_bits(ret.data(), pos, w, 0, l.nbits);
+                pos += l.nbits;
+            } else {
+                const Inner &in = as_inner(n);
+                for (std::size_t i = 0; i < in.nchildren; ++i) self(*in.children[i], self);
+            }
+        };
+        visit(*root, visit);
+        ret.pop_back(); // extra word was just slack for copy_bits
+        return ret;
+    }
+};
@@ -0,0 +1,183 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bit_util.h"
+#include "compact_bitset.h"
+#include "packed_int_vector.h"
+#include "rank_select.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+/// An Elias-Fano encoded monotone (non-decreasing) sequence of unsigned integers in the range [0, universe()).
+///
+/// Each value is split into `l = floor(log2(universe / size))` low bits, stored verbatim in a packed_int_vector, and
+/// the remaining high bits, stored in unary as a bitset: value i sets bit `(value >> l) + i`. This takes at most
+/// `2 + ceil(log2(universe / size))` bits per value. The high bits carry a rank/select index, so random access is a
+/// select1, and next_geq() jumps straight to the right bucket with a select0 rather than scanning.
+class elias_fano
+{
+public:
+    using value_type = std::uint64_t;
+private:
+    std::size_t n = 0;
+    value_type universe_ = 0;
+    unsigned l = 0; ///< number of low bits per value
+    packed_int_vector<0> lows{1};
+    rank_select_bitvector highs;
+
+    value_type low(std::size_t i) const noexcept { return l ? value_type(lows[i]) : 0; }
+    value_type decode(std::size_t i, std::size_t highPos) const noexcept { return value_type(highPos - i) << l | low(i); }
+    template <typename It>
+    void encode(It begin, It end, std::size_t count, value_type universe) {
+        n = count;
+        if (universe == 0 && n) {
+            // figure out the universe from the last (largest) value
+            It last = begin;
+            std::advance(last, std::ptrdiff_t(n - 1));
+            universe = value_type(*last) + 1;
+        }
+        universe_ = universe;
+        l = n && universe_ > n ? unsigned(bit_util::log2(universe_ / n)) : 0;
+        lows = packed_int_vector<0>(l ? l : 1, l ? n : 0);
+        const std::size_t nHighBits = n + std::size_t(universe_ >> l) + 1;
+        std::vector<std::uint64_t> hw((nHighBits + 63) / 64);
+        value_type prev = 0;
+        std::size_t i = 0;
+        for (It it = begin; it != end; ++it, ++i) {
+            const value_type v = value_type(*it);
+            if (v < prev) throw std::invalid_argument("elias_fano requires a non-decreasing sequence");
+            if (v >= universe_) throw std::invalid_argument("elias_fano value is not less than the universe");
+            prev = v;
+            if (l) lows[i] = v & bit_util::low_mask(l);
+            const std::size_t pos = std::size_t(v >> l) + i;
+            hw[pos / 64] |= std::uint64_t(1) << (pos % 64);
+        }
+        highs = rank_select_bitvector(std::move(hw), nHighBits);
+    }
+public:
+    /// Forward iterator that decodes the sequence in order. Each increment is amortized O(1): it just scans the high
+    /// bits for the next one.
+    class const_iterator {
+        friend class elias_fano;
+        const elias_fano *ef = nullptr;
+        std::size_t i = 0; ///< index of the current value
+        std::size_t highPos = 0; ///< position of the current value's one in the high bits
+        const_iterator(const elias_fano *e, std::size_t idx, std::size_t hp) noexcept : ef(e), i(idx), highPos(hp) {}
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = elias_fano::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = value_type;
+
+        const_iterator() noexcept = default;
+        value_type operator*() const noexcept { return ef->decode(i, highPos); }
+        const_iterator & operator++() noexcept {
+            if (++i < ef->n) highPos = ef->highs.next_one(highPos + 1);
+            return *this;
+        }
+        const_iterator operator++(int) noexcept { auto ret = *this; ++*this; return ret; }
+        /// returns the index of the current value within the sequence
+        std::size_t index() const noexcept { return i; }
+        bool operator==(const const_iterator &o) const noexcept { return i == o.i; }
+        bool operator!=(const const_iterator &o) const noexcept { return i != o.i; }
+    };
+    using iterator = const_iterator;
+
+    /// construct an empty sequence
+    elias_fano() = default;
+    /// Encode the non-decreasing sequence [begin, end). `universe` must be greater than every value; if 0, it is taken
+    /// to be one more than the last value.
+    /// @throws std::invalid_argument if the sequence is not non-decreasing or a value is >= universe.
+    template <typename It>
+    elias_fano(It begin, It end, value_type universe = 0) { encode(begin, end, std::size_t(std::distance(begin, end)), universe); }
+    template <typename Int>
+    explicit elias_fano(const std::vector<Int> &values, value_type universe = 0) : elias_fano(values.begin(), values.end(), universe) {}
+    /// encode the positions of the set bits in `bs`, with universe bs.size()
+    template <std::size_t N, typename T>
+    explicit elias_fano(const compact_bitset<N, T> &bs) {
+        // enumerate the set bits word-by-word
+        std::vector<value_type> positions;
+        positions.reserve(bs.count());
+        for (std::size_t w = 0; w < bs.num_words(); ++w)
+            for (std::uint64_t word = bs.word(w); word; word &= word - 1)
+                positions.push_back(w * bs.word_bits + unsigned(bit_util::ctz(word)));
+        encode(positions.begin(), positions.end(), positions.size(), N);
+    }
+
+    std::size_t size() const noexcept { return n; }
+    bool empty() const noexcept { return n == 0; }
+    /// all values are less than this
+    value_type universe() const noexcept { return universe_; }
+    /// number of low bits stored per value
+    unsigned low_bits() const noexcept { return l; }
+    /// returns the number of bytes used by the encoding, including the rank/select index
+    std::size_t bytes_used() const noexcept { return (l ? lows.bits_size() : 0) + highs.bits_size() + highs.index_size(); }
+
+    /// returns the i-th value. i must be < size().
+    value_type operator[](std::size_t i) const { return decode(i, highs.select1(i)); }
+    /// returns the i-th value -- throws std::out_of_range if i >= size()
+    value_type at(std::size_t i) const {
+        if (i >= n) throw std::out_of_range("Out-of-range index specified to elias_fano");
+        return (*this)[i];
+    }
+
+    const_iterator begin() const { return n ? const_iterator(this, 0, highs.select1(0)) : end(); }
+    const_iterator end() const noexcept { return const_iterator(this, n, 0); }
+
+    /// Returns an iterator to the first value >= x, or end() if there is none. This selects the start of x's bucket
+    /// in the high bits in O(1), then scans only within that bucket.
+    const_iterator next_geq(value_type x) const {
+        if (x >= universe_ || !n) return end();
+        const std::size_t h = std::size_t(x >> l);
+        // the bucket for high part h starts right after the h-th zero; every one before it is a smaller value
+        std::size_t pos = h ? highs.select0(h - 1) + 1 : 0;
+        std::size_t i = pos - h;
+        for (pos = highs.next_one(pos); i < n; ++i, pos = highs.next_one(pos + 1))
+            if (decode(i, pos) >= x) return const_iterator(this, i, pos);
+        return end();
+    }
+
+    /// decode the whole sequence into `out`, which must have room for size() values
+    template <typename Int>
+    void decode_all(Int *out) const {
+        for (auto v : *this) *out++ = Int(v);
+    }
+    /// returns a membership bitmap of the values in the sequence. Values >= N are ignored.
+    template <std::size_t N, typename T = typename compact_bitset<N>::word_type>
+    compact_bitset<N, T> to_bitset() const {
+        compact_bitset<N, T> ret;
+        for (auto it = next_geq(0), e = end(); it != e; ++it) {
+            const value_type v = *it;
+            if (v >= N) break;
+            ret[std::size_t(v)] = true;
+        }
+        return ret;
+    }
+};
@@ -0,0 +1,328 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bit_util.h"
+#include "compact_bitset.h"
+
+#include <algorithm>
+#include <cstddef> // for std::byte
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+/// A run-length compressed bitset in the Enhanced Word-Aligned Hybrid (EWAH) format, for bitmaps with long runs of
+/// zeros or ones.
+///
+/// The bits are split into 64-bit words. Words that are all 0 or all 1 ("clean" words) are stored only as a count,
+/// other ("dirty") words are stored verbatim. The stream is a sequence of marker words, each followed by its dirty
+/// words. A marker holds: bit 0 = the value of its clean run, bits [1, 33) = the number of clean words, bits [33, 64)
+/// = the number of dirty words that follow it.
+///
+/// Bitwise AND/OR/XOR work directly on the compressed streams: a clean run is combined with the other operand in one
+/// step, so the cost is proportional to the compressed sizes rather than to size(). The bitset is built by
+/// appending; bits may only be set in increasing order. As with compact_bitset, unused bits past size() are always 0.
+class ewah_bitset
+{
+    using Word = std::uint64_t;
+    static constexpr std::size_t WBits = 64;
+    static constexpr unsigned RunLenBits = 32, DirtyBits = 31;
+    static constexpr Word MaxRunLen = (Word(1) << RunLenBits) - 1, MaxDirty = (Word(1) << DirtyBits) - 1;
+
+    std::vector<Word> buffer{Word(0)}; ///< always starts with a marker
+    std::size_t marker = 0; ///< index of the last marker in buffer, which new words are appended to
+    std::size_t nbits = 0;
+    std::size_t nwords = 0; ///< number of (uncompressed) words appended so far
+
+    static bool run_bit(Word m) noexcept { return m & 0x1; }
+    static Word run_len(Word m) noexcept { return m >> 1 & MaxRunLen; }
+    static Word dirty_count(Word m) noexcept { return m >> (1 + RunLenBits); }
+    static Word make_marker(bool bit, Word run, Word dirty) noexcept { return Word(bit) | run << 1 | dirty << (1 + RunLenBits); }
+
+    void new_marker() { marker = buffer.size(); buffer.push_back(0); }
+    void add_dirty(Word w) {
+        if (dirty_count(buffer[marker]) == MaxDirty) new_marker();
+        const Word m = buffer[marker];
+        buffer[marker] = make_marker(run_bit(m), run_len(m), dirty_count(m) + 1);
+        buffer.push_back(w);
+        ++nwords;
+    }
+    void add_run(bool bit, Word n) {
+        nwords += n;
+        while (n) {
+            Word m = buffer[marker];
+            // a run may only extend a marker that has no dirty words yet, and whose run is of the same bit (or empty)
+            if (dirty_count(m) || (run_len(m) && run_bit(m) != bit) || run_len(m) == MaxRunLen) { new_marker(); m = 0; }
+            const Word take = std::min(n, MaxRunLen - run_len(m));
+            buffer[marker] = make_marker(bit, run_len(m) + take, 0);
+            n -= take;
+        }
+    }
+
+    /// Reads a compressed stream as a sequence of clean runs and dirty words.
+    class reader {
+        const Word *next, *end; ///< next marker to load
+    public:
+        bool bit = false; ///< value of the current clean run
+        Word run = 0; ///< clean words left in the current run
+        Word dirty = 0; ///< dirty words left after the current run
+        const Word *lit = nullptr; ///< next dirty word
+        reader() noexcept : next(nullptr), end(nullptr) {}
+        explicit reader(const std::vector<Word> &buf) noexcept : next(buf.data()), end(buf.data() + buf.size()) { load(); }
+        /// true if there are no words left
+        bool done() const noexcept { return !run && !dirty; }
+        void load() noexcept {
+            while (!run && !dirty && next < end) {
+                const Word m = *next;
+                bit = run_bit(m);
+                run = run_len(m);
+                dirty = dirty_count(m);
+                lit = next + 1;
+                next = lit + dirty;
+            }
+        }
+        void skip_run(Word n) noexcept { run -= n; load(); }
+        void skip_dirty(Word n) noexcept { lit += n; dirty -= n; load(); }
+    };
+
+    template <typename Op>
+    static ewah_bitset binary_op(const ewah_bitset &a, const ewah_bitset &b, Op op) {
+        ewah_bitset ret;
+        reader ra(a.buffer), rb(b.buffer);
+        const auto fill = [](const reader &r) { return !r.done() && r.bit ? ~Word(0) : Word(0); };
+        // an exhausted operand acts as an endless run of zeros
+        const auto in_run = [](const reader &r) { return r.done() || r.run; };
+        while (!ra.done() || !rb.done()) {
+            if (in_run(ra) && in_run(rb)) {
+                const Word n = ra.done() ? rb.run : rb.done() ? ra.run : std::min(ra.run, rb.run);
+                ret.add_run(op(fill(ra), fill(rb)) & 0x1, n);
+                if (!ra.done()) ra.skip_run(n);
+                if (!rb.done()) rb.skip_run(n);
+            } else if (in_run(ra) || in_run(rb)) {
+                reader &rr = in_run(ra) ? ra : rb, &rd = in_run(ra) ? rb : ra;
+                const Word n = rr.done() ? rd.dirty : std::min(rr.run, rd.dirty), f = fill(rr);
+                if (const Word r0 = op(f, 0); r0 == op(f, ~Word(0)))
+                    ret.add_run(r0 & 0x1, n); // the run decides the result (e.g. AND with 0s): skip the dirty words
+                else
+                    for (Word i = 0; i < n; ++i) ret.add_word(op(f, rd.lit[i]));
+                if (!rr.done()) rr.skip_run(n);
+                rd.skip_dirty(n);
+            } else {
+                const Word n = std::min(ra.dirty, rb.dirty);
+                for (Word i = 0; i < n; ++i) ret.add_word(op(ra.lit[i], rb.lit[i]));
+                ra.skip_dirty(n);
+                rb.skip_dirty(n);
+            }
+        }
+        ret.nbits = std::max(a.nbits, b.nbits);
+        return ret;
+    }
+public:
+    /// Forward iterator over the positions of the set bits, in increasing order. Runs of zeros are skipped in O(1).
+    class const_iterator {
+        friend class ewah_bitset;
+        reader r;
+        std::size_t nextWord = 0; ///< index of the next word to fetch from r
+        Word cur = 0; ///< remaining set bits of the word before nextWord
+        std::size_t pos = 0;
+        bool atEnd = false;
+        explicit const_iterator(const ewah_bitset &e) noexcept : r(e.buffer) { advance(); }
+        void advance() noexcept {
+            while (!cur) {
+                if (r.done()) { atEnd = true; return; }
+                if (r.run) {
+                    if (!r.bit) { nextWord += r.run; r.skip_run(r.run); continue; }
+                    cur = ~Word(0);
+                    r.skip_run(1);
+                } else {
+                    cur = *r.lit;
+                    r.skip_dirty(1);
+                }
+                ++nextWord;
+            }
+            pos = (nextWord - 1) * WBits + unsigned(bit_util::ctz(cur));
+            cur &= cur - 1;
+        }
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::size_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::size_t *;
+        using reference = std::size_t;
+
+        const_iterator() noexcept : atEnd(true) {}
+        std::size_t operator*() const noexcept { return pos; }
+        const_iterator & operator++() noexcept { advance(); return *this; }
+        const_iterator operator++(int) noexcept { auto ret = *this; advance(); return ret; }
+        bool operator==(const const_iterator &o) const noexcept { return atEnd == o.atEnd && (atEnd || pos == o.pos); }
+        bool operator!=(const const_iterator &o) const noexcept { return !(*this == o); }
+    };
+    using iterator = const_iterator;
+
+    /// construct an empty bitset
+    ewah_bitset() = default;
+    /// compress the bits of a compact_bitset
+    template <std::size_t N, typename T>
+    explicit ewah_bitset(const compact_bitset<N, T> &bs) {
+        constexpr std::size_t PerWord = WBits / compact_bitset<N, T>::word_bits;
+        for (std::size_t i = 0; i < bs.num_words(); i += PerWord) {
+            Word w = 0;
+            for (std::size_t j = 0; j < PerWord && i + j < bs.num_words(); ++j)
+                w |= Word(bs.word(i + j)) << (j * compact_bitset<N, T>::word_bits);
+            add_word(w);
+        }
+        nbits = N;
+    }
+    /// compress `n` bits stored in `words` (bit j of words[i] is bit i * 64 + j)
+    ewah_bitset(const std::vector<std::uint64_t> &words, std::size_t n) {
+        if (words.size() * WBits < n) throw std::invalid_argument("Word array is too small for the specified number of bits");
+        for (std::size_t i = 0; i * WBits < n; ++i)
+            add_word(n - i * WBits < WBits ? words[i] & bit_util::low_mask(unsigned(n - i * WBits)) : words[i]);
+        nbits = n;
+    }
+
+    /// Append 64 bits, starting at the next word boundary at or after size().
+    void add_word(std::uint64_t w) {
+        nbits = nwords * WBits;
+        if (w == 0) add_run(false, 1);
+        else if (w == ~Word(0)) add_run(true, 1);
+        else add_dirty(w);
+        nbits += WBits;
+    }
+    /// Append `n` words of all zeros (or all ones), starting at the next word boundary at or after size().
+    void add_clean_words(bool bit, std::size_t n) { nbits = nwords * WBits; add_run(bit, n); nbits += n * WBits; }
+    /// Set bit pos, which must be >= size() (bits are appended in increasing order); size() becomes pos + 1.
+    /// @throws std::invalid_argument if pos < size()
+    ewah_bitset & set(std::size_t pos) {
+        if (pos < nbits) throw std::invalid_argument("ewah_bitset bits must be set in increasing order");
+        const std::size_t w = pos / WBits;
+        const Word bit = Word(1) << (pos % WBits);
+        if (w >= nwords) {
+            add_run(false, w - nwords);
+            add_word(bit);
+        } else if (dirty_count(buffer[marker])) {
+            buffer.back() |= bit; // the bit goes in the last word, which is dirty: just set it (it stays a dirty word)
+        } else {
+            // the last word is the end of a clean run of zeros: take it off the run and re-add it as a dirty word
+            const Word m = buffer[marker];
+            buffer[marker] = make_marker(run_bit(m), run_len(m) - 1, 0);
+            --nwords;
+            add_dirty(bit);
+        }
+        nbits = pos + 1;
+        return *this;
+    }
+    /// Extend (or shrink, if none of the removed bits are set) the bitset to n bits.
+    void set_size_in_bits(std::size_t n) {
+        if (n > nwords * WBits) add_run(false, (n + WBits - 1) / WBits - nwords);
+        nbits = n;
+    }
+
+    std::size_t size() const noexcept { return nbits; }
+    bool empty() const noexcept { return nbits == 0; }
+    /// returns the number of bits set to true. Runs of ones count in O(1).
+    std::size_t count() const noexcept {
+        std::size_t ret = 0;
+        for (reader r(buffer); !r.done(); ) {
+            if (r.run) { ret += r.bit ? std::size_t(r.run) * WBits : 0; r.skip_run(r.run); }
+            else { ret += unsigned(bit_util::popcount(*r.lit)); r.skip_dirty(1); }
+        }
+        return ret;
+    }
+    bool any() const noexcept { return begin() != end(); }
+    bool none() const noexcept { return !any(); }
+    /// returns the bit at pos, in O(number of markers) -- throws std::out_of_range if pos >= size()
+    bool test(std::size_t pos) const {
+        if (pos >= nbits) throw std::out_of_range("Out-of-range bit position specified to ewah_bitset");
+        std::size_t w = pos / WBits;
+        for (reader r(buffer); !r.done(); ) {
+            if (r.run) {
+                if (w < r.run) return r.bit;
+                w -= r.run;
+                r.skip_run(r.run);
+            } else {
+                if (w < r.dirty) return r.lit[w] >> (pos % WBits) & 0x1;
+                w -= r.dirty;
+                r.skip_dirty(r.dirty);
+            }
+        }
+        return false;
+    }
+
+    const_iterator begin() const noexcept { return const_iterator(*this); }
+    const_iterator end() const noexcept { return const_iterator(); }
+
+    /// decompress into a compact_bitset. Bits >= N are ignored.
+    template <std::size_t N, typename T = typename compact_bitset<N>::word_type>
+    compact_bitset<N, T> to_bitset() const {
+        compact_bitset<N, T> ret;
+        constexpr std::size_t TBits = compact_bitset<N, T>::word_bits, PerWord = WBits / TBits;
+        std::size_t w = 0;
+        const auto put = [&ret](std::size_t word, Word v) {
+            for (std::size_t j = 0; j < PerWord && word * PerWord + j < ret.num_words(); ++j)
+                ret.set_word(word * PerWord + j, T(v >> (j * TBits)));
+        };
+        for (reader r(buffer); !r.done() && w * PerWord < ret.num_words(); ) {
+            if (r.run) {
+                if (r.bit)
+                    for (Word i = 0; i < r.run && (w + i) * PerWord < ret.num_words(); ++i) put(w + i, ~Word(0));
+                w += r.run;
+                r.skip_run(r.run);
+            } else {
+                put(w++, *r.lit);
+                r.skip_dirty(1);
+            }
+        }
+        return ret;
+    }
+    /// decompress into a word array (bit j of word i is bit i * 64 + j)
+    std::vector<std::uint64_t> to_words() const {
+        std::vector<Word> ret;
+        ret.reserve(nwords);
+        for (reader r(buffer); !r.done(); ) {
+            if (r.run) { ret.insert(ret.end(), r.run, r.bit ? ~Word(0) : Word(0)); r.skip_run(r.run); }
+            else { ret.push_back(*r.lit); r.skip_dirty(1); }
+        }
+        ret.resize((nbits + WBits - 1) / WBits);
+        return ret;
+    }
+
+    // -- bitwise operator support, on the compressed streams. The result has the size of the larger operand.
+    friend ewah_bitset operator&(const ewah_bitset &a, const ewah_bitset &b) { return binary_op(a, b, [](Word x, Word y) { return x & y; }); }
+    friend ewah_bitset operator|(const ewah_bitset &a, const ewah_bitset &b) { return binary_op(a, b, [](Word x, Word y) { return x | y; }); }
+    friend ewah_bitset operator^(const ewah_bitset &a, const ewah_bitset &b) { return binary_op(a, b, [](Word x, Word y) { return x ^ y; }); }
+    ewah_bitset & operator&=(const ewah_bitset &o) { return *this = *this & o; }
+    ewah_bitset & operator|=(const ewah_bitset &o) { return *this = *this | o; }
+    ewah_bitset & operator^=(const ewah_bitset &o) { return *this = *this ^ o; }
+
+    /// equal if both have the same size and bits (regardless of how they happen to be compressed)
+    bool operator==(const ewah_bitset &o) const { return nbits == o.nbits && (*this ^ o).none(); }
+    bool operator!=(const ewah_bitset &o) const { return !(*this == o); }
+
+    /// access to the compressed stream
+    const std::byte *bits() const noexcept { return reinterpret_cast<const std::byte *>(buffer.data()); }
+    /// returns the number of bytes in the .bits() array
+    std::size_t bits_size() const noexcept { return buffer.size() * sizeof(Word); }
+};
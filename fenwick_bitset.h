@@ -0,0 +1,150 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bit_util.h"
+#include "compact_bitset.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+/// A compact_bitset that maintains a Fenwick (binary indexed) tree over the popcounts of its words, so that rank and
+/// select stay O(log N) while single-bit updates cost only O(log N) rather than the O(N) of rebuilding a static index.
+///
+/// All mutation goes through this class (so that the index never goes stale); the underlying compact_bitset is
+/// available read-only via bitset(). The index costs 32 bits per word of the bitset.
+template<std::size_t N, typename T = typename compact_bitset<N>::word_type>
+class fenwick_bitset
+{
+    using Bitset = compact_bitset<N, T>;
+    static constexpr std::size_t NWords = Bitset::num_words();
+    static constexpr std::size_t TBits = Bitset::word_bits;
+    static_assert(N < (std::size_t(1) << 32), "fenwick_bitset supports at most 2^32 - 1 bits");
+    Bitset bs;
+    std::array<std::uint32_t, NWords + 1> tree{}; ///< 1-based Fenwick tree: tree[i] = ones in words (i - lowbit(i), i]
+
+    static constexpr std::size_t lowbit(std::size_t i) noexcept { return i & (~i + 1); }
+    // the largest power of two <= NWords, for the select descent
+    static constexpr std::size_t top_step() noexcept {
+        std::size_t s = 1;
+        while (s * 2 <= NWords) s *= 2;
+        return s;
+    }
+    void add(std::size_t word, int delta) noexcept {
+        for (std::size_t i = word + 1; i <= NWords; i += lowbit(i))
+            tree[i] = std::uint32_t(int(tree[i]) + delta);
+    }
+    void rebuild() noexcept {
+        tree.fill(0);
+        for (std::size_t i = 1; i <= NWords; ++i) {
+            tree[i] += std::uint32_t(bit_util::popcount(bs.word(i - 1)));
+            if (const std::size_t parent = i + lowbit(i); parent <= NWords) tree[parent] += tree[i];
+        }
+    }
+    void throw_if_out_of_range(std::size_t pos) const {
+        if (pos >= N) throw std::out_of_range("Out-of-range bit position specified to fenwick_bitset");
+    }
+    // returns the number of ones in words [0, w)
+    std::size_t prefix(std::size_t w) const noexcept {
+        std::size_t ret = 0;
+        for (; w; w -= lowbit(w)) ret += tree[w];
+        return ret;
+    }
+    template <bool Bit>
+    std::size_t select_impl(std::size_t k) const {
+        if (k >= (Bit ? count() : N - count())) throw std::out_of_range("Out-of-range rank specified to fenwick_bitset::select");
+        // binary lifting: find the last word boundary before which there are at most k matching bits
+        std::size_t w = 0;
+        for (std::size_t step = top_step(); step; step /= 2) {
+            if (w + step > NWords) continue;
+            const std::size_t c = Bit ? tree[w + step] : step * TBits - tree[w + step];
+            if (c <= k) {
+                w += step;
+                k -= c;
+            }
+        }
+        const T word = Bit ? bs.word(w) : T(~bs.word(w));
+        return w * TBits + unsigned(bit_util::select_in_word(word, unsigned(k)));
+    }
+public:
+    /// default-construct: all bits are 0
+    fenwick_bitset() noexcept = default;
+    /// copy the bits of `b`, and build the index in O(N / word_bits)
+    explicit fenwick_bitset(const Bitset &b) noexcept : bs(b) { rebuild(); }
+    /// replace the bits with those of `b`, and rebuild the index in O(N / word_bits)
+    fenwick_bitset & operator=(const Bitset &b) noexcept { bs = b; rebuild(); return *this; }
+
+    /// read-only access to the underlying bitset
+    const Bitset & bitset() const noexcept { return bs; }
+    operator const Bitset &() const noexcept { return bs; }
+    static constexpr std::size_t size() noexcept { return N; }
+
+    bool operator[](std::size_t pos) const noexcept { return bs[pos]; }
+    bool test(std::size_t pos) const { return bs.test(pos); }
+    /// returns the number of bits set to true, in O(log N)
+    std::size_t count() const noexcept { return prefix(NWords); }
+    bool all() const noexcept { return count() == N; }
+    bool any() const noexcept { return count() != 0; }
+    bool none() const noexcept { return count() == 0; }
+
+    /// set a specific bit -- throws std::out_of_range if pos >= size()
+    fenwick_bitset & set(std::size_t pos, bool value = true) {
+        throw_if_out_of_range(pos);
+        auto ref = bs[pos];
+        if (bool(ref) != value) {
+            ref = value;
+            add(pos / TBits, value ? 1 : -1);
+        }
+        return *this;
+    }
+    /// sets the bit at position pos to false -- throws std::out_of_range if pos >= size()
+    fenwick_bitset & reset(std::size_t pos) { return set(pos, false); }
+    /// flips the bit at position pos -- throws std::out_of_range if pos >= size()
+    fenwick_bitset & flip(std::size_t pos) { throw_if_out_of_range(pos); return set(pos, !bs[pos]); }
+    /// set all bits to true
+    fenwick_bitset & set() noexcept { bs.set(); rebuild(); return *this; }
+    /// sets all bits to false
+    fenwick_bitset & reset() noexcept { bs.reset(); tree.fill(0); return *this; }
+    /// flips all bits
+    fenwick_bitset & flip() noexcept { bs.flip(); rebuild(); return *this; }
+
+    /// returns the number of ones in positions [0, pos). pos may be in the range [0, size()].
+    std::size_t rank1(std::size_t pos) const noexcept {
+        std::size_t ret = prefix(pos / TBits);
+        if (const std::size_t rem = pos % TBits; rem)
+            ret += unsigned(bit_util::popcount(bs.word(pos / TBits) & bit_util::low_mask(unsigned(rem))));
+        return ret;
+    }
+    /// returns the number of zeros in positions [0, pos). pos may be in the range [0, size()].
+    std::size_t rank0(std::size_t pos) const noexcept { return pos - rank1(pos); }
+    /// returns the position of the k-th (0-based) one -- throws std::out_of_range if k >= count()
+    std::size_t select1(std::size_t k) const { return select_impl<true>(k); }
+    /// returns the position of the k-th (0-based) zero -- throws std::out_of_range if k >= size() - count()
+    std::size_t select0(std::size_t k) const { return select_impl<false>(k); }
+
+    bool operator==(const fenwick_bitset &o) const noexcept { return bs == o.bs; }
+    bool operator!=(const fenwick_bitset &o) const noexcept { return !(*this == o); }
+};
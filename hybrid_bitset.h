@@ -0,0 +1,256 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bit_util.h"
+#include "compact_bitset.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+/// A set of bit positions in [0, N) that adapts its representation to its density: a sorted array of positions while
+/// it is sparse, and a heap-allocated compact_bitset<N, T> once the array would take more memory than the bitset.
+///
+/// A sparse set converts to dense when its array grows past the size of the bitset, and a dense set converts back
+/// once its count drops below half of that (the gap avoids flip-flopping). All operations, including the bitwise
+/// operators, are defined across both representations, and results are normalized the same way.
+template<std::size_t N, typename T = typename compact_bitset<N>::word_type>
+class hybrid_bitset
+{
+public:
+    using Bitset = compact_bitset<N, T>;
+    /// the type used to store positions in the sparse representation
+    using position_type = std::conditional_t<(N <= (std::size_t(1) << 16)), std::uint16_t,
+                                             std::conditional_t<(N <= (std::size_t(1) << 32)), std::uint32_t, std::uint64_t>>;
+private:
+    static constexpr std::size_t TBits = Bitset::word_bits, NWords = Bitset::num_words();
+    /// sparse sets with more positions than this become dense
+    static constexpr std::size_t DenseThreshold = std::max<std::size_t>(1, NWords * sizeof(T) / sizeof(position_type));
+    /// dense sets with fewer set bits than this become sparse
+    static constexpr std::size_t SparseThreshold = DenseThreshold / 2;
+
+    std::vector<position_type> sparse; ///< sorted positions, used when dense is null
+    std::unique_ptr<Bitset> dense;
+    std::size_t ncount = 0; ///< number of set bits, in either representation
+
+    void throw_if_out_of_range(std::size_t pos) const {
+        if (pos >= N) throw std::out_of_range("Out-of-range bit position specified to hybrid_bitset");
+    }
+    void to_dense() {
+        auto d = std::make_unique<Bitset>();
+        for (const auto pos : sparse) (*d)[pos] = true;
+        dense = std::move(d);
+        sparse.clear();
+        sparse.shrink_to_fit();
+    }
+    void to_sparse() {
+        std::vector<position_type> s;
+        s.reserve(ncount);
+        for (std::size_t w = 0; w < NWords; ++w)
+            for (std::uint64_t word = dense->word(w); word; word &= word - 1)
+                s.push_back(position_type(w * TBits + unsigned(bit_util::ctz(word))));
+        sparse = std::move(s);
+        dense.reset();
+    }
+    // switch representations if the count has crossed a threshold
+    void normalize() {
+        if (dense && ncount < SparseThreshold) to_sparse();
+        else if (!dense && ncount > DenseThreshold) to_dense();
+    }
+    // returns the first set position >= pos in a dense set, or N
+    std::size_t dense_next(std::size_t pos) const noexcept {
+        if (pos >= N) return N;
+        std::size_t w = pos / TBits;
+        std::uint64_t word = dense->word(w) & ~bit_util::low_mask(unsigned(pos % TBits));
+        while (!word) {
+            if (++w >= NWords) return N;
+            word = dense->word(w);
+        }
+        return w * TBits + unsigned(bit_util::ctz(word));
+    }
+
+    enum class Op { And, Or, Xor };
+    static bool apply(Op op, bool a, bool b) noexcept { return op == Op::And ? a && b : op == Op::Or ? a || b : a != b; }
+    static hybrid_bitset binary_op(const hybrid_bitset &a, const hybrid_bitset &b, Op op) {
+        hybrid_bitset ret;
+        if (a.dense && b.dense) {
+            // dense with dense: word at a time
+            ret.dense = std::make_unique<Bitset>();
+            for (std::size_t w = 0; w < NWords; ++w) {
+                const T x = a.dense->word(w), y = b.dense->word(w);
+                const T r = op == Op::And ? T(x & y) : op == Op::Or ? T(x | y) : T(x ^ y);
+                ret.dense->set_word(w, r);
+                ret.ncount += unsigned(bit_util::popcount(r));
+            }
+        } else if (a.dense || b.dense) {
+            // sparse with dense: probe the dense side for each sparse position (AND stays sparse), or copy the dense
+            // side and apply each sparse position to it
+            const hybrid_bitset &d = a.dense ? a : b, &s = a.dense ? b : a;
+            if (op == Op::And) {
+                for (const auto pos : s.sparse)
+                    if ((*d.dense)[pos]) ret.sparse.push_back(pos);
+                ret.ncount = ret.sparse.size();
+            } else {
+                ret.dense = std::make_unique<Bitset>(*d.dense);
+                ret.ncount = d.ncount;
+                for (const auto pos : s.sparse) {
+                    auto ref = (*ret.dense)[pos];
+                    const bool old = ref, now = apply(op, old, true);
+                    ref = now;
+                    ret.ncount += std::size_t(now) - std::size_t(old);
+                }
+            }
+        } else {
+            // sparse with sparse: merge the sorted arrays
+            auto i = a.sparse.begin(), j = b.sparse.begin();
+            const auto ie = a.sparse.end(), je = b.sparse.end();
+            while (i != ie || j != je) {
+                const bool inA = i != ie && (j == je || *i <= *j), inB = j != je && (i == ie || *j <= *i);
+                const position_type pos = inA ? *i : *j;
+                if (apply(op, inA, inB)) ret.sparse.push_back(pos);
+                i += inA;
+                j += inB;
+            }
+            ret.ncount = ret.sparse.size();
+        }
+        ret.normalize();
+        return ret;
+    }
+public:
+    /// Forward iterator over the set positions, in increasing order.
+    class const_iterator {
+        friend class hybrid_bitset;
+        const hybrid_bitset *hb = nullptr;
+        std::size_t idx = 0; ///< index into sparse, or the current position if dense
+        const_iterator(const hybrid_bitset *h, std::size_t i) noexcept : hb(h), idx(i) {}
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::size_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::size_t *;
+        using reference = std::size_t;
+
+        const_iterator() noexcept = default;
+        std::size_t operator*() const noexcept { return hb->dense ? idx : hb->sparse[idx]; }
+        const_iterator & operator++() noexcept { idx = hb->dense ? hb->dense_next(idx + 1) : idx + 1; return *this; }
+        const_iterator operator++(int) noexcept { auto ret = *this; ++*this; return ret; }
+        bool operator==(const const_iterator &o) const noexcept { return idx == o.idx; }
+        bool operator!=(const const_iterator &o) const noexcept { return idx != o.idx; }
+    };
+    using iterator = const_iterator;
+
+    /// default-construct: an empty (sparse) set
+    hybrid_bitset() noexcept = default;
+    /// construct from the set bits of a compact_bitset, in whichever representation suits its density
+    explicit hybrid_bitset(const Bitset &bs) : dense(std::make_unique<Bitset>(bs)), ncount(bs.count()) { normalize(); }
+    hybrid_bitset(const hybrid_bitset &o) : sparse(o.sparse), dense(o.dense ? std::make_unique<Bitset>(*o.dense) : nullptr), ncount(o.ncount) {}
+    hybrid_bitset(hybrid_bitset &&o) noexcept : sparse(std::move(o.sparse)), dense(std::move(o.dense)), ncount(o.ncount) { o.ncount = 0; o.sparse.clear(); }
+    hybrid_bitset & operator=(const hybrid_bitset &o) { return *this = hybrid_bitset(o); }
+    hybrid_bitset & operator=(hybrid_bitset &&o) noexcept {
+        sparse = std::move(o.sparse);
+        dense = std::move(o.dense);
+        ncount = o.ncount;
+        o.ncount = 0;
+        o.sparse.clear();
+        return *this;
+    }
+
+    static constexpr std::size_t size() noexcept { return N; }
+    /// returns true if the set is currently stored as a bitset rather than a sorted array
+    bool is_dense() const noexcept { return bool(dense); }
+    /// returns the number of bytes of heap memory used
+    std::size_t bytes_used() const noexcept { return dense ? sizeof(Bitset) : sparse.capacity() * sizeof(position_type); }
+
+    bool test(std::size_t pos) const {
+        throw_if_out_of_range(pos);
+        if (dense) return (*dense)[pos];
+        return std::binary_search(sparse.begin(), sparse.end(), position_type(pos));
+    }
+    bool operator[](std::size_t pos) const { return test(pos); }
+    /// returns the number of bits set to true, in O(1)
+    std::size_t count() const noexcept { return ncount; }
+    bool any() const noexcept { return ncount != 0; }
+    bool none() const noexcept { return ncount == 0; }
+
+    /// set a specific bit -- throws std::out_of_range if pos >= size()
+    hybrid_bitset & set(std::size_t pos, bool value = true) {
+        throw_if_out_of_range(pos);
+        if (dense) {
+            auto ref = (*dense)[pos];
+            if (bool(ref) == value) return *this;
+            ref = value;
+        } else {
+            const auto it = std::lower_bound(sparse.begin(), sparse.end(), position_type(pos));
+            const bool present = it != sparse.end() && *it == pos;
+            if (present == value) return *this;
+            if (value) sparse.insert(it, position_type(pos));
+            else sparse.erase(it);
+        }
+        ncount = value ? ncount + 1 : ncount - 1;
+        normalize();
+        return *this;
+    }
+    /// sets the bit at position pos to false -- throws std::out_of_range if pos >= size()
+    hybrid_bitset & reset(std::size_t pos) { return set(pos, false); }
+    /// flips the bit at position pos -- throws std::out_of_range if pos >= size()
+    hybrid_bitset & flip(std::size_t pos) { return set(pos, !test(pos)); }
+    /// sets all bits to false
+    hybrid_bitset & reset() noexcept { sparse.clear(); dense.reset(); ncount = 0; return *this; }
+
+    const_iterator begin() const noexcept { return const_iterator(this, dense ? dense_next(0) : 0); }
+    const_iterator end() const noexcept { return const_iterator(this, dense ? N : sparse.size()); }
+
+    /// returns the set as a compact_bitset
+    Bitset to_bitset() const {
+        if (dense) return *dense;
+        Bitset ret;
+        for (const auto pos : sparse) ret[pos] = true;
+        return ret;
+    }
+
+    // -- bitwise operator support, across representations
+    friend hybrid_bitset operator&(const hybrid_bitset &a, const hybrid_bitset &b) { return binary_op(a, b, Op::And); }
+    friend hybrid_bitset operator|(const hybrid_bitset &a, const hybrid_bitset &b) { return binary_op(a, b, Op::Or); }
+    friend hybrid_bitset operator^(const hybrid_bitset &a, const hybrid_bitset &b) { return binary_op(a, b, Op::Xor); }
+    hybrid_bitset & operator&=(const hybrid_bitset &o) { return *this = *this & o; }
+    hybrid_bitset & operator|=(const hybrid_bitset &o) { return *this = *this | o; }
+    hybrid_bitset & operator^=(const hybrid_bitset &o) { return *this = *this ^ o; }
+
+    bool operator==(const hybrid_bitset &o) const noexcept {
+        if (ncount != o.ncount) return false;
+        if (dense && o.dense) return *dense == *o.dense;
+        if (!dense && !o.dense) return sparse == o.sparse;
+        const hybrid_bitset &d = dense ? *this : o, &s = dense ? o : *this;
+        for (const auto pos : s.sparse)
+            if (!(*d.dense)[pos]) return false;
+        return true;
+    }
+    bool operator!=(const hybrid_bitset &o) const noexcept { return !(*this == o); }
+};
@@ -0,0 +1,162 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "compact_bitset.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/// Kernels combining a sorted list of positions with a compact_bitset, in time proportional to the list size rather
+/// than to the size of the bitset (except where a whole bitset is returned). Positions >= N are never members of the
+/// bitset.
+///
+/// Membership is probed 8 positions at a time. With AVX2 the 8 words are fetched with a single gather; otherwise the
+/// probes are unrolled and the matches are written out branch-free.
+namespace list_ops {
+
+namespace detail {
+// returns the end of the prefix of the sorted list whose positions are < N
+template <std::size_t N>
+inline const std::uint32_t *in_range_end(const std::uint32_t *list, std::size_t n) noexcept {
+    if constexpr (N > 0xFFFFFFFFull) return list + n;
+    else return std::lower_bound(list, list + n, std::uint32_t(N));
+}
+// Appends each position in [list, end) for which membership in bs equals `want` to out, returning the new end of out.
+// All positions must be < N.
+template <bool Want, std::size_t N, typename T>
+inline std::uint32_t *probe(const std::uint32_t *list, const std::uint32_t *end, const compact_bitset<N, T> &bs, std::uint32_t *out) noexcept {
+    constexpr std::size_t TBits = compact_bitset<N, T>::word_bits;
+#if defined(__AVX2__)
+    if constexpr (N > 0 && compact_bitset<N, T>::num_words() * sizeof(T) % sizeof(std::uint32_t) == 0) {
+        // view the words as 32-bit lanes (x86 is little-endian, so bit i is bit i % 32 of lane i / 32)
+        const int *lanes = reinterpret_cast<const int *>(bs.bits());
+        const __m256i lo5 = _mm256_set1_epi32(31), one = _mm256_set1_epi32(1);
+        for (; end - list >= 8; list += 8) {
+            const __m256i ids = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(list));
+            const __m256i words = _mm256_i32gather_epi32(lanes, _mm256_srli_epi32(ids, 5), 4);
+            const __m256i bits = _mm256_and_si256(_mm256_srlv_epi32(words, _mm256_and_si256(ids, lo5)), one);
+            unsigned mask = unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(bits, one))));
+            if constexpr (!Want) mask = ~mask & 0xFFu;
+            for (; mask; mask &= mask - 1) *out++ = list[__builtin_ctz(mask)];
+        }
+    }
+#endif
+    for (; end - list >= 8; list += 8) {
+        bool hit[8];
+        for (int k = 0; k < 8; ++k) hit[k] = (bs.word(list[k] / TBits) >> (list[k] % TBits) & 0x1) == Want;
+        for (int k = 0; k < 8; ++k) { *out = list[k]; out += hit[k]; } // branch-free compaction
+    }
+    for (; list < end; ++list) {
+        *out = *list;
+        out += (bs.word(*list / TBits) >> (*list % TBits) & 0x1) == Want;
+    }
+    return out;
+}
+template <std::size_t N>
+inline void throw_if_out_of_range(const std::uint32_t *list, std::size_t n) {
+    if (n && std::size_t(list[n - 1]) >= N) throw std::out_of_range("Out-of-range bit position in list specified to list_ops");
+}
+} // namespace detail
+
+/// Returns the positions of the sorted list that are set in bs, in order. O(n).
+template <std::size_t N, typename T>
+std::vector<std::uint32_t> intersect(const std::uint32_t *list, std::size_t n, const compact_bitset<N, T> &bs) {
+    std::vector<std::uint32_t> ret(n);
+    ret.resize(std::size_t(detail::probe<true>(list, detail::in_range_end<N>(list, n), bs, ret.data()) - ret.data()));
+    return ret;
+}
+/// Returns the positions of the sorted list that are not set in bs, in order. O(n).
+template <std::size_t N, typename T>
+std::vector<std::uint32_t> difference(const std::uint32_t *list, std::size_t n, const compact_bitset<N, T> &bs) {
+    std::vector<std::uint32_t> ret(n);
+    const std::uint32_t *rangeEnd = detail::in_range_end<N>(list, n);
+    std::uint32_t *out = detail::probe<false>(list, rangeEnd, bs, ret.data());
+    out = std::copy(rangeEnd, list + n, out); // positions >= N can't be in bs
+    ret.resize(std::size_t(out - ret.data()));
+    return ret;
+}
+/// Returns the number of positions of the sorted list that are set in bs. O(n).
+template <std::size_t N, typename T>
+std::size_t intersect_count(const std::uint32_t *list, std::size_t n, const compact_bitset<N, T> &bs) {
+    constexpr std::size_t TBits = compact_bitset<N, T>::word_bits;
+    std::size_t ret = 0;
+    for (const std::uint32_t *p = list, *e = detail::in_range_end<N>(list, n); p < e; ++p)
+        ret += bs.word(*p / TBits) >> (*p % TBits) & 0x1;
+    return ret;
+}
+
+/// Returns the intersection as a bitset: O(n) plus the cost of zeroing the result.
+template <std::size_t N, typename T>
+compact_bitset<N, T> intersect_bitset(const std::uint32_t *list, std::size_t n, const compact_bitset<N, T> &bs) {
+    constexpr std::size_t TBits = compact_bitset<N, T>::word_bits;
+    compact_bitset<N, T> ret;
+    for (const std::uint32_t *p = list, *e = detail::in_range_end<N>(list, n); p < e; ++p)
+        if (bs.word(*p / TBits) >> (*p % TBits) & 0x1) ret[*p] = true;
+    return ret;
+}
+/// Sets the bits of bs at every position in the list (bs |= list). O(n).
+/// @throws std::out_of_range if a position is >= N
+template <std::size_t N, typename T>
+compact_bitset<N, T> & set_all(compact_bitset<N, T> &bs, const std::uint32_t *list, std::size_t n) {
+    detail::throw_if_out_of_range<N>(list, n);
+    for (std::size_t i = 0; i < n; ++i) bs[list[i]] = true;
+    return bs;
+}
+/// Clears the bits of bs at every position in the list (bs -= list). O(n). Positions >= N are ignored.
+template <std::size_t N, typename T>
+compact_bitset<N, T> & reset_all(compact_bitset<N, T> &bs, const std::uint32_t *list, std::size_t n) noexcept {
+    for (const std::uint32_t *p = list, *e = detail::in_range_end<N>(list, n); p < e; ++p) bs[*p] = false;
+    return bs;
+}
+/// Returns bs | list, as a bitset. O(n) plus the cost of copying bs.
+/// @throws std::out_of_range if a position is >= N
+template <std::size_t N, typename T>
+compact_bitset<N, T> unite(compact_bitset<N, T> bs, const std::uint32_t *list, std::size_t n) { return set_all(bs, list, n); }
+/// Returns bs - list, as a bitset. O(n) plus the cost of copying bs.
+template <std::size_t N, typename T>
+compact_bitset<N, T> subtract(compact_bitset<N, T> bs, const std::uint32_t *list, std::size_t n) noexcept { return reset_all(bs, list, n); }
+
+// -- std::vector conveniences
+template <std::size_t N, typename T>
+std::vector<std::uint32_t> intersect(const std::vector<std::uint32_t> &list, const compact_bitset<N, T> &bs) { return intersect(list.data(), list.size(), bs); }
+template <std::size_t N, typename T>
+std::vector<std::uint32_t> difference(const std::vector<std::uint32_t> &list, const compact_bitset<N, T> &bs) { return difference(list.data(), list.size(), bs); }
+template <std::size_t N, typename T>
+std::size_t intersect_count(const std::vector<std::uint32_t> &list, const compact_bitset<N, T> &bs) { return intersect_count(list.data(), list.size(), bs); }
+template <std::size_t N, typename T>
+compact_bitset<N, T> intersect_bitset(const std::vector<std::uint32_t> &list, const compact_bitset<N, T> &bs) { return intersect_bitset(list.data(), list.size(), bs); }
+template <std::size_t N, typename T>
+compact_bitset<N, T> unite(const compact_bitset<N, T> &bs, const std::vector<std::uint32_t> &list) { return unite(bs, list.data(), list.size()); }
+template <std::size_t N, typename T>
+compact_bitset<N, T> subtract(const compact_bitset<N, T> &bs, const std::vector<std::uint32_t> &list) { return subtract(bs, list.data(), list.size()); }
+
+} // namespace list_ops
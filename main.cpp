@@ -1,7 +1,51 @@
+#include "arrow_bitmap.h"
+#include "atomic_bitset.h"
+#include "bit_util.h"
+#include "bitset_format.h"
+#include "bitset_io.h"
+#if __has_include(<unistd.h>) // POSIX only
+#include "bitset_loader.h"
+#endif
+#include "bitset_text.h"
+#include "bitstream.h"
+#include "bp_tree.h"
+#include "cache_padded.h"
 #include "compact_bitset.h"
+#if __has_include(<unistd.h>) // POSIX only
+#include "disk_bitset.h"
+#endif
+#include "dynamic_bitvector.h"
+#include "elias_fano.h"
+#include "ewah_bitset.h"
+#include "fenwick_bitset.h"
+#include "hybrid_bitset.h"
+#include "list_ops.h"
+#if __has_include(<unistd.h>) // POSIX only
+#include "mmap_bitset.h"
+#endif
+#include "packed_int_vector.h"
+#include "per_core_bitset.h"
+#include "priority_scheduler.h"
+#include "rank_select.h"
+#include "rcu_bitset.h"
+#include "sharded_bitset.h"
+#include "snapshot_stream.h"
+#include "wavelet_matrix.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <queue>
+#include <random>
 #include <sstream>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
 template <std::size_t N>
 void test()
@@ -60,6 +104,1218 @@ void test()
     }
 }
 
+template <std::size_t Width>
+void test_packed_int_vector(std::size_t width = Width)
+{
+    std::cout << std::string(80, '-') << "\n";
+    std::mt19937_64 rng(width);
+    const std::uint64_t mask = width >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << width) - 1;
+    std::vector<std::uint64_t> ref(1000);
+    for (auto &v : ref) v = rng() & mask;
+    auto piv = [&] {
+        if constexpr (Width == 0) return packed_int_vector<0>(width, ref.size());
+        else return packed_int_vector<Width>(ref.size());
+    }();
+    std::cout << "packed_int_vector width: " << piv.width() << " size: " << piv.size() << " bits_size: " << piv.bits_size() << "\n";
+    for (std::size_t i = 0; i < ref.size(); ++i) piv[i] = ref[i];
+    for (std::size_t i = 0; i < ref.size(); ++i)
+        if (piv[i] != ref[i]) throw std::runtime_error("packed_int_vector get/set mismatch");
+    // bulk unpack from an unaligned position, and re-pack
+    std::vector<std::uint64_t> out(ref.size() - 3);
+    piv.unpack(3, out.size(), out.data());
+    if (!std::equal(out.begin(), out.end(), ref.begin() + 3)) throw std::runtime_error("packed_int_vector unpack mismatch");
+    auto piv2 = piv;
+    piv2.assign(piv.size(), 0);
+    piv2.pack(0, ref.size(), ref.data());
+    if (piv2 != piv) throw std::runtime_error("packed_int_vector pack mismatch");
+    // neighbours must be untouched by a write, and out-of-width bits discarded
+    piv[500] = static_cast<typename decltype(piv)::value_type>(~std::uint64_t(0));
+    if (piv[500] != piv.max_value() || piv[499] != ref[499] || piv[501] != ref[501])
+        throw std::runtime_error("packed_int_vector set clobbered a neighbour");
+    // shrinking must keep the unused bits 0
+    piv2.resize(7);
+    piv2.resize(8);
+    if (piv2[7] != 0) throw std::runtime_error("packed_int_vector resize did not clear unused bits");
+    bool threw = false;
+    try { piv.get(piv.size()); } catch (const std::out_of_range &) { threw = true; }
+    if (!threw) throw std::runtime_error("packed_int_vector get did not throw");
+}
+
+void test_rank_select()
+{
+    std::cout << std::string(80, '-') << "\n";
+    std::mt19937_64 rng(42);
+    // mix dense and very sparse regions so select has to skip over empty blocks
+    std::vector<std::uint64_t> words(300);
+    for (std::size_t i = 0; i < words.size(); ++i) words[i] = i < 100 || i > 250 ? rng() : (i == 170 ? 0x10 : 0);
+    const std::size_t nbits = words.size() * 64 - 5;
+    const rank_select_bitvector rs(words, nbits);
+    std::cout << "rank_select_bitvector size: " << rs.size() << " count: " << rs.count() << " index_size: " << rs.index_size() << "\n";
+    std::size_t ones = 0;
+    for (std::size_t i = 0; i < nbits; ++i) {
+        if (rs.rank1(i) != ones) throw std::runtime_error("rank_select_bitvector rank1 mismatch");
+        if (rs[i]) {
+            if (rs.select1(ones) != i) throw std::runtime_error("rank_select_bitvector select1 mismatch");
+            ++ones;
+        } else if (rs.select0(i - ones) != i) throw std::runtime_error("rank_select_bitvector select0 mismatch");
+    }
+    if (ones != rs.count() || rs.rank1(nbits) != ones) throw std::runtime_error("rank_select_bitvector count mismatch");
+    bool threw = false;
+    try { rs.select1(ones); } catch (const std::out_of_range &) { threw = true; }
+    if (!threw) throw std::runtime_error("rank_select_bitvector select1 did not throw");
+}
+
+void test_elias_fano()
+{
+    std::cout << std::string(80, '-') << "\n";
+    std::mt19937_64 rng(77);
+    std::vector<std::uint32_t> ids;
+    for (std::uint32_t v = 0; ids.size() < 5000; v += std::uint32_t(rng() % 300)) ids.push_back(v); // includes duplicates
+    const elias_fano ef(ids);
+    std::cout << "elias_fano size: " << ef.size() << " universe: " << ef.universe() << " low_bits: " << ef.low_bits()
+              << " bytes_used: " << ef.bytes_used() << " (raw: " << ids.size() * sizeof(ids[0]) << ")\n";
+    std::size_t i = 0;
+    for (auto v : ef)
+        if (v != ids[i++] || ef[i - 1] != v) throw std::runtime_error("elias_fano decode mismatch");
+    if (i != ids.size()) throw std::runtime_error("elias_fano iterated the wrong number of values");
+    for (std::uint64_t x = 0; x <= ef.universe(); x += 37) {
+        const auto it = ef.next_geq(x);
+        const auto ref = std::lower_bound(ids.begin(), ids.end(), x);
+        if (ref == ids.end() ? it != ef.end() : (it == ef.end() || *it != *ref || it.index() != std::size_t(ref - ids.begin())))
+            throw std::runtime_error("elias_fano next_geq mismatch");
+    }
+    bool threw = false;
+    try { elias_fano bad(std::vector<int>{3, 2}); } catch (const std::invalid_argument &) { threw = true; }
+    if (!threw) throw std::runtime_error("elias_fano accepted a decreasing sequence");
+    // round trip via a membership bitmap
+    compact_bitset<1000> bs;
+    for (std::size_t b = 0; b < bs.size(); b += 1 + b % 13) bs[b] = true;
+    const elias_fano efbs(bs);
+    if (efbs.size() != bs.count() || efbs.to_bitset<1000>() != bs) throw std::runtime_error("elias_fano bitset round trip mismatch");
+    if (elias_fano(std::vector<int>{}).begin() != elias_fano().end()) throw std::runtime_error("elias_fano empty sequence not empty");
+}
+
+void test_wavelet_matrix(unsigned nthreads)
+{
+    std::cout << std::string(80, '-') << "\n";
+    std::mt19937_64 rng(78);
+    std::vector<std::uint16_t> seq(20000);
+    for (auto &c : seq) c = std::uint16_t(rng() % 300);
+    const wavelet_matrix wm(seq, 0, nthreads);
+    std::cout << "wavelet_matrix size: " << wm.size() << " bits_per_symbol: " << wm.bits_per_symbol() << " threads: " << nthreads
+              << " bytes_used: " << wm.bytes_used() << "\n";
+    std::vector<std::size_t> counts(512);
+    for (std::size_t i = 0; i < seq.size(); ++i) {
+        const auto c = seq[i];
+        if (wm[i] != c) throw std::runtime_error("wavelet_matrix access mismatch");
+        if (wm.rank(c, i) != counts[c]) throw std::runtime_error("wavelet_matrix rank mismatch");
+        if (wm.select(c, counts[c]) != i) throw std::runtime_error("wavelet_matrix select mismatch");
+        ++counts[c];
+    }
+    if (wm.rank(301, seq.size()) != 0 || wm.rank(1 << 20, seq.size()) != 0) throw std::runtime_error("wavelet_matrix rank of absent symbol");
+    for (std::size_t l = 0; l < seq.size(); l += 1931) {
+        const std::size_t r = std::min(seq.size(), l + 777);
+        std::vector<std::uint16_t> sorted(seq.begin() + l, seq.begin() + r);
+        std::sort(sorted.begin(), sorted.end());
+        for (std::size_t k = 0; k < sorted.size(); k += 13)
+            if (wm.quantile(l, r, k) != sorted[k]) throw std::runtime_error("wavelet_matrix quantile mismatch");
+    }
+    bool threw = false;
+    try { wm.select(seq[0], counts[seq[0]]); } catch (const std::out_of_range &) { threw = true; }
+    if (!threw) throw std::runtime_error("wavelet_matrix select did not throw");
+}
+
+void test_bp_tree()
+{
+    std::cout << std::string(80, '-') << "\n";
+    std::mt19937_64 rng(79);
+    // random pointer-based tree: node i's parent is some earlier node, biased towards recent ones for depth
+    const std::size_t n = 50000;
+    std::vector<std::size_t> parent(n), depth(n), subtree(n, 1);
+    std::vector<std::vector<std::size_t>> children(n);
+    for (std::size_t i = 1; i < n; ++i) {
+        parent[i] = rng() % 4 ? i - 1 - rng() % std::min<std::size_t>(i, 3) : rng() % i;
+        depth[i] = depth[parent[i]] + 1;
+        children[parent[i]].push_back(i);
+    }
+    for (std::size_t i = n; i-- > 1; ) subtree[parent[i]] += subtree[i];
+    // serialise depth-first, recording each node's position
+    bp_tree::builder builder;
+    std::vector<bp_tree::node> pos(n);
+    std::vector<std::pair<std::size_t, std::size_t>> stack{{0, 0}};
+    std::size_t p = 0;
+    builder.open();
+    pos[0] = p++;
+    while (!stack.empty()) {
+        auto &[v, next] = stack.back();
+        if (next < children[v].size()) {
+            const std::size_t c = children[v][next++];
+            builder.open();
+            pos[c] = p++;
+            stack.emplace_back(c, 0);
+        } else {
+            builder.close();
+            ++p;
+            stack.pop_back();
+        }
+    }
+    const bp_tree tree = builder.build();
+    std::cout << "bp_tree size: " << tree.size() << " bytes_used: " << tree.bytes_used()
+              << " bits/node: " << double(tree.bytes_used() * 8) / double(tree.size()) << "\n";
+    if (tree.size() != n || tree.root() != 0) throw std::runtime_error("bp_tree size mismatch");
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto v = pos[i];
+        if (tree.parent(v) != (i ? pos[parent[i]] : bp_tree::npos)) throw std::runtime_error("bp_tree parent mismatch");
+        if (tree.first_child(v) != (children[i].empty() ? bp_tree::npos : pos[children[i].front()])) throw std::runtime_error("bp_tree first_child mismatch");
+        if (tree.depth(v) != depth[i] || tree.subtree_size(v) != subtree[i]) throw std::runtime_error("bp_tree depth/subtree_size mismatch");
+        if (i) {
+            const auto &sibs = children[parent[i]];
+            const auto it = std::find(sibs.begin(), sibs.end(), i) + 1;
+            if (tree.next_sibling(v) != (it == sibs.end() ? bp_tree::npos : pos[*it])) throw std::runtime_error("bp_tree next_sibling mismatch");
+        }
+    }
+    std::sort(pos.begin(), pos.end()); // opening positions, in preorder
+    for (std::size_t k = 0; k < n; ++k)
+        if (tree.preorder(pos[k]) != k) throw std::runtime_error("bp_tree preorder mismatch");
+    bool threw = false;
+    try { compact_bitset<4> unbalanced("1100"); unbalanced[3] = true; bp_tree bad(unbalanced); } catch (const std::invalid_argument &) { threw = true; }
+    if (!threw) throw std::runtime_error("bp_tree accepted unbalanced parentheses");
+}
+
+void test_dynamic_bitvector()
+{
+    std::cout << std::string(80, '-') << "\n";
+    std::mt19937_64 rng(80);
+    std::vector<bool> ref(3000);
+    for (std::size_t i = 0; i < ref.size(); ++i) ref[i] = rng() % 3 == 0;
+    std::vector<std::uint64_t> words((ref.size() + 63) / 64);
+    for (std::size_t i = 0; i < ref.size(); ++i) words[i / 64] |= std::uint64_t(ref[i]) << (i % 64);
+    dynamic_bitvector dbv(words, ref.size());
+    const auto verify = [&] {
+        if (dbv.size() != ref.size()) throw std::runtime_error("dynamic_bitvector size mismatch");
+        std::size_t ones = 0;
+        for (std::size_t i = 0; i < ref.size(); ++i) {
+            if (dbv[i] != ref[i] || dbv.rank1(i) != ones) throw std::runtime_error("dynamic_bitvector access/rank mismatch");
+            if (ref[i] ? dbv.select1(ones) != i : dbv.select0(i - ones) != i) throw std::runtime_error("dynamic_bitvector select mismatch");
+            ones += ref[i];
+        }
+        if (dbv.count() != ones || dbv.rank1(ref.size()) != ones) throw std::runtime_error("dynamic_bitvector count mismatch");
+    };
+    verify();
+    // grow well past a single leaf, then shrink back down, so nodes split, merge and borrow
+    for (int round = 0; round < 2; ++round) {
+        for (int op = 0; op < 20000; ++op) {
+            const bool grow = round == 0 ? rng() % 4 != 0 : rng() % 4 == 0;
+            const std::size_t pos = ref.empty() ? 0 : rng() % (ref.size() + grow);
+            if (grow || ref.empty()) {
+                const bool b = rng() & 0x1;
+                dbv.insert(pos, b);
+                ref.insert(ref.begin() + std::ptrdiff_t(pos), b);
+            } else if (rng() % 3) {
+                dbv.erase(pos);
+                ref.erase(ref.begin() + std::ptrdiff_t(pos));
+            } else {
+                dbv.flip(pos);
+                ref[pos] = !ref[pos];
+            }
+        }
+        verify();
+        std::cout << "dynamic_bitvector size: " << dbv.size() << " count: " << dbv.count() << "\n";
+    }
+    const dynamic_bitvector copy = dbv;
+    words = copy.to_words();
+    for (std::size_t i = 0; i < ref.size(); ++i)
+        if (bool(words[i / 64] >> (i % 64) & 0x1) != ref[i]) throw std::runtime_error("dynamic_bitvector to_words mismatch");
+    compact_bitset<100> bs(123455);
+    if (dynamic_bitvector(bs).count() != bs.count()) throw std::runtime_error("dynamic_bitvector from compact_bitset mismatch");
+    bool threw = false;
+    try { dbv.insert(dbv.size() + 1, true); } catch (const std::out_of_range &) { threw = true; }
+    if (!threw) throw std::runtime_error("dynamic_bitvector insert did not throw");
+    // a moved-from bit vector is empty and usable
+    dynamic_bitvector moved(std::move(dbv));
+    if (moved.size() != ref.size() || !dbv.empty() || dbv.count()) throw std::runtime_error("dynamic_bitvector move mismatch");
+    dbv.push_back(true);
+    dynamic_bitvector assigned;
+    assigned = std::move(moved);
+    moved.push_back(false);
+    moved.push_back(true);
+    if (dbv.size() != 1 || !dbv.test(0) || moved.size() != 2 || moved.count() != 1 || assigned.size() != ref.size()
+            || dynamic_bitvector(moved).select1(0) != 1)
+        throw std::runtime_error("dynamic_bitvector use after move mismatch");
+}
+
+template <std::size_t N>
+void test_fenwick_bitset()
+{
+    std::cout << std::string(80, '-') << "\n";
+    std::mt19937_64 rng(N);
+    compact_bitset<N> ref;
+    fenwick_bitset<N> fb;
+    for (int op = 0; op < 3000; ++op) {
+        const std::size_t pos = rng() % N;
+        switch (rng() % 3) {
+        case 0: fb.set(pos); ref.set(pos); break;
+        case 1: fb.reset(pos); ref.reset(pos); break;
+        default: fb.flip(pos); ref.flip(pos); break;
+        }
+    }
+    std::cout << "fenwick_bitset N: " << N << " sizeof: " << sizeof(fb) << " count: " << fb.count() << "\n";
+    if (fb.bitset() != ref || fb.count() != ref.count()) throw std::runtime_error("fenwick_bitset contents mismatch");
+    std::size_t ones = 0;
+    for (std::size_t i = 0; i < N; ++i) {
+        if (fb.rank1(i) != ones) throw std::runtime_error("fenwick_bitset rank1 mismatch");
+        if (ref[i] ? fb.select1(ones) != i : fb.select0(i - ones) != i) throw std::runtime_error("fenwick_bitset select mismatch");
+        ones += ref[i];
+    }
+    if (fb.rank1(N) != ones) throw std::runtime_error("fenwick_bitset rank1(N) mismatch");
+    fb.flip();
+    if (fb.count() != N - ones || fenwick_bitset<N>(~ref) != fb) throw std::runtime_error("fenwick_bitset flip mismatch");
+}
+
+void test_ewah_bitset()
+{
+    std::cout << std::string(80, '-') << "\n";
+    std::mt19937_64 rng(82);
+    // run-heavy masks: long stretches of 0s or 1s, with some noisy words in between
+    const auto make = [&rng](std::size_t nbits) {
+        std::vector<std::uint64_t> words((nbits + 63) / 64);
+        for (std::size_t i = 0; i < words.size(); ) {
+            const std::size_t len = std::min<std::size_t>(words.size() - i, 1 + rng() % 200);
+            const int kind = int(rng() % 3);
+            for (std::size_t j = 0; j < len; ++j, ++i) words[i] = kind == 0 ? 0 : kind == 1 ? ~std::uint64_t(0) : rng();
+        }
+        if (nbits % 64) words.back() &= (std::uint64_t(1) << (nbits % 64)) - 1;
+        return words;
+    };
+    const std::size_t na = 100000 - 7, nb = 80000 + 5;
+    const auto wa = make(na), wb = make(nb);
+    const ewah_bitset a(wa, na), b(wb, nb);
+    std::cout << "ewah_bitset size: " << a.size() << " count: " << a.count() << " bits_size: " << a.bits_size()
+              << " (raw: " << wa.size() * 8 << ")\n";
+    if (a.to_words() != wa || b.to_words() != wb) throw std::runtime_error("ewah_bitset round trip mismatch");
+    const auto check_op = [&](const ewah_bitset &res, auto op, const char *name) {
+        if (res.size() != na) throw std::runtime_error(std::string("ewah_bitset size mismatch for ") + name);
+        const auto rw = res.to_words();
+        for (std::size_t i = 0; i < wa.size(); ++i)
+            if (rw[i] != op(wa[i], i < wb.size() ? wb[i] : 0)) throw std::runtime_error(std::string("ewah_bitset mismatch for ") + name);
+    };
+    check_op(a & b, [](auto x, auto y) { return x & y; }, "&");
+    check_op(b | a, [](auto x, auto y) { return x | y; }, "|");
+    check_op(a ^ b, [](auto x, auto y) { return x ^ y; }, "^");
+    if ((a ^ a).any() || (a & a) != a) throw std::runtime_error("ewah_bitset self-op mismatch");
+    // set-bit iteration, count and test agree with the raw words
+    std::size_t n = 0;
+    for (const auto pos : a) {
+        if (!(wa[pos / 64] >> (pos % 64) & 0x1) || !a.test(pos)) throw std::runtime_error("ewah_bitset iterated an unset bit");
+        ++n;
+    }
+    if (n != a.count()) throw std::runtime_error("ewah_bitset iteration count mismatch");
+    // incremental construction, and compact_bitset round trip
+    compact_bitset<1000> bs;
+    ewah_bitset inc;
+    for (std::size_t pos = 3; pos < bs.size(); pos += 1 + pos % 97) { bs[pos] = true; inc.set(pos); }
+    inc.set_size_in_bits(bs.size());
+    if (inc != ewah_bitset(bs) || inc.to_bitset<1000>() != bs) throw std::runtime_error("ewah_bitset compact_bitset round trip mismatch");
+    bool threw = false;
+    try { inc.set(3); } catch (const std::invalid_argument &) { threw = true; }
+    if (!threw) throw std::runtime_error("ewah_bitset accepted an out-of-order set");
+}
+
+void test_hybrid_bitset()
+{
+    std::cout << std::string(80, '-') << "\n";
+    constexpr std::size_t N = 20000;
+    using HB = hybrid_bitset<N>;
+    std::mt19937_64 rng(83);
+    const auto verify = [](const HB &hb, const compact_bitset<N> &ref, const char *what) {
+        if (hb.count() != ref.count() || hb.to_bitset() != ref) throw std::runtime_error(std::string("hybrid_bitset mismatch: ") + what);
+        std::size_t n = 0;
+        for (const auto pos : hb) {
+            if (!ref[pos]) throw std::runtime_error(std::string("hybrid_bitset iterated an unset bit: ") + what);
+            ++n;
+        }
+        if (n != ref.count()) throw std::runtime_error(std::string("hybrid_bitset iteration count mismatch: ") + what);
+    };
+    // grow past the dense threshold, then shrink back below the sparse one
+    HB hb;
+    compact_bitset<N> ref;
+    bool wasDense = false;
+    for (int i = 0; i < 2000; ++i) {
+        const std::size_t pos = rng() % N;
+        hb.set(pos);
+        ref.set(pos);
+        wasDense = wasDense || hb.is_dense();
+    }
+    verify(hb, ref, "grow");
+    std::cout << "hybrid_bitset N: " << N << " count: " << hb.count() << " dense: " << hb.is_dense() << " bytes_used: " << hb.bytes_used() << "\n";
+    if (!wasDense || !hb.is_dense()) throw std::runtime_error("hybrid_bitset did not become dense");
+    for (std::size_t pos = 0; pos < N && hb.is_dense(); ++pos) { hb.reset(pos); ref.reset(pos); }
+    verify(hb, ref, "shrink");
+    if (hb.is_dense()) throw std::runtime_error("hybrid_bitset did not become sparse");
+    // binary ops across every combination of representations
+    HB sparse1, sparse2;
+    compact_bitset<N> rs1, rs2;
+    for (int i = 0; i < 50; ++i) {
+        const std::size_t p1 = rng() % N, p2 = rng() % N;
+        sparse1.set(p1); rs1.set(p1);
+        sparse2.set(p2); rs2.set(p2);
+    }
+    compact_bitset<N> rd1, rd2;
+    for (std::size_t pos = 0; pos < N; ++pos) { rd1[pos] = rng() % 2; rd2[pos] = rng() % 3 == 0; }
+    rd1[*sparse1.begin()] = true; // make sure the sparse/dense intersection isn't empty
+    const HB dense1(rd1), dense2(rd2);
+    if (!dense1.is_dense() || sparse1.is_dense()) throw std::runtime_error("hybrid_bitset unexpected representation");
+    const std::vector<std::pair<const HB *, const compact_bitset<N> *>> operands{{&sparse1, &rs1}, {&sparse2, &rs2}, {&dense1, &rd1}, {&dense2, &rd2}};
+    for (const auto &[a, ra] : operands)
+        for (const auto &[b, rb] : operands) {
+            verify(*a & *b, *ra & *rb, "&");
+            verify(*a | *b, *ra | *rb, "|");
+            verify(*a ^ *b, *ra ^ *rb, "^");
+            if ((*a == *b) != (*ra == *rb)) throw std::runtime_error("hybrid_bitset == mismatch");
+        }
+    if (!(sparse1 & dense1).any() || (sparse1 & dense1).is_dense()) throw std::runtime_error("hybrid_bitset sparse & dense should be sparse");
+}
+
+template <std::size_t N, typename T = typename compact_bitset<N>::word_type>
+void test_list_ops()
+{
+    std::cout << std::string(80, '-') << "\n";
+    std::mt19937_64 rng(N);
+    compact_bitset<N, T> bs;
+    for (std::size_t i = 0; i < N; ++i) bs[i] = rng() % 3 == 0;
+    std::vector<std::uint32_t> list;
+    for (std::uint32_t v = std::uint32_t(rng() % 5); v < N + 100; v += 1 + std::uint32_t(rng() % 7)) list.push_back(v); // some are >= N
+    std::vector<std::uint32_t> refIn, refOut;
+    compact_bitset<N, T> refUnion = bs, refSub = bs, refInBs;
+    for (const auto v : list) {
+        if (v < N && bs[v]) { refIn.push_back(v); refInBs[v] = true; }
+        else refOut.push_back(v);
+        if (v < N) { refUnion[v] = true; refSub[v] = false; }
+    }
+    std::cout << "list_ops N: " << N << " list: " << list.size() << " intersection: " << refIn.size() << "\n";
+    if (list_ops::intersect(list, bs) != refIn || list_ops::intersect_count(list, bs) != refIn.size()) throw std::runtime_error("list_ops intersect mismatch");
+    if (list_ops::difference(list, bs) != refOut) throw std::runtime_error("list_ops difference mismatch");
+    if (list_ops::intersect_bitset(list, bs) != refInBs) throw std::runtime_error("list_ops intersect_bitset mismatch");
+    if (list_ops::subtract(bs, list) != refSub) throw std::runtime_error("list_ops subtract mismatch");
+    bool threw = false;
+    try { list_ops::unite(bs, list); } catch (const std::out_of_range &) { threw = true; }
+    if (!threw) throw std::runtime_error("list_ops unite accepted an out-of-range position");
+    list.erase(std::lower_bound(list.begin(), list.end(), std::uint32_t(N)), list.end());
+    if (list_ops::unite(bs, list) != refUnion) throw std::runtime_error("list_ops unite mismatch");
+}
+
+void test_bitstream()
+{
+    std::cout << std::string(80, '-') << "\n";
+    std::mt19937_64 rng(85);
+    std::vector<std::uint64_t> vals(3000);
+    for (auto &v : vals) v = (rng() >> (rng() % 64)) | 1; // nonzero, geometric-ish magnitudes
+    const auto write_all = [&](auto &w) {
+        for (std::size_t i = 0; i < vals.size(); ++i) {
+            const auto v = vals[i];
+            switch (i % 6) {
+            case 0: w.write(v, unsigned(i % 65)); break;
+            case 1: w.write_unary(v % 150); break;
+            case 2: w.write_gamma(v); break;
+            case 3: w.write_delta(v); break;
+            case 4: w.write_rice(v % 100000, 7); break;
+            default: w.write_varint(v); break;
+            }
+        }
+    };
+    const auto read_all = [&](auto &r) {
+        for (std::size_t i = 0; i < vals.size(); ++i) {
+            const auto v = vals[i];
+            bool ok = false;
+            switch (i % 6) {
+            case 0: ok = r.read(unsigned(i % 65)) == (v & bit_util::low_mask(unsigned(i % 65))); break;
+            case 1: ok = r.read_unary() == v % 150; break;
+            case 2: ok = r.read_gamma() == v; break;
+            case 3: ok = r.read_delta() == v; break;
+            case 4: ok = r.read_rice(7) == v % 100000; break;
+            default: ok = r.read_varint() == v; break;
+            }
+            if (!ok) throw std::runtime_error("bitstream decode mismatch");
+        }
+    };
+    bit_writer<> w;
+    write_all(w);
+    const std::size_t nbits = w.size();
+    std::cout << "bitstream values: " << vals.size() << " bits: " << nbits << "\n";
+    const auto words = w.release();
+    auto r = make_bit_reader(words, nbits);
+    read_all(r);
+    if (!r.at_end()) throw std::runtime_error("bitstream reader not at end");
+    bool threw = false;
+    try { r.read_bit(); } catch (const std::out_of_range &) { threw = true; }
+    if (!threw) throw std::runtime_error("bitstream read past end did not throw");
+    // hand off to a rank_select_bitvector without copying
+    bit_writer<> w2;
+    for (int i = 0; i < 100; ++i) w2.write_gamma(std::uint64_t(i + 1));
+    const auto rs = w2.release_bitvector();
+    bit_reader<> r2(rs.size(), reinterpret_cast<const std::uint64_t *>(rs.bits()));
+    for (int i = 0; i < 100; ++i)
+        if (r2.read_gamma() != std::uint64_t(i + 1)) throw std::runtime_error("bitstream bitvector hand-off mismatch");
+    // write in place into a compact_bitset with small words, and read it back from there
+    compact_bitset<400000, std::uint16_t> bs;
+    auto bw = make_bit_writer(bs);
+    write_all(bw);
+    bw.flush();
+    auto br = make_bit_reader(bs);
+    read_all(br);
+    compact_bitset<10> tiny;
+    auto tw = make_bit_writer(tiny);
+    threw = false;
+    try { tw.write(0x3FF, 10).write_bit(true); } catch (const std::out_of_range &) { threw = true; }
+    if (!threw || tw.flush().get_sink().get().count() != 10) throw std::runtime_error("bitstream bitset capacity not enforced");
+}
+
+template <std::size_t N, typename T = typename compact_bitset<N>::word_type>
+void test_snapshot_stream()
+{
+    std::cout << std::string(80, '-') << "\n";
+    std::mt19937_64 rng(N);
+    // mostly-stable telemetry: a few bits flip per snapshot, occasionally a burst of changes, sometimes nothing
+    std::vector<compact_bitset<N, T>> snaps(3000);
+    compact_bitset<N, T> cur;
+    for (auto &snap : snaps) {
+        const int kind = int(rng() % 20);
+        const std::size_t nflips = kind == 0 ? N / 4 : kind < 8 ? 0 : 1 + rng() % 3;
+        for (std::size_t i = 0; i < nflips; ++i) cur.flip(rng() % N);
+        snap = cur;
+    }
+    snapshot_encoder<N, T> enc(100);
+    for (const auto &snap : snaps) enc.append(snap);
+    const auto ss = enc.finish();
+    std::cout << "snapshot_stream N: " << N << " snapshots: " << ss.size() << " bytes_used: " << ss.bytes_used()
+              << " (raw: " << snaps.size() * snaps[0].bits_size() << ")\n";
+    auto c = ss.begin_decode();
+    for (const auto &snap : snaps)
+        if (c.next_snapshot() != snap) throw std::runtime_error("snapshot_stream sequential decode mismatch");
+    if (c.has_next()) throw std::runtime_error("snapshot_stream cursor has too many snapshots");
+    for (std::size_t i = 0; i < snaps.size(); i += 1 + rng() % 50)
+        if (ss[i] != snaps[i]) throw std::runtime_error("snapshot_stream random access mismatch");
+    std::stringstream buf;
+    ss.save(buf);
+    const auto loaded = snapshot_stream<N, T>::load(buf);
+    if (loaded.size() != ss.size() || loaded[snaps.size() - 1] != snaps.back()) throw std::runtime_error("snapshot_stream save/load mismatch");
+    bool threw = false;
+    try { std::stringstream bad("garbage"); snapshot_stream<N, T>::load(bad); } catch (const std::invalid_argument &) { threw = true; }
+    if (!threw) throw std::runtime_error("snapshot_stream loaded garbage");
+}
+
+template <std::size_t N, typename T = std::uint64_t>
+void test_bitset_io()
+{
+    std::cout << std::string(80, '-') << "\n";
+    std::mt19937_64 rng(N);
+    // a mix of blocks: empty, sparse, long runs and random noise, so that every block encoding gets used
+    auto bs = std::make_unique<compact_bitset<N, T>>();
+    for (std::size_t i = 0; i < N; ++i) {
+        const std::size_t block = i / 65536;
+        const bool bit = block % 4 == 1 ? rng() % 1000 == 0 : block % 4 == 2 ? (i / 5000) % 2 : block % 4 == 3 && rng() % 2;
+        bs->set(i, bit);
+    }
+    std::stringstream raw, packed;
+    bitset_io::write(raw, *bs, bitset_io::encoding::raw);
+    bitset_io::write(packed, *bs);
+    std::cout << "bitset_io N: " << N << " raw bytes: " << raw.str().size() << " compressed bytes: " << packed.str().size() << "\n";
+    for (auto *buf : {&raw, &packed}) {
+        auto back = std::make_unique<compact_bitset<N, T>>();
+        bitset_io::read(*buf, *back);
+        if (*back != *bs) throw std::runtime_error("bitset_io round trip mismatch");
+    }
+    // word arrays of a size only known at runtime
+    const std::size_t nbits = N - 7;
+    std::vector<std::uint64_t> words((nbits + 63) / 64);
+    for (std::size_t i = 0; i < nbits; ++i) if (bs->test(i)) words[i / 64] |= std::uint64_t(1) << (i % 64);
+    std::stringstream buf;
+    bitset_io::write(buf, words.data(), nbits);
+    std::size_t nread = 0;
+    if (bitset_io::read_words(buf, nread) != words || nread != nbits) throw std::runtime_error("bitset_io word array round trip mismatch");
+    // garbage in the last word past nbits is not part of the bitset: it must not be written (nor break decoding).
+    // One stray bit makes the (otherwise empty) last block sparse, all of them a run.
+    for (const std::uint64_t garbage : {std::uint64_t(1) << 63, ~bit_util::low_mask(unsigned(nbits % 64))}) {
+        auto dirty = words;
+        dirty.back() |= garbage;
+        for (const auto enc : {bitset_io::encoding::raw, bitset_io::encoding::compressed}) {
+            std::stringstream dbuf;
+            bitset_io::write(dbuf, dirty.data(), nbits, enc);
+            if (bitset_io::read_words(dbuf, nread) != words || nread != nbits) throw std::runtime_error("bitset_io wrote bits past nbits");
+        }
+    }
+    // truncated or mismatched input must throw
+    for (const auto &bad : {packed.str().substr(0, packed.str().size() / 2), std::string("garbage garbage")}) {
+        bool threw = false;
+        try { std::stringstream is(bad); bitset_io::read(is, *bs); } catch (const std::invalid_argument &) { threw = true; }
+        if (!threw) throw std::runtime_error("bitset_io read bad data");
+    }
+    bool threw = false;
+    try { compact_bitset<N + 1, T> other; packed.seekg(0); bitset_io::read(packed, other); } catch (const std::invalid_argument &) { threw = true; }
+    if (!threw) throw std::runtime_error("bitset_io read data of the wrong size");
+}
+
+#if __has_include(<unistd.h>) // POSIX only
+void test_disk_bitset(bool direct)
+{
+    std::cout << std::string(80, '-') << "\n";
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / ("compact_bitset_test_" + std::to_string(::getpid()));
+    fs::create_directories(dir);
+    struct cleanup { fs::path p; ~cleanup() { std::error_code ec; fs::remove_all(p, ec); } } c{dir};
+    std::mt19937_64 rng(88);
+    // several blocks plus a partial one
+    disk_bitset::options opts;
+    opts.block_words = 512;
+    opts.direct = direct;
+    constexpr std::size_t nwords = 512 * 7 + 101;
+    std::vector<std::vector<std::uint64_t>> mem(3, std::vector<std::uint64_t>(nwords));
+    std::vector<std::string> paths;
+    try {
+        for (std::size_t f = 0; f < mem.size(); ++f) {
+            paths.push_back((dir / ("in" + std::to_string(f))).string());
+            disk_bitset::file_writer w(paths.back(), opts);
+            for (std::size_t i = 0; i < nwords; ) {
+                const std::size_t n = std::min<std::size_t>(nwords - i, 1 + rng() % 700);
+                for (std::size_t j = i; j < i + n; ++j) mem[f][j] = rng() & rng();
+                w.append(mem[f].data() + i, n);
+                i += n;
+            }
+            w.close();
+        }
+    } catch (const std::system_error &e) {
+        if (!direct) throw;
+        std::cout << "disk_bitset O_DIRECT unsupported here (" << e.what() << "), skipping\n";
+        return;
+    }
+    std::uint64_t expCount = 0, expAnd = 0, expOr = 0, expXor = 0;
+    for (std::size_t i = 0; i < nwords; ++i) {
+        expCount += unsigned(bit_util::popcount(mem[0][i]));
+        expAnd += unsigned(bit_util::popcount(mem[0][i] & mem[1][i] & mem[2][i]));
+        expOr += unsigned(bit_util::popcount(mem[0][i] | mem[1][i] | mem[2][i]));
+        expXor += unsigned(bit_util::popcount(mem[0][i] ^ mem[1][i]));
+    }
+    const auto count = disk_bitset::count(paths[0], opts), countAnd = disk_bitset::count_and(paths, opts);
+    std::cout << "disk_bitset direct: " << direct << " words: " << nwords << " count: " << count << " count_and: " << countAnd << "\n";
+    if (count != expCount || countAnd != expAnd || disk_bitset::count_or(paths, opts) != expOr)
+        throw std::runtime_error("disk_bitset count mismatch");
+    const std::string out = (dir / "out").string();
+    if (disk_bitset::write_xor({paths[0], paths[1]}, out, opts) != expXor) throw std::runtime_error("disk_bitset write_xor count mismatch");
+    disk_bitset::file_reader r(out);
+    std::vector<std::uint64_t> back(nwords);
+    if (r.num_words() != nwords || r.read(0, back.data(), nwords) != nwords) throw std::runtime_error("disk_bitset output size mismatch");
+    for (std::size_t i = 0; i < nwords; ++i)
+        if (back[i] != (mem[0][i] ^ mem[1][i])) throw std::runtime_error("disk_bitset write_xor mismatch");
+    // a compact_bitset round trip, and inputs of different sizes
+    compact_bitset<100, std::uint8_t> bs;
+    for (std::size_t i = 0; i < bs.size(); i += 3) bs.set(i);
+    {
+        disk_bitset::file_writer w(out);
+        w.append(bs);
+    }
+    if (disk_bitset::count(out) != bs.count()) throw std::runtime_error("disk_bitset compact_bitset append mismatch");
+    bool threw = false;
+    try { disk_bitset::count_and({paths[0], out}); } catch (const std::invalid_argument &) { threw = true; }
+    if (!threw) throw std::runtime_error("disk_bitset accepted files of different sizes");
+}
+#endif
+
+#if __has_include(<unistd.h>) // POSIX only
+void test_mmap_bitset()
+{
+    std::cout << std::string(80, '-') << "\n";
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / ("compact_bitset_test_" + std::to_string(::getpid()));
+    fs::create_directories(dir);
+    struct cleanup { fs::path p; ~cleanup() { std::error_code ec; fs::remove_all(p, ec); } } c{dir};
+    const std::string path = (dir / "mapped").string();
+    constexpr std::size_t N = 100003;
+    std::mt19937_64 rng(89);
+    compact_bitset<N> ref;
+    {
+        mmap_bitset::options opts;
+        opts.huge_pages = true;
+        mmap_bitset mb(path, N, opts);
+        if (mb.size() != N || mb.any()) throw std::runtime_error("mmap_bitset new file not empty");
+        for (int i = 0; i < 50; ++i) {
+            const std::size_t pos = rng() % 30000; // only touch the first few pages
+            ref.flip(pos);
+            mb.flip(pos);
+        }
+        const std::size_t dirty = mb.dirty_pages();
+        mb.sync();
+        std::cout << "mmap_bitset N: " << N << " count: " << mb.count() << " dirty pages before sync: " << dirty
+                  << " after: " << mb.dirty_pages() << "\n";
+        if (dirty == 0 || dirty > 30000 / 8 / 4096 + 1 || mb.dirty_pages()) throw std::runtime_error("mmap_bitset dirty tracking mismatch");
+        bool threw = false;
+        try { mb.set(N); } catch (const std::out_of_range &) { threw = true; }
+        if (!threw) throw std::runtime_error("mmap_bitset out of range set didn't throw");
+    }
+    // reopen: the contents persisted, and the file is a valid disk_bitset file too
+    mmap_bitset mb(path);
+    if (mb.size() != (N + 63) / 64 * 64 || disk_bitset::count(path) != ref.count()) throw std::runtime_error("mmap_bitset reopen size mismatch");
+    mb.resize(N);
+    if (mb.to_bitset<N>() != ref) throw std::runtime_error("mmap_bitset reopen contents mismatch");
+    // grow then shrink: new bits are 0, bits cut off are gone
+    mb.resize(3 * N);
+    if (mb.count() != ref.count() || mb.test(2 * N)) throw std::runtime_error("mmap_bitset grow mismatch");
+    mb.set(3 * N - 1).set(N + 5);
+    mb.resize(N + 5);
+    if (mb.count() != ref.count()) throw std::runtime_error("mmap_bitset shrink mismatch");
+    mb.resize(N + 6);
+    if (mb.test(N + 5)) throw std::runtime_error("mmap_bitset shrink left stray bits");
+}
+#endif
+
+template <std::size_t N, typename T>
+void test_arrow_bitmap()
+{
+    std::cout << std::string(80, '-') << "\n";
+    std::mt19937_64 rng(N);
+    compact_bitset<N, T> bs, bs2;
+    for (std::size_t i = 0; i < N; ++i) bs.set(i, rng() % 3 == 0), bs2.set(i, rng() % 2);
+    // zero-copy views of compact_bitsets
+    const arrow_bitmap_view v(bs);
+    for (std::size_t i = 0; i < N; ++i)
+        if (v[i] != bs[i]) throw std::runtime_error("arrow_bitmap_view of compact_bitset mismatch");
+    if (arrow_ops::count(v) != bs.count() || arrow_ops::count_and(v, bs2) != (bs & bs2).count())
+        throw std::runtime_error("arrow_ops count mismatch");
+    // kernels on unrelated offsets into raw byte buffers, checked against bit-at-a-time reference results
+    std::vector<std::uint8_t> bufA(N / 8 + 16), bufB(N / 8 + 16), bufOut(N / 8 + 16);
+    for (auto *buf : {&bufA, &bufB, &bufOut}) for (auto &b : *buf) b = std::uint8_t(rng());
+    std::size_t checked = 0;
+    for (int iter = 0; iter < 20; ++iter) {
+        const std::size_t n = rng() % (N - 64), oa = rng() % 64, ob = rng() % 64, oo = rng() % 64;
+        const arrow_bitmap_view a(bufA.data(), oa, n), b(bufB.data(), ob, n);
+        arrow_bitmap_mut_view out(bufOut.data(), oo, n);
+        const auto before = bufOut;
+        const int op = iter % 3;
+        if (op == 0) arrow_ops::bitmap_and(a, b, out);
+        else if (op == 1) arrow_ops::bitmap_or(a, b, out);
+        else arrow_ops::bitmap_and_not(a, b, out);
+        std::size_t expCount = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            const bool e = op == 0 ? a[i] && b[i] : op == 1 ? a[i] || b[i] : a[i] && !b[i];
+            if (out[i] != e) throw std::runtime_error("arrow_ops kernel mismatch");
+            expCount += e;
+        }
+        for (std::size_t i = 0; i < bufOut.size() * 8; ++i) // bits outside the output view are untouched
+            if ((i < oo || i >= oo + n) && ((bufOut[i / 8] ^ before[i / 8]) >> (i % 8) & 1))
+                throw std::runtime_error("arrow_ops kernel wrote outside its output");
+        if (arrow_ops::count(out) != expCount) throw std::runtime_error("arrow_ops count with offset mismatch");
+        if (op == 0 && arrow_ops::count_and(a, b) != expCount) throw std::runtime_error("arrow_ops count_and with offset mismatch");
+        checked += n;
+    }
+    // owned, aligned bitmaps; writing into a compact_bitset through a mutable view; back to compact_bitset
+    arrow_bitmap owned(arrow_bitmap_view(bufA.data(), 5, N));
+    if (reinterpret_cast<std::uintptr_t>(owned.data()) % 64 || owned.byte_size() % 64 || !arrow_ops::equal(owned, arrow_bitmap_view(bufA.data(), 5, N)))
+        throw std::runtime_error("arrow_bitmap copy mismatch");
+    compact_bitset<N, T> dst;
+    arrow_ops::copy(arrow_bitmap_view(bufA.data(), 5, N), dst);
+    if (dst != arrow_ops::to_bitset<N, T>(owned) || dst.count() != arrow_ops::count(owned)) throw std::runtime_error("arrow_bitmap to compact_bitset mismatch");
+    std::cout << "arrow_bitmap N: " << N << " word bits: " << sizeof(T) * 8 << " count: " << arrow_ops::count(v)
+              << " offset-kernel bits checked: " << checked << "\n";
+}
+
+template <std::size_t N, typename T = typename compact_bitset<N>::word_type>
+void test_bitset_text()
+{
+    std::cout << std::string(80, '-') << "\n";
+    std::mt19937_64 rng(N);
+    compact_bitset<N, T> bs;
+    for (std::size_t i = 0; i < N; ++i) bs.set(i, rng() % 2);
+    // reference encodings, straight from to_string(): pad with '0's, then read 4 or 8 chars at a time, MSB first
+    std::string bin = bs.to_string();
+    std::string expHex, expB64;
+    for (std::size_t i = 0; i < N; i += 4) expHex += "0123456789abcdef"[std::stoi((bin + "000").substr(i, 4), nullptr, 2)];
+    std::vector<unsigned> bytes;
+    for (std::size_t i = 0; i < N; i += 8) bytes.push_back(unsigned(std::stoi((bin + "0000000").substr(i, 8), nullptr, 2)));
+    for (std::size_t i = 0; i < bytes.size(); i += 3) {
+        const unsigned v = bytes[i] << 16 | (i + 1 < bytes.size() ? bytes[i + 1] << 8 : 0) | (i + 2 < bytes.size() ? bytes[i + 2] : 0);
+        for (std::size_t k = 0; k < 4; ++k)
+            expB64 += k <= bytes.size() - i ? bitset_text_detail::Base64Chars[v >> (18 - 6 * k) & 63] : '=';
+    }
+    const std::string hex = to_hex(bs), b64 = to_base64(bs);
+    std::cout << "bitset_text N: " << N << " hex: " << hex.substr(0, 40) << (hex.size() > 40 ? "..." : "")
+              << " base64: " << b64.substr(0, 40) << (b64.size() > 40 ? "..." : "") << "\n";
+    if (hex != expHex || b64 != expB64 || to_hex(bs, true) != [&] { auto u = expHex; for (auto &c : u) c = char(std::toupper(c)); return u; }())
+        throw std::runtime_error("bitset_text encoding mismatch");
+    compact_bitset<N, T> back;
+    if (from_hex(hex, back) != std::errc{} || back != bs) throw std::runtime_error("bitset_text from_hex mismatch");
+    back.reset();
+    if (from_base64(b64, back) != std::errc{} || back != bs) throw std::runtime_error("bitset_text from_base64 mismatch");
+    // from_chars style: stops at the first non-digit; a short string leaves the high bits 0
+    const std::size_t half = (hex.size() + 1) / 2;
+    const std::string shortHex = hex.substr(0, half) + ",rest";
+    const auto r = from_hex(shortHex.data(), shortHex.data() + shortHex.size(), back);
+    if (r.ec != std::errc{} || *r.ptr != ',' || to_hex(back).substr(0, half) != hex.substr(0, half)
+        || back.count() > bs.count())
+        throw std::runtime_error("bitset_text from_hex prefix mismatch");
+    // errors leave the bitset alone
+    back = bs;
+    const std::string tooLong = hex + "1", badB64 = b64.substr(0, b64.size() - 1) + "!";
+    if (from_hex(tooLong, back) != std::errc::result_out_of_range || from_hex(hex + "x", back) != std::errc::invalid_argument
+        || from_hex(std::string_view("g"), back) != std::errc::invalid_argument
+        || from_base64(badB64, back) != std::errc::invalid_argument || from_base64(std::string(base64_size(N) + 4, 'A'), back) != std::errc::result_out_of_range
+        || back != bs)
+        throw std::runtime_error("bitset_text parse error handling mismatch");
+    if constexpr (N % 4 != 0) {
+        std::string over = hex;
+        over.back() = 'f'; // sets bits past N in the last digit
+        if (from_hex(over, back) != std::errc::result_out_of_range || back != bs) throw std::runtime_error("bitset_text from_hex overflow not detected");
+    }
+}
+
+template <std::size_t N, typename T = typename compact_bitset<N>::word_type>
+void test_bitset_format()
+{
+    std::cout << std::string(80, '-') << "\n";
+    std::mt19937_64 rng(N);
+    compact_bitset<N, T> bs;
+    for (std::size_t i = 0; i < N; ++i) bs.set(i, rng() % 3 == 0);
+    for (std::size_t i = N / 2; i < N / 2 + 5 && i < N; ++i) bs.set(i); // make sure there's a run
+    const auto fmt = [&](std::string_view spec) {
+        std::string ret;
+        bitset_format::format_to(std::back_inserter(ret), bs, spec);
+        return ret;
+    };
+    // reference set list
+    std::string expList = "{";
+    for (std::size_t i = 0; i < N; ++i) {
+        if (!bs[i]) continue;
+        std::size_t j = i;
+        while (j + 1 < N && bs[j + 1]) ++j;
+        expList += (expList.size() > 1 ? "," : "") + std::to_string(i) + (j != i ? "-" + std::to_string(j) : "");
+        i = j;
+    }
+    expList += "}";
+    const auto group = [](const std::string &str, std::size_t n, char sep) {
+        std::string ret;
+        for (std::size_t i = 0; i < str.size(); ++i) ret += (i && i % n == 0 ? std::string(1, sep) : "") + str[i];
+        return ret;
+    };
+    std::cout << "bitset_format N: " << N << " l: " << fmt("l").substr(0, 60) << "\n";
+    const std::string bin = bs.to_string(), hex = to_hex(bs);
+    if (fmt("") != bin || fmt("b") != bin || fmt("x") != hex || fmt("X") != to_hex(bs, true) || fmt("l") != expList)
+        throw std::runtime_error("bitset_format type mismatch");
+    if (fmt("_4b") != group(bin, 4, '_') || fmt("'3x") != group(hex, 3, '\'') || bitset_format::content_size(bs, bitset_format::spec{}) != N)
+        throw std::runtime_error("bitset_format grouping mismatch");
+    const std::size_t w = expList.size() + 7;
+    if (fmt(std::to_string(w) + "l") != expList + std::string(7, ' ') || fmt(">" + std::to_string(w) + "l") != std::string(7, ' ') + expList
+        || fmt("*^" + std::to_string(w) + "l") != "***" + expList + "****" || fmt("3l").size() != expList.size())
+        throw std::runtime_error("bitset_format padding mismatch");
+    for (const char *bad : {"q", "_b", "_4l", "10bb"}) {
+        bool threw = false;
+        try { fmt(bad); } catch (const std::invalid_argument &) { threw = true; }
+        if (!threw) throw std::runtime_error("bitset_format accepted a bad spec");
+    }
+#if defined(COMPACT_BITSET_HAS_FMT) && defined(COMPACT_BITSET_TEST_FMT)
+    if (fmt::format("[{:l}|{:_4x}]", bs, bs) != "[" + expList + "|" + fmt("_4x") + "]"
+        || fmt::format(fmt::runtime("{:>" + std::to_string(w) + "l}"), bs) != fmt(">" + std::to_string(w) + "l"))
+        throw std::runtime_error("bitset_format fmt::formatter mismatch");
+#endif
+#ifdef __cpp_lib_format
+    if (std::format("{:x}", bs) != hex) throw std::runtime_error("bitset_format std::formatter mismatch");
+#endif
+}
+
+#if __has_include(<unistd.h>) // POSIX only
+template <std::size_t N, typename T = typename compact_bitset<N>::word_type>
+void test_bitset_loader()
+{
+    std::cout << std::string(80, '-') << "\n";
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / ("compact_bitset_test_" + std::to_string(::getpid()));
+    fs::create_directories(dir);
+    struct cleanup { fs::path p; ~cleanup() { std::error_code ec; fs::remove_all(p, ec); } } c{dir};
+    std::mt19937_64 rng(N);
+    constexpr std::size_t nlines = 20000;
+    std::vector<compact_bitset<N, T>> expected(nlines);
+    std::vector<std::pair<std::size_t, std::size_t>> expErrors; // line, offset
+    std::string text;
+    for (std::size_t i = 0; i < nlines; ++i) {
+        for (std::size_t j = 0; j < N; ++j) expected[i].set(j, rng() % 2);
+        std::string line = expected[i].to_string();
+        const std::size_t start = text.size();
+        switch (rng() % 500) {
+        case 0: line[rng() % N] = 'x'; expErrors.emplace_back(i, start + line.find('x')); expected[i].reset(); break;
+        case 1: line.pop_back(); expErrors.emplace_back(i, start + line.size()); expected[i].reset(); break;
+        case 2: line += "0"; expErrors.emplace_back(i, start + line.size()); expected[i].reset(); break;
+        case 3: line += "\r"; break; // CRLF is fine
+        }
+        text += line;
+        if (i + 1 < nlines) text += '\n'; // no newline at the very end
+    }
+    const std::string path = (dir / "lines.txt").string();
+    std::ofstream(path, std::ios::binary) << text;
+    bitset_load_options opts;
+    opts.nthreads = 4;
+    const auto res = load_bitset_lines<N, T>(path, opts);
+    std::cout << "bitset_loader N: " << N << " lines: " << res.bitsets.size() << " errors: " << res.error_count;
+    if (!res.errors.empty()) std::cout << " first: line " << res.errors[0].line << " @" << res.errors[0].offset << " (" << res.errors[0].reason << ")";
+    std::cout << "\n";
+    if (res.bitsets != expected || res.error_count != expErrors.size() || res.errors.size() != expErrors.size())
+        throw std::runtime_error("bitset_loader result mismatch");
+    for (std::size_t i = 0; i < expErrors.size(); ++i)
+        if (res.errors[i].line != expErrors[i].first || res.errors[i].offset != expErrors[i].second)
+            throw std::runtime_error("bitset_loader error location mismatch");
+    // single-threaded gives the same answer, and max_errors caps what's recorded
+    opts.nthreads = 1;
+    opts.max_errors = 2;
+    const auto res1 = parse_bitset_lines<N, T>(text, opts);
+    if (res1.bitsets != expected || res1.error_count != expErrors.size() || res1.errors.size() != std::min<std::size_t>(2, expErrors.size()))
+        throw std::runtime_error("bitset_loader single-threaded mismatch");
+}
+#endif
+
+void test_bounds_check_policy()
+{
+    std::cout << std::string(80, '-') << "\n";
+    compact_bitset<70> a, b;
+    static_assert(noexcept(a.set_unchecked(0)) && noexcept(a.test_unchecked(0)) && noexcept(a.flip_unchecked(0)) && noexcept(a.reset_unchecked(0)));
+    static_assert(noexcept(a.set(0)) == (COMPACT_BITSET_BOUNDS_CHECK != 2));
+    static_assert(compact_bitset<10>().set_unchecked(3).flip_unchecked(4).reset_unchecked(3).test_unchecked(4)); // constexpr
+    std::mt19937_64 rng(94);
+    for (int i = 0; i < 500; ++i) {
+        const std::size_t pos = rng() % a.size();
+        switch (rng() % 3) {
+        case 0: a.set(pos, i % 2); b.set_unchecked(pos, i % 2); break;
+        case 1: a.flip(pos); b.flip_unchecked(pos); break;
+        case 2: a.reset(pos); b.reset_unchecked(pos); break;
+        }
+        if (a != b || a.test(pos) != b.test_unchecked(pos)) throw std::runtime_error("unchecked accessors mismatch");
+    }
+    std::cout << "COMPACT_BITSET_BOUNDS_CHECK: " << COMPACT_BITSET_BOUNDS_CHECK << " a: " << a << "\n";
+#if COMPACT_BITSET_BOUNDS_CHECK == 2
+    bool threw = false;
+    try { a.set(a.size()); } catch (const std::out_of_range &) { threw = true; }
+    if (!threw) throw std::runtime_error("compact_bitset::set out of range didn't throw");
+#endif
+}
+
+template <std::size_t N>
+void test_single_word()
+{
+    std::cout << std::string(80, '-') << "\n";
+    using CB = compact_bitset<N>;
+    using Ref = compact_bitset<N, std::uint8_t>; // reference: takes the multi-word paths for N > 8
+    static_assert(sizeof(CB) == sizeof(typename CB::word_type) && std::is_trivially_copyable_v<CB>);
+    // everything below must be usable in a constant expression
+    constexpr CB x(0b1011), y(0b0110);
+    if constexpr (N >= 8) {
+        static_assert((x & y) == CB(0b0010) && (x | y) == CB(0b1111) && (x ^ y) == CB(0b1101));
+        static_assert((x << 2) == CB(0b101100) && (x >> 1) == CB(0b101) && (x << N) == CB() && (x >> N).none());
+        static_assert((~x).count() == N - 3 && (~CB()).all() && !x.all() && x.any() && CB().none());
+        static_assert(x.to_ulong() == 0b1011 && (x & ~y).to_ullong() == 0b1001 && CB().set().count() == N);
+        static_assert(CB(0b1011).flip() == ~x && CB(x).reset().none() && CB(~0ull).count() == N);
+    }
+    std::mt19937_64 rng(95);
+    for (int i = 0; i < 2000; ++i) {
+        const unsigned long long va = rng(), vb = rng();
+        const unsigned sh = rng() % (N + 2);
+        const CB a(va), b(vb);
+        const Ref ra(va), rb(vb);
+        const auto same = [](const CB &c, const Ref &r) { return c.to_string() == r.to_string(); };
+        if (!same(a, ra) || !same(a & b, ra & rb) || !same(a | b, ra | rb) || !same(a ^ b, ra ^ rb) || !same(~a, ~ra)
+                || !same(a << sh, ra << sh) || !same(a >> sh, ra >> sh) || !same(CB(a).flip(), Ref(ra).flip())
+                || a.count() != ra.count() || a.all() != ra.all() || a.any() != ra.any() || (a == b) != (ra == rb)
+                || a.to_ullong() != ra.to_ullong())
+            throw std::runtime_error("single-word compact_bitset differs from the multi-word implementation");
+    }
+    std::cout << "single_word N: " << N << " x & y: " << (x & y) << " ~x: " << ~x << "\n";
+}
+
+void test_per_core_bitset()
+{
+    std::cout << std::string(80, '-') << "\n";
+    using Stat = compact_bitset<256>;
+    static_assert(alignof(cache_padded<Stat>) == cache_line_size && sizeof(cache_padded<Stat>) == cache_line_size);
+    static_assert(sizeof(cache_padded<compact_bitset<1000>>) == 2 * cache_line_size);
+    static_assert(sizeof(cache_padded<Stat, 1>) == sizeof(Stat) && alignof(cache_padded<Stat, 1>) == alignof(Stat));
+    std::array<cache_padded<Stat>, 4> stats;
+    if (reinterpret_cast<std::uintptr_t>(&stats[1]) - reinterpret_cast<std::uintptr_t>(&stats[0]) != cache_line_size
+            || reinterpret_cast<std::uintptr_t>(&stats[0]) % cache_line_size)
+        throw std::runtime_error("cache_padded layout mismatch");
+    stats[2]->set(7);
+    if (!(*stats[2]).test(7) || stats[1]->any()) throw std::runtime_error("cache_padded access mismatch");
+
+    constexpr std::size_t N = 1000, nthreads = 4;
+    per_core_bitset<N> pcb(3);
+    compact_bitset<N> expected;
+    std::vector<std::vector<std::size_t>> positions(nthreads);
+    std::mt19937_64 rng(96);
+    for (auto &v : positions)
+        for (int i = 0; i < 300; ++i) expected.set(v.emplace_back(rng() % N));
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < nthreads; ++t)
+        threads.emplace_back([&, t] {
+            for (const auto pos : positions[t]) {
+                if (t % 2) pcb.set(pos);
+                else pcb.set_in(t % pcb.num_shards(), pos);
+            }
+        });
+    for (auto &th : threads) th.join();
+    std::cout << "per_core_bitset shards: " << pcb.num_shards() << " count: " << pcb.count() << "\n";
+    compact_bitset<N> fromShards;
+    for (std::size_t s = 0; s < pcb.num_shards(); ++s) fromShards |= pcb.shard(s);
+    if (pcb.merged() != expected || fromShards != expected || pcb.count() != expected.count())
+        throw std::runtime_error("per_core_bitset merge mismatch");
+    for (std::size_t i = 0; i < N; i += 3) {
+        pcb.reset(i);
+        expected.reset(i);
+    }
+    for (std::size_t i = 0; i < N; ++i)
+        if (pcb.test(i) != expected.test(i)) throw std::runtime_error("per_core_bitset test/reset mismatch");
+    if (pcb.merged() != expected || pcb.none()) throw std::runtime_error("per_core_bitset reset mismatch");
+    pcb.reset();
+    if (pcb.any() || pcb.count()) throw std::runtime_error("per_core_bitset reset() mismatch");
+    bool threw = false;
+    try { pcb.set(N); } catch (const std::out_of_range &) { threw = true; }
+    if (!threw) throw std::runtime_error("per_core_bitset::set out of range didn't throw");
+}
+
+void test_sharded_bitset()
+{
+    std::cout << std::string(80, '-') << "\n";
+    constexpr std::size_t N = 777, nthreads = 4;
+    sharded_bitset<N> sb(nthreads);
+    std::vector<compact_bitset<N>> perThread(nthreads);
+    std::mt19937_64 rng(97);
+    for (auto &bs : perThread)
+        for (int i = 0; i < 200; ++i) bs.set(rng() % N);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < nthreads; ++t)
+        threads.emplace_back([&, t] {
+            auto w = sb.make_writer();
+            for (std::size_t i = 0; i < N; ++i)
+                if (perThread[t].test(i)) w.set(i).flip(i).flip(i);
+            while (true) { sb.merged(); if (sb.epoch()) break; } // readers may run concurrently with writers
+        });
+    for (auto &th : threads) th.join();
+    compact_bitset<N> any, all = ~compact_bitset<N>(), odd;
+    for (const auto &bs : perThread) any |= bs, all &= bs, odd ^= bs;
+    const auto m = sb.merged();
+    std::cout << "sharded_bitset writers: " << sb.max_writers() << " count: " << m.count() << "\n";
+    if (m != any || sb.count() != any.count()) throw std::runtime_error("sharded_bitset merge mismatch");
+    // no writes since: served from the cache
+    const auto nm = sb.merge_count();
+    std::size_t set1 = 0, unset1 = 0;
+    while (!m.test(set1)) ++set1;
+    while (m.test(unset1)) ++unset1;
+    if (sb.merged() != any || !sb.test(set1) || sb.merge_count() != nm)
+        throw std::runtime_error("sharded_bitset cache mismatch");
+    {
+        auto w = sb.make_writer(); // all writers were released, so this reuses shard 0 (with its bits)
+        const std::size_t pos = unset1;
+        w.set(pos).set(pos); // the second set changes nothing
+        if (!sb.test(pos) || sb.merge_count() != nm + 1) throw std::runtime_error("sharded_bitset epoch mismatch");
+        auto w2 = sb.make_writer(), w3 = sb.make_writer(), w4 = sb.make_writer();
+        bool threw = false;
+        try { sb.make_writer(); } catch (const std::length_error &) { threw = true; }
+        if (!threw) throw std::runtime_error("sharded_bitset::make_writer didn't throw when full");
+        w.reset(pos);
+    }
+    // the other merge policies, with one writer (and so one shard) per thread's bits
+    sharded_bitset<N, std::uint8_t, sharded_merge::all_of> sball(nthreads);
+    sharded_bitset<N, std::uint64_t, sharded_merge::odd_of> sbodd(nthreads);
+    if (sball.merged().any()) throw std::runtime_error("sharded_bitset all_of of no shards should be empty");
+    std::vector<decltype(sball)::writer> wall;
+    std::vector<decltype(sbodd)::writer> wodd;
+    for (std::size_t t = 0; t < nthreads; ++t) {
+        wall.push_back(sball.make_writer());
+        wodd.push_back(sbodd.make_writer());
+        for (std::size_t i = 0; i < N; ++i)
+            if (perThread[t].test(i)) wall.back().set(i), wodd.back().flip(i);
+    }
+    if (sball.merged().to_string() != all.to_string() || sbodd.merged() != odd) throw std::runtime_error("sharded_bitset all_of/odd_of mismatch");
+    // claiming a writer after a merge must invalidate the cached merge even before that writer writes: the result
+    // can't depend on whether the merge happened before or after the claim
+    sharded_bitset<N, std::uint64_t, sharded_merge::all_of> late(2);
+    auto wa = late.make_writer();
+    wa.set(3);
+    if (!late.test(3)) throw std::runtime_error("sharded_bitset all_of single writer mismatch");
+    auto wb = late.make_writer();
+    if (late.test(3) || late.merged().any()) throw std::runtime_error("sharded_bitset stale merge after make_writer");
+}
+
+void test_rcu_bitset()
+{
+    std::cout << std::string(80, '-') << "\n";
+    // the writer grows a prefix of set bits one update at a time; readers check every snapshot is some whole prefix
+    // (a torn or freed version would fail that, and trip ASAN/TSAN) and that versions never go backwards
+    constexpr std::size_t N = 500, nreaders = 3;
+    rcu_bitset<N> rb(nreaders);
+    std::atomic<bool> done{false}, failed{false};
+    std::atomic<std::size_t> nsnaps{0};
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < nreaders; ++t)
+        threads.emplace_back([&] {
+            const auto r = rb.make_reader();
+            std::size_t last = 0;
+            for (bool stop = false; !stop; ) {
+                stop = done.load(); // one more pass after the writer finished
+                const auto snap = r.read();
+                const std::size_t c = snap->count();
+                if (c < last || (c && !snap->test(c - 1)) || (c < N && snap->test(c))) failed = true;
+                last = c;
+                ++nsnaps;
+            }
+            if (r.load().count() != N) failed = true;
+        });
+    for (std::size_t i = 0; i < N; ++i) {
+        if (i % 2) rb.update([i](auto &bs) { bs.set(i); });
+        else rb.publish(rb.load().set(i));
+        if (i % 64 == 0) std::this_thread::yield();
+    }
+    done = true;
+    for (auto &th : threads) th.join();
+    rb.synchronize();
+    std::cout << "rcu_bitset readers: " << rb.max_readers() << " final count: " << rb.load().count() << " pending: " << rb.pending() << "\n";
+    if (failed || rb.pending() || nsnaps < nreaders) throw std::runtime_error("rcu_bitset snapshot mismatch");
+    // a held snapshot pins its version (and everything retired after it) until it is dropped
+    {
+        auto r = rb.make_reader();
+        auto r2 = rb.make_reader(), r3 = rb.make_reader();
+        bool threw = false;
+        try { rb.make_reader(); } catch (const std::length_error &) { threw = true; }
+        if (!threw) throw std::runtime_error("rcu_bitset::make_reader didn't throw when full");
+        {
+            const auto snap = r.read();
+            rb.publish({});
+            rb.publish(compact_bitset<N>().set(1));
+            if (rb.pending() != 2 || snap->count() != N || rb.reclaim() != 0 || r2.load().count() != 1)
+                throw std::runtime_error("rcu_bitset reclamation freed a version still in use");
+        }
+        if (rb.reclaim() != 2 || rb.pending()) throw std::runtime_error("rcu_bitset reclamation mismatch");
+    }
+}
+
+template <typename T>
+void test_atomic_bitset()
+{
+    std::cout << std::string(80, '-') << "\n";
+    constexpr std::size_t N = 100, nworkers = 4;
+    using ABS = atomic_bitset<N, T>;
+    ABS abs;
+    if (abs.set(5) || !abs.set(5) || !abs.test(5) || !abs.flip(5) || abs.test(5) || abs.reset(70) || abs.count())
+        throw std::runtime_error("atomic_bitset set/flip/reset mismatch");
+    compact_bitset<N, T> bs;
+    bs.set(0).set(64).set(99);
+    abs.store(bs);
+    if (abs.load() != bs || ABS(bs).load() != bs) throw std::runtime_error("atomic_bitset load/store mismatch");
+    abs.reset();
+    // ping-pong on two bits
+    std::thread pong([&] { abs.wait_until_set(70); abs.set_and_notify(71); });
+    abs.set(70);
+    abs.notify(70);
+    abs.wait_until_set(71);
+    pong.join();
+    // a barrier: wait_all for one bit per worker
+    compact_bitset<N, T> all;
+    std::vector<std::thread> workers;
+    for (std::size_t t = 0; t < nworkers; ++t) {
+        all.set(10 + t);
+        workers.emplace_back([&abs, t] { std::this_thread::yield(); abs.set_and_notify(10 + t); });
+    }
+    abs.wait_all(all);
+    for (auto &th : workers) th.join();
+    // wait_any reports which of the awaited bits it saw
+    compact_bitset<N, T> any, got;
+    any.set(3).set(90);
+    std::thread waiter([&] { got = abs.wait_any(any); });
+    std::this_thread::yield();
+    abs.set(50); abs.notify_all(); // not in the mask: the waiter wakes, re-checks and sleeps again
+    abs.set_and_notify(90);
+    waiter.join();
+    std::cout << "atomic_bitset<" << N << ", " << sizeof(T) * 8 << "-bit> after waits: " << abs.load() << "\n";
+    if (got != compact_bitset<N, T>().set(90) || (abs.load() & all) != all || !abs.test(71)
+            || abs.wait_any(compact_bitset<N, T>()).any())
+        throw std::runtime_error("atomic_bitset wait mismatch");
+    bool threw = false;
+    try { abs.wait_until_set(N); } catch (const std::out_of_range &) { threw = true; }
+    if (!threw) throw std::runtime_error("atomic_bitset::wait_until_set out of range didn't throw");
+}
+
+void test_priority_scheduler()
+{
+    std::cout << std::string(80, '-') << "\n";
+    // find_first/find_last, which the scheduler is built on
+    static_assert(compact_bitset<20>(0b1011000).find_first() == 3 && compact_bitset<20>(0b1011000).find_last() == 6);
+    static_assert(compact_bitset<20>().find_first() == 20 && compact_bitset<20>().find_last() == 20);
+    std::mt19937_64 rng(100);
+    for (int i = 0; i < 200; ++i) {
+        compact_bitset<1000, std::uint8_t> bs;
+        for (int k = rng() % 4; k > 0; --k) bs.set(rng() % bs.size());
+        std::size_t first = bs.size(), last = bs.size();
+        for (std::size_t j = 0; j < bs.size(); ++j)
+            if (bs.test(j)) last = j, first = std::min(first, j);
+        if (bs.find_first() != first || bs.find_last() != last) throw std::runtime_error("find_first/find_last mismatch");
+    }
+
+    // against std::priority_queue, ordered by (level, then oldest first)
+    constexpr std::size_t Levels = 256;
+    priority_scheduler<Levels, int> ps;
+    std::priority_queue<std::tuple<std::size_t, long, int>> ref;
+    long seq = 0;
+    std::vector<int> order;
+    for (int i = 0; i < 5000; ++i) {
+        if (rng() % 3 || ps.empty()) {
+            const std::size_t level = rng() % 3 ? rng() % 8 * 32 : rng() % Levels; // clustered, to get FIFO runs
+            ps.push(level, i);
+            ref.emplace(level, --seq, i);
+        } else {
+            if (ps.top_level() != std::get<0>(ref.top()) || ps.front() != std::get<2>(ref.top()))
+                throw std::runtime_error("priority_scheduler order mismatch");
+            order.push_back(ps.front());
+            ps.pop();
+            ref.pop();
+        }
+        if (ps.size() != ref.size()) throw std::runtime_error("priority_scheduler size mismatch");
+    }
+    int task;
+    while (ps.try_pop(task)) {
+        if (task != std::get<2>(ref.top())) throw std::runtime_error("priority_scheduler drain mismatch");
+        ref.pop();
+    }
+    if (!ref.empty() || ps.top_level() != Levels || ps.ready_mask().any()) throw std::runtime_error("priority_scheduler not empty");
+    std::cout << "priority_scheduler<" << Levels << "> pops checked: " << order.size() << "\n";
+
+    // concurrent: producers push unique values, consumers drain with wait_pop until they each get a stop task (-1)
+    constexpr int nproducers = 3, nconsumers = 2, perProducer = 2000;
+    concurrent_priority_scheduler<Levels, int> cps;
+    std::vector<std::vector<int>> got(nconsumers);
+    std::vector<std::thread> threads;
+    for (int c = 0; c < nconsumers; ++c)
+        threads.emplace_back([&, c] {
+            for (int v; cps.wait_pop(v), v != -1; ) got[c].push_back(v);
+        });
+    std::vector<std::thread> producers;
+    for (int p = 0; p < nproducers; ++p)
+        producers.emplace_back([&, p] {
+            std::mt19937_64 prng(p);
+            for (int i = 0; i < perProducer; ++i) cps.push(prng() % Levels, p * perProducer + i);
+        });
+    for (auto &th : producers) th.join();
+    for (int c = 0; c < nconsumers; ++c) cps.push(0, -1); // level 0 is FIFO-after every real task on it
+    for (auto &th : threads) th.join();
+    std::vector<int> all;
+    for (const auto &v : got) all.insert(all.end(), v.begin(), v.end());
+    std::sort(all.begin(), all.end());
+    for (int i = 0; i < int(all.size()); ++i)
+        if (all[i] != i) throw std::runtime_error("concurrent_priority_scheduler lost or duplicated a task");
+    if (all.size() != std::size_t(nproducers * perProducer) || !cps.empty() || cps.top_level() != Levels)
+        throw std::runtime_error("concurrent_priority_scheduler mismatch");
+    // single-threaded, it pops in the same order as priority_scheduler
+    for (int i = 0; i < 1000; ++i) {
+        const std::size_t level = rng() % 16;
+        ps.push(level, i);
+        cps.push(level, i);
+    }
+    for (int a, b; ps.try_pop(a); )
+        if (!cps.try_pop(b) || a != b) throw std::runtime_error("concurrent_priority_scheduler order mismatch");
+    std::cout << "concurrent_priority_scheduler<" << Levels << "> tasks: " << all.size() << "\n";
+}
+
 int main()
 {
     test<11>();
@@ -85,5 +1341,64 @@ int main()
         is >> cbs;
         std::cout << "StramParse: s: " << s << " -> " << cbs.to_string() << "\n";
     }
+    test_bounds_check_policy();
+    test_single_word<1>();
+    test_single_word<5>();
+    test_single_word<20>();
+    test_single_word<64>();
+    test_packed_int_vector<1>();
+    test_packed_int_vector<13>();
+    test_packed_int_vector<21>();
+    test_packed_int_vector<64>();
+    test_packed_int_vector<0>(7);
+    test_packed_int_vector<0>(33);
+    test_packed_int_vector<0>(64);
+    test_rank_select();
+    test_elias_fano();
+    test_wavelet_matrix(1);
+    test_wavelet_matrix(4);
+    test_bp_tree();
+    test_dynamic_bitvector();
+    test_fenwick_bitset<13>();
+    test_fenwick_bitset<64>();
+    test_fenwick_bitset<1000>();
+    test_fenwick_bitset<4099>();
+    test_ewah_bitset();
+    test_hybrid_bitset();
+    test_list_ops<30>();
+    test_list_ops<1000, std::uint8_t>();
+    test_list_ops<5003>();
+    test_bitstream();
+    test_snapshot_stream<4096>();
+    test_snapshot_stream<100, std::uint8_t>();
+    test_bitset_io<300000>();
+    test_bitset_io<70001, std::uint8_t>();
+#if __has_include(<unistd.h>) // POSIX only
+    test_disk_bitset(false);
+    test_disk_bitset(true);
+#endif
+#if __has_include(<unistd.h>) // POSIX only
+    test_mmap_bitset();
+#endif
+    test_arrow_bitmap<1000, std::uint64_t>();
+    test_arrow_bitmap<777, std::uint16_t>();
+    test_bitset_text<1>();
+    test_bitset_text<13>();
+    test_bitset_text<64>();
+    test_bitset_text<100, std::uint8_t>();
+    test_bitset_text<1001>();
+    test_bitset_format<1>();
+    test_bitset_format<70, std::uint8_t>();
+    test_bitset_format<1000>();
+#if __has_include(<unistd.h>) // POSIX only
+    test_bitset_loader<100>();
+    test_bitset_loader<13, std::uint16_t>();
+#endif
+    test_per_core_bitset();
+    test_sharded_bitset();
+    test_rcu_bitset();
+    test_atomic_bitset<std::uint64_t>();
+    test_atomic_bitset<std::uint32_t>();
+    test_priority_scheduler();
     return 0;
 }
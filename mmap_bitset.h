@@ -0,0 +1,221 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bit_util.h"
+#include "compact_bitset.h"
+#include "disk_bitset.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// A mutable bitset whose words live in a file mapped with MAP_SHARED (POSIX only).
+///
+/// Writes go straight to the page cache, so they survive a crash of the process (though not of the machine) and
+/// reopening the file is instant no matter how big it is. For durability, sync() msyncs just the pages written since
+/// the last sync(), which are tracked one bit per page. The file layout is the same as disk_bitset's (raw 64-bit
+/// words in host byte order), so the disk_bitset streaming operations work on these files too.
+///
+/// Unlike compact_bitset the size is set at runtime, and it can be changed with resize(), which grows or shrinks the
+/// file and remaps it (with mremap() where available). Bits past size() are always 0.
+struct mmap_bitset_options {
+    bool huge_pages = false; ///< madvise(MADV_HUGEPAGE): helps TLB reach for huge random-access sets (Linux)
+    bool populate = false;   ///< pre-fault the whole mapping when opening, rather than on first touch
+};
+
+class mmap_bitset
+{
+public:
+    using options = mmap_bitset_options;
+
+    /// Open `path`, creating it if needed, and size it to hold exactly `nbits` bits (existing bits are kept)
+    mmap_bitset(const std::string &path, std::size_t nbits, const options &opts_ = {})
+        : fd(path, O_RDWR | O_CREAT, false), opts(opts_) {
+        do_resize(nbits);
+    }
+    /// Open an existing file, taking its size from the file (a whole number of words)
+    explicit mmap_bitset(const std::string &path, const options &opts_ = {}) : fd(path, O_RDWR, false), opts(opts_) {
+        struct stat st;
+        if (::fstat(fd.get(), &st) != 0) disk_bitset::detail::throw_errno("mmap_bitset: cannot stat " + path);
+        if (st.st_size % 8) throw std::invalid_argument("mmap_bitset: size of " + path + " is not a whole number of words");
+        do_resize(std::size_t(st.st_size) * 8);
+    }
+    mmap_bitset(mmap_bitset &&o) noexcept
+        : fd(std::move(o.fd)), opts(o.opts), words(std::exchange(o.words, nullptr)), nbits(std::exchange(o.nbits, 0)),
+          mappedBytes(std::exchange(o.mappedBytes, 0)), dirty(std::move(o.dirty)) {}
+    mmap_bitset & operator=(mmap_bitset &&o) noexcept {
+        std::swap(fd, o.fd), std::swap(opts, o.opts), std::swap(words, o.words), std::swap(nbits, o.nbits);
+        std::swap(mappedBytes, o.mappedBytes), std::swap(dirty, o.dirty);
+        return *this;
+    }
+    /// Unmaps without msync(); the kernel still writes the pages back eventually.
+    ~mmap_bitset() { unmap(); }
+
+    std::size_t size() const noexcept { return nbits; }
+    std::size_t num_words() const noexcept { return (nbits + 63) / 64; }
+    std::uint64_t word(std::size_t i) const noexcept { return words[i]; }
+    const std::uint64_t * data() const noexcept { return words; }
+    /// Set word i; bits past size() in the last word are masked off
+    void set_word(std::size_t i, std::uint64_t w) noexcept {
+        if (i + 1 == num_words() && nbits % 64) w &= bit_util::low_mask(unsigned(nbits % 64));
+        words[i] = w;
+        mark_dirty(i);
+    }
+
+    bool operator[](std::size_t pos) const noexcept { return words[pos / 64] >> (pos % 64) & 1; }
+    bool test(std::size_t pos) const { throw_if_out_of_range(pos); return (*this)[pos]; }
+    mmap_bitset & set(std::size_t pos, bool value = true) {
+        throw_if_out_of_range(pos);
+        const std::uint64_t mask = std::uint64_t(1) << (pos % 64);
+        std::uint64_t &w = words[pos / 64];
+        if (bool(w & mask) != value) { // don't dirty a page for a no-op write
+            w ^= mask;
+            mark_dirty(pos / 64);
+        }
+        return *this;
+    }
+    mmap_bitset & reset(std::size_t pos) { return set(pos, false); }
+    mmap_bitset & flip(std::size_t pos) { throw_if_out_of_range(pos); return set(pos, !(*this)[pos]); }
+    /// Set every bit to `value`
+    mmap_bitset & set_all(bool value = true) noexcept {
+        for (std::size_t i = 0; i < num_words(); ++i) set_word(i, value ? ~std::uint64_t(0) : 0);
+        return *this;
+    }
+
+    std::size_t count() const noexcept {
+        std::size_t ret = 0;
+        for (std::size_t i = 0; i < num_words(); ++i) ret += unsigned(bit_util::popcount(words[i]));
+        return ret;
+    }
+    bool any() const noexcept { return std::any_of(words, words + num_words(), [](std::uint64_t w) { return w != 0; }); }
+    bool none() const noexcept { return !any(); }
+
+    /// Copy into a compact_bitset, which must have the same size
+    template <std::size_t N, typename T = typename compact_bitset<N>::word_type>
+    compact_bitset<N, T> to_bitset() const {
+        if (N != nbits) throw std::invalid_argument("mmap_bitset::to_bitset size mismatch");
+        compact_bitset<N, T> ret;
+        bitset_word_sink<N, T> sink(ret);
+        for (std::size_t i = 0; i < num_words(); ++i) sink.put(i, words[i]);
+        return ret;
+    }
+
+    /// Number of pages written since the last sync()
+    std::size_t dirty_pages() const noexcept {
+        std::size_t ret = 0;
+        for (const auto d : dirty) ret += unsigned(bit_util::popcount(d));
+        return ret;
+    }
+    /// msync() the pages written since the last sync(), coalescing adjacent ones into a single call.
+    /// With `async` the writeback is only scheduled (MS_ASYNC). @throws std::system_error on failure
+    void sync(bool async = false) {
+        const std::size_t page = page_size(), npages = dirty.size() * 64;
+        for (std::size_t p = next_dirty(0, npages); p < npages; ) {
+            std::size_t end = p;
+            while (end < npages && (dirty[end / 64] >> (end % 64) & 1)) dirty[end / 64] &= ~(std::uint64_t(1) << (end % 64)), ++end;
+            const std::size_t len = std::min(end * page, mappedBytes) - p * page;
+            if (::msync(reinterpret_cast<char *>(words) + p * page, len, async ? MS_ASYNC : MS_SYNC) != 0)
+                disk_bitset::detail::throw_errno("mmap_bitset: msync failed");
+            p = next_dirty(end, npages);
+        }
+    }
+
+    /// Change the size to `n` bits, growing or truncating the file. New bits are 0. Pointers from data() are
+    /// invalidated. Dirty pages are synced first, so that truncation never discards tracked writes.
+    void resize(std::size_t n) {
+        sync();
+        do_resize(n);
+    }
+
+private:
+    disk_bitset::detail::fd_handle fd;
+    options opts;
+    std::uint64_t *words = nullptr;
+    std::size_t nbits = 0, mappedBytes = 0;
+    std::vector<std::uint64_t> dirty; // one bit per page of the mapping
+
+    static std::size_t page_size() noexcept {
+        static const std::size_t sz = std::size_t(::sysconf(_SC_PAGESIZE));
+        return sz;
+    }
+    void throw_if_out_of_range(std::size_t pos) const {
+        if (pos >= nbits) throw std::out_of_range("Out-of-range bit position specified to mmap_bitset");
+    }
+    void mark_dirty(std::size_t wordIdx) noexcept {
+        const std::size_t p = wordIdx * 8 / page_size();
+        dirty[p / 64] |= std::uint64_t(1) << (p % 64);
+    }
+    std::size_t next_dirty(std::size_t p, std::size_t npages) const noexcept {
+        while (p < npages) {
+            const std::uint64_t w = dirty[p / 64] & ~bit_util::low_mask(unsigned(p % 64));
+            if (w) return p / 64 * 64 + unsigned(bit_util::ctz(w));
+            p = p / 64 * 64 + 64;
+        }
+        return npages;
+    }
+    void unmap() noexcept {
+        if (words) ::munmap(words, mappedBytes);
+        words = nullptr;
+        mappedBytes = 0;
+    }
+    void do_resize(std::size_t n) {
+        const std::size_t bytes = (n + 63) / 64 * 8;
+        if (::ftruncate(fd.get(), off_t(bytes)) != 0) disk_bitset::detail::throw_errno("mmap_bitset: cannot resize file");
+        if (bytes != mappedBytes || !words) {
+            void *p = MAP_FAILED;
+#ifdef MREMAP_MAYMOVE
+            if (words && bytes) p = ::mremap(words, mappedBytes, bytes, MREMAP_MAYMOVE);
+#endif
+            if (p == MAP_FAILED) {
+                unmap();
+                int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+                if (opts.populate) flags |= MAP_POPULATE;
+#endif
+                if (bytes) p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags, fd.get(), 0);
+                if (bytes && p == MAP_FAILED) disk_bitset::detail::throw_errno("mmap_bitset: mmap failed");
+            }
+            words = bytes ? static_cast<std::uint64_t *>(p) : nullptr;
+            mappedBytes = bytes;
+#ifdef MADV_HUGEPAGE
+            if (words && opts.huge_pages) ::madvise(words, bytes, MADV_HUGEPAGE); // advisory; failure is harmless
+#endif
+        }
+        nbits = n;
+        const std::size_t npages = (bytes + page_size() - 1) / page_size();
+        dirty.resize((npages + 63) / 64);
+        if (npages % 64) dirty.back() &= bit_util::low_mask(unsigned(npages % 64));
+        // a file opened with fewer bits than it holds may have stray bits past the end; clear them
+        if (n % 64 && (words[n / 64] & ~bit_util::low_mask(unsigned(n % 64)))) set_word(n / 64, words[n / 64]);
+    }
+};
@@ -0,0 +1,256 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include <algorithm>
+#include <cstddef> // for std::byte
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// A vector of unsigned integers that are each exactly `Width` bits wide, packed back-to-back into 64-bit words.
+/// Like compact_bitset, it doesn't waste memory: a vector of 1000 13-bit values takes 1625 bytes rather than the
+/// 2000 bytes a std::vector<std::uint16_t> would.
+///
+/// If `Width` is 0, the width is specified at runtime to the constructor (and must be in the range [1, 64]).
+/// Element `i` occupies bits [i * width(), (i + 1) * width()) of the word array, so a value may straddle two words.
+/// As with compact_bitset, unused bits past the end of the last element are always 0.
+template<std::size_t Width = 0>
+class packed_int_vector
+{
+    static_assert (Width <= 64, "Width of packed_int_vector must be in the range [1, 64], or 0 for a runtime width");
+    using Word = std::uint64_t;
+    static constexpr std::size_t WBits = 64;
+    using WordVec = std::vector<Word>;
+    WordVec words; // unused bits in this array are always 0
+    std::size_t nelems = 0;
+    [[maybe_unused]] std::size_t rtWidth = Width; // only used if Width == 0
+
+    static constexpr Word mask_for(std::size_t w) noexcept { return w >= WBits ? ~Word(0) : (Word(1) << w) - 1; }
+    static constexpr std::size_t words_for(std::size_t n, std::size_t w) noexcept { return (n * w + WBits - 1) / WBits; }
+
+    constexpr Word mask() const noexcept {
+        if constexpr (Width != 0) return mask_for(Width);
+        else return mask_for(rtWidth);
+    }
+    void throw_if_out_of_range(std::size_t pos) const {
+        if (pos >= size()) throw std::out_of_range("Out-of-range position specified to packed_int_vector");
+    }
+    // zero out the bits in the last word past the last element, to maintain the invariant
+    void clear_unused_bits() noexcept {
+        if (const std::size_t rem = (nelems * width()) % WBits; rem && !words.empty())
+            words.back() &= mask_for(rem);
+    }
+    Word get_unchecked(std::size_t i) const noexcept {
+        const std::size_t w = width(), bitpos = i * w, wi = bitpos / WBits, off = bitpos % WBits;
+        Word v = words[wi] >> off;
+        if (off + w > WBits) v |= words[wi + 1] << (WBits - off);
+        return v & mask();
+    }
+    void set_unchecked(std::size_t i, Word v) noexcept {
+        const std::size_t w = width(), bitpos = i * w, wi = bitpos / WBits, off = bitpos % WBits;
+        const Word m = mask();
+        v &= m;
+        words[wi] = (words[wi] & ~(m << off)) | (v << off);
+        if (off + w > WBits) {
+            const std::size_t shift = WBits - off;
+            words[wi + 1] = (words[wi + 1] & ~(m >> shift)) | (v >> shift);
+        }
+    }
+    // Unpack 64 consecutive values starting at word `wp`. Since 64 values of width W occupy exactly W words, every
+    // shift and word index below is a compile-time constant, which lets the compiler unroll and vectorize this.
+    template <typename Out, std::size_t... Is>
+    static void unpack_block(const Word *wp, Out *out, std::index_sequence<Is...>) noexcept {
+        constexpr Word M = mask_for(Width);
+        ((out[Is] = static_cast<Out>([wp] {
+              constexpr std::size_t bitpos = Is * Width, wi = bitpos / WBits, off = bitpos % WBits;
+              Word v = wp[wi] >> off;
+              if constexpr (off + Width > WBits) v |= wp[wi + 1] << (WBits - off);
+              return v & M;
+          }())), ...);
+    }
+    template <typename In, std::size_t... Is>
+    static void pack_block(Word *wp, const In *in, std::index_sequence<Is...>) noexcept {
+        constexpr Word M = mask_for(Width);
+        std::fill(wp, wp + Width, Word(0));
+        (([wp, in] {
+             constexpr std::size_t bitpos = Is * Width, wi = bitpos / WBits, off = bitpos % WBits;
+             const Word v = static_cast<Word>(in[Is]) & M;
+             wp[wi] |= v << off;
+             if constexpr (off + Width > WBits) wp[wi + 1] |= v >> (WBits - off);
+         }()), ...);
+    }
+public:
+    /// The type returned by get(). For a compile-time Width it is the smallest unsigned type that holds Width bits.
+    using value_type = std::conditional_t<Width == 0, std::uint64_t,
+                                          std::conditional_t<Width <= 8, std::uint8_t,
+                                                             std::conditional_t<Width <= 16, std::uint16_t,
+                                                                                std::conditional_t<Width <= 32, std::uint32_t,
+                                                                                                   std::uint64_t>>>>;
+
+    class reference {
+        friend class packed_int_vector<Width>;
+        packed_int_vector & vec;
+        const std::size_t pos;
+        reference(packed_int_vector & v, std::size_t p) noexcept : vec(v), pos(p) {}
+    public:
+        /// Assign a value to the referenced element (bits above width() are discarded)
+        reference & operator=(value_type v) noexcept { vec.set_unchecked(pos, v); return *this; }
+        /// Copy-assign: note that *this still refers to the same element. This simply assigns the value of `o` to *this.
+        reference & operator=(const reference &o) noexcept { return *this = value_type(o); }
+        /// Implicit conversion to the referenced value
+        operator value_type() const noexcept { return static_cast<value_type>(vec.get_unchecked(pos)); }
+    };
+
+    /// Construct an empty vector. Only available for a compile-time Width.
+    template <std::size_t W = Width, std::enable_if_t<W != 0, int> = 0>
+    packed_int_vector() noexcept {}
+    /// Construct a vector of `n` elements, all with value `val`. Only available for a compile-time Width.
+    template <std::size_t W = Width, std::enable_if_t<W != 0, int> = 0>
+    explicit packed_int_vector(std::size_t n, value_type val = 0) { assign(n, val); }
+    /// Construct a vector of `n` elements of `width` bits each, all with value `val`. Only available if Width == 0.
+    /// @throws std::invalid_argument if width is not in the range [1, 64].
+    template <std::size_t W = Width, std::enable_if_t<W == 0, int> = 0>
+    explicit packed_int_vector(std::size_t width, std::size_t n = 0, value_type val = 0) : rtWidth(width) {
+        if (width < 1 || width > WBits) throw std::invalid_argument("packed_int_vector width must be in the range [1, 64]");
+        assign(n, val);
+    }
+
+    /// number of bits per element
+    constexpr std::size_t width() const noexcept {
+        if constexpr (Width != 0) return Width;
+        else return rtWidth;
+    }
+    /// largest value that can be stored in an element
+    constexpr value_type max_value() const noexcept { return static_cast<value_type>(mask()); }
+    std::size_t size() const noexcept { return nelems; }
+    bool empty() const noexcept { return nelems == 0; }
+    /// number of elements that fit in the currently allocated words
+    std::size_t capacity() const noexcept { return words.capacity() * WBits / width(); }
+
+    reference operator[](std::size_t pos) noexcept { return reference(*this, pos); }
+    value_type operator[](std::size_t pos) const noexcept { return static_cast<value_type>(get_unchecked(pos)); }
+    /// returns the element at pos -- throws std::out_of_range if pos >= size()
+    value_type get(std::size_t pos) const { throw_if_out_of_range(pos); return (*this)[pos]; }
+    /// set the element at pos to val (bits above width() are discarded) -- throws std::out_of_range if pos >= size()
+    packed_int_vector & set(std::size_t pos, value_type val) { throw_if_out_of_range(pos); (*this)[pos] = val; return *this; }
+
+    /// replace the contents with `n` copies of `val`
+    void assign(std::size_t n, value_type val) {
+        words.assign(words_for(n, width()), 0);
+        nelems = n;
+        if (val & mask())
+            for (std::size_t i = 0; i < n; ++i) set_unchecked(i, val);
+    }
+    void reserve(std::size_t n) { words.reserve(words_for(n, width())); }
+    void resize(std::size_t n, value_type val = 0) {
+        const std::size_t old = nelems;
+        if (n < old) {
+            nelems = n;
+            words.resize(words_for(n, width()));
+            clear_unused_bits();
+        } else {
+            words.resize(words_for(n, width()), 0);
+            nelems = n;
+            if (val & mask())
+                for (std::size_t i = old; i < n; ++i) set_unchecked(i, val);
+        }
+    }
+    void clear() noexcept { words.clear(); nelems = 0; }
+    void shrink_to_fit() { words.shrink_to_fit(); }
+    void push_back(value_type val) {
+        if (words_for(nelems + 1, width()) > words.size()) words.push_back(0);
+        set_unchecked(nelems++, val);
+    }
+    void pop_back() noexcept { resize(nelems - 1); }
+
+    /// Bulk-decode `count` elements starting at `pos` into `out`, which must have room for `count` values.
+    /// Out may be any integral type wide enough to hold width() bits.
+    /// @throws std::out_of_range if [pos, pos + count) is not within [0, size()).
+    template <typename Out>
+    void unpack(std::size_t pos, std::size_t count, Out *out) const {
+        static_assert(std::is_integral_v<Out>, "unpack() requires an integral output type");
+        if (pos > size() || count > size() - pos) throw std::out_of_range("Out-of-range block specified to packed_int_vector::unpack");
+        std::size_t i = pos;
+        const std::size_t end = pos + count;
+        if constexpr (Width != 0) {
+            // process leading elements one at a time until we are at a 64-element (W-word) boundary, then blocks
+            for (; i < end && i % 64; ++i) *out++ = static_cast<Out>(get_unchecked(i));
+            for (; i + 64 <= end; i += 64, out += 64)
+                unpack_block(words.data() + (i / 64) * Width, out, std::make_index_sequence<64>{});
+            for (; i < end; ++i) *out++ = static_cast<Out>(get_unchecked(i));
+        } else if (i < end) {
+            // runtime width: stream through the words with an accumulator rather than re-deriving offsets per element
+            const std::size_t w = width();
+            const Word m = mask();
+            std::size_t bitpos = i * w, wi = bitpos / WBits, off = bitpos % WBits;
+            Word cur = words[wi];
+            for (; i < end; ++i) {
+                Word v = cur >> off;
+                off += w;
+                if (off >= WBits) {
+                    off -= WBits;
+                    if (++wi < words.size()) {
+                        cur = words[wi];
+                        if (off) v |= cur << (w - off);
+                    }
+                }
+                *out++ = static_cast<Out>(v & m);
+            }
+        }
+    }
+    /// Bulk-encode `count` values from `in` into the elements starting at `pos`. Bits above width() are discarded.
+    /// @throws std::out_of_range if [pos, pos + count) is not within [0, size()).
+    template <typename In>
+    void pack(std::size_t pos, std::size_t count, const In *in) {
+        static_assert(std::is_integral_v<In>, "pack() requires an integral input type");
+        if (pos > size() || count > size() - pos) throw std::out_of_range("Out-of-range block specified to packed_int_vector::pack");
+        std::size_t i = pos;
+        const std::size_t end = pos + count;
+        if constexpr (Width != 0) {
+            for (; i < end && i % 64; ++i) set_unchecked(i, static_cast<Word>(*in++));
+            for (; i + 64 <= end; i += 64, in += 64)
+                pack_block(words.data() + (i / 64) * Width, in, std::make_index_sequence<64>{});
+        }
+        for (; i < end; ++i) set_unchecked(i, static_cast<Word>(*in++));
+    }
+    /// Append `count` values from `in` to the end of the vector.
+    template <typename In>
+    void append(const In *in, std::size_t count) {
+        const std::size_t pos = nelems;
+        resize(nelems + count);
+        pack(pos, count, in);
+    }
+
+    bool operator==(const packed_int_vector &o) const noexcept { return width() == o.width() && nelems == o.nelems && words == o.words; }
+    bool operator!=(const packed_int_vector &o) const noexcept { return !(*this == o); }
+
+    /// access to the underlying data. Note that bits in this array that are unused are guaranteed to be 0
+    const std::byte *bits() const noexcept { return reinterpret_cast<const std::byte *>(words.data()); }
+    std::byte *bits() noexcept { return reinterpret_cast<std::byte *>(words.data()); }
+    /// returns the number of bytes in the .bits() array
+    std::size_t bits_size() const noexcept { return words.size() * sizeof(Word); }
+};
@@ -0,0 +1,148 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "cache_padded.h"
+#include "compact_bitset.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__linux__)
+#include <sched.h> // for sched_getcpu
+#endif
+
+/// A logical compact_bitset<N, T> that is sharded across CPU cores, for bits that are set concurrently by many
+/// threads (statistics, "seen" flags, ...) and read comparatively rarely.
+///
+/// Each shard is a full copy of the bitset's words, as std::atomic<T>, padded out to whole cache lines (see
+/// cache_padded). set() does an atomic OR into the shard of the CPU the calling thread runs on, so threads on
+/// different cores never touch the same line; readers OR the words of all shards together. reset() must clear the
+/// bit in every shard, so it costs one atomic AND per shard. A bit therefore reads as set iff it was set in any
+/// shard after the last reset() that cleared it.
+///
+/// The shard is picked with sched_getcpu() on Linux and from a hash of the thread id elsewhere. The thread may
+/// migrate right after the lookup, which costs at most some sharing, never correctness. set_in() lets a caller with
+/// its own notion of "shard" (e.g. a worker index) choose one explicitly.
+///
+/// Align is the padding policy for the shards: the default gives each shard its own cache line(s); Align = 1 packs
+/// them back to back (only useful to measure what the padding buys).
+template <std::size_t N, typename T = typename compact_bitset<N>::word_type, std::size_t Align = cache_line_size>
+class per_core_bitset
+{
+public:
+    using bitset_type = compact_bitset<N, T>;
+
+private:
+    static constexpr std::size_t NWords = bitset_type::num_words();
+    static constexpr std::size_t TBits = bitset_type::word_bits;
+    using Shard = cache_padded<std::array<std::atomic<T>, NWords>, Align>;
+    std::size_t nshards;
+    std::unique_ptr<Shard[]> shards;
+
+    static constexpr T mask(std::size_t pos) noexcept { return T(T(1) << pos % TBits); }
+    void throw_if_out_of_range(std::size_t pos) const {
+        if (pos >= N) throw std::out_of_range("Out-of-range bit position specified to per_core_bitset");
+    }
+
+public:
+    /// nshards = 0: one shard per hardware thread
+    explicit per_core_bitset(std::size_t nshards_ = 0)
+        : nshards(nshards_ ? nshards_ : std::max(1u, std::thread::hardware_concurrency())),
+          shards(std::make_unique<Shard[]>(nshards)) {}
+
+    static constexpr std::size_t size() noexcept { return N; }
+    std::size_t num_shards() const noexcept { return nshards; }
+
+    /// the shard that set() on the calling thread would write to right now
+    std::size_t local_shard() const noexcept {
+#if defined(__linux__)
+        if (const int cpu = sched_getcpu(); cpu >= 0) return std::size_t(cpu) % nshards;
+#endif
+        return std::hash<std::thread::id>{}(std::this_thread::get_id()) % nshards;
+    }
+
+    /// sets bit pos in the calling CPU's shard
+    per_core_bitset & set(std::size_t pos) { return set_in(local_shard(), pos); }
+    /// sets bit pos in the given shard (shard must be < num_shards())
+    per_core_bitset & set_in(std::size_t shard, std::size_t pos) {
+        throw_if_out_of_range(pos);
+        (*shards[shard])[pos / TBits].fetch_or(mask(pos), std::memory_order_release);
+        return *this;
+    }
+    /// clears bit pos in every shard
+    per_core_bitset & reset(std::size_t pos) {
+        throw_if_out_of_range(pos);
+        for (std::size_t s = 0; s < nshards; ++s)
+            (*shards[s])[pos / TBits].fetch_and(T(~mask(pos)), std::memory_order_release);
+        return *this;
+    }
+    /// clears all bits in every shard
+    per_core_bitset & reset() noexcept {
+        for (std::size_t s = 0; s < nshards; ++s)
+            for (auto &w : *shards[s]) w.store(0, std::memory_order_release);
+        return *this;
+    }
+
+    /// true if bit pos is set in any shard
+    bool test(std::size_t pos) const {
+        throw_if_out_of_range(pos);
+        for (std::size_t s = 0; s < nshards; ++s)
+            if ((*shards[s])[pos / TBits].load(std::memory_order_acquire) & mask(pos)) return true;
+        return false;
+    }
+
+    /// returns the logical bitset: the word-wise OR of all shards. Each word is read atomically, but the result is
+    /// not a snapshot of the whole bitset if writers are running concurrently.
+    bitset_type merged() const noexcept {
+        bitset_type ret;
+        for (std::size_t w = 0; w < NWords; ++w) {
+            T acc = 0;
+            for (std::size_t s = 0; s < nshards; ++s) acc |= (*shards[s])[w].load(std::memory_order_acquire);
+            ret.set_word(w, acc);
+        }
+        return ret;
+    }
+    /// returns the bits set in one shard only
+    bitset_type shard(std::size_t s) const noexcept {
+        bitset_type ret;
+        for (std::size_t w = 0; w < NWords; ++w) ret.set_word(w, (*shards[s])[w].load(std::memory_order_acquire));
+        return ret;
+    }
+
+    std::size_t count() const noexcept { return merged().count(); }
+    bool any() const noexcept {
+        for (std::size_t s = 0; s < nshards; ++s)
+            for (const auto &w : *shards[s])
+                if (w.load(std::memory_order_acquire)) return true;
+        return false;
+    }
+    bool none() const noexcept { return !any(); }
+};
@@ -0,0 +1,174 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "atomic_bitset.h"
+#include "bit_util.h"
+#include "cache_padded.h"
+#include "compact_bitset.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+/// A ready-set scheduler over Levels priority levels: one FIFO queue per level, plus a compact_bitset<Levels>
+/// "ready mask" with bit L set iff queue L is non-empty. Higher levels run first; tasks on one level run in push
+/// order.
+///
+/// Finding the highest ready level takes two leading-zero counts instead of a scan over the levels: a summary word
+/// has bit w set iff word w of the ready mask is non-zero, so the top level is found from the top bit of the
+/// summary and then the top bit of that word. That limits Levels to 64 words' worth (4096 levels with 64-bit
+/// words). push() and pop() are O(1), plus whatever the deque does.
+template <std::size_t Levels, typename Task>
+class priority_scheduler
+{
+public:
+    using mask_type = compact_bitset<Levels, std::uint64_t>;
+
+private:
+    static constexpr std::size_t NWords = mask_type::num_words();
+    static_assert(Levels > 0 && NWords <= 64, "priority_scheduler supports 1 to 4096 levels");
+    mask_type ready;
+    std::uint64_t summary = 0; ///< bit w: ready.word(w) != 0
+    std::array<std::deque<Task>, Levels> queues;
+    std::size_t ntasks = 0;
+
+    void throw_if_out_of_range(std::size_t level) const {
+        if (level >= Levels) throw std::out_of_range("Out-of-range level specified to priority_scheduler");
+    }
+    // the highest non-empty level: the top bit of the summary picks the word, the top bit of that word the level
+    std::size_t top_level_nonempty() const noexcept {
+        const std::size_t w = std::size_t(bit_util::log2(summary));
+        return w * 64 + std::size_t(bit_util::log2(ready.word(w)));
+    }
+
+public:
+    static constexpr std::size_t levels() noexcept { return Levels; }
+    std::size_t size() const noexcept { return ntasks; }
+    bool empty() const noexcept { return !ntasks; }
+    /// the set of non-empty levels
+    const mask_type & ready_mask() const noexcept { return ready; }
+    std::size_t size(std::size_t level) const { throw_if_out_of_range(level); return queues[level].size(); }
+
+    /// returns the highest non-empty level, or levels() if there are no tasks
+    std::size_t top_level() const noexcept { return summary ? top_level_nonempty() : Levels; }
+
+    template <typename... Args>
+    void push(std::size_t level, Args &&...args) {
+        throw_if_out_of_range(level);
+        queues[level].emplace_back(std::forward<Args>(args)...);
+        ++ntasks;
+        ready.set_unchecked(level);
+        summary |= std::uint64_t(1) << level / 64;
+    }
+
+    /// the next task to run (the oldest one on top_level()). The scheduler must not be empty.
+    Task & front() noexcept { return queues[top_level_nonempty()].front(); }
+    /// removes front(). The scheduler must not be empty.
+    void pop() noexcept {
+        const std::size_t level = top_level_nonempty();
+        auto &q = queues[level];
+        q.pop_front();
+        --ntasks;
+        if (q.empty()) {
+            ready.reset_unchecked(level);
+            if (!ready.word(level / 64)) summary &= ~(std::uint64_t(1) << level / 64);
+        }
+    }
+    /// moves the next task into out and removes it; returns false if there are no tasks
+    bool try_pop(Task &out) {
+        if (!ntasks) return false;
+        out = std::move(front());
+        pop();
+        return true;
+    }
+};
+
+/// A thread-safe priority_scheduler for many producers and consumers. Each level's queue has its own mutex (on its
+/// own cache line), and the ready mask is an atomic_bitset that consumers read without any lock: a consumer loads
+/// the mask, takes the top level's lock and pops, retrying if another consumer emptied the level first. Producers and
+/// consumers of different levels therefore never contend, and the "which level is next" lookup is lock-free.
+///
+/// A level's ready bit is only changed while its lock is held, so it can't disagree with the queue for longer than
+/// a push or pop takes. wait_pop() sleeps (see atomic_bitset::wait_any) until a task is available.
+template <std::size_t Levels, typename Task>
+class concurrent_priority_scheduler
+{
+public:
+    using mask_type = compact_bitset<Levels, std::uint64_t>;
+
+private:
+    struct Level {
+        std::mutex mut;
+        std::deque<Task> queue;
+    };
+    std::unique_ptr<cache_padded<Level>[]> lvls = std::make_unique<cache_padded<Level>[]>(Levels);
+    atomic_bitset<Levels, std::uint64_t> ready;
+
+    void throw_if_out_of_range(std::size_t level) const {
+        if (level >= Levels) throw std::out_of_range("Out-of-range level specified to concurrent_priority_scheduler");
+    }
+
+public:
+    static constexpr std::size_t levels() noexcept { return Levels; }
+    /// a snapshot of the non-empty levels (may be stale by the time it's used)
+    mask_type ready_mask() const noexcept { return ready.load(); }
+    bool empty() const noexcept { return ready_mask().none(); }
+    /// returns the highest non-empty level, or levels() if there are no tasks (may be stale by the time it's used)
+    std::size_t top_level() const noexcept { return ready_mask().find_last(); }
+
+    template <typename... Args>
+    void push(std::size_t level, Args &&...args) {
+        throw_if_out_of_range(level);
+        auto &l = *lvls[level];
+        std::lock_guard g(l.mut);
+        l.queue.emplace_back(std::forward<Args>(args)...);
+        if (l.queue.size() == 1) ready.set_and_notify(level);
+    }
+
+    /// moves the next task (the oldest one on the highest non-empty level) into out and removes it; returns false
+    /// if there were no tasks
+    bool try_pop(Task &out) {
+        for (auto mask = ready.load(); mask.any(); mask = ready.load()) {
+            const std::size_t level = mask.find_last();
+            auto &l = *lvls[level];
+            std::lock_guard g(l.mut);
+            if (l.queue.empty()) continue; // lost the race for it: look again
+            out = std::move(l.queue.front());
+            l.queue.pop_front();
+            if (l.queue.empty()) ready.reset(level);
+            return true;
+        }
+        return false;
+    }
+    /// like try_pop(), but sleeps until there is a task
+    void wait_pop(Task &out) {
+        while (!try_pop(out)) ready.wait_any(~mask_type());
+    }
+};
@@ -0,0 +1,175 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bit_util.h"
+#include "compact_bitset.h"
+
+#include <algorithm>
+#include <cstddef> // for std::byte
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/// An immutable runtime-sized bit vector with an index supporting constant-time rank and fast select.
+///
+/// The index stores one cumulative count per 512-bit block (8 words), plus a sample of the block containing every
+/// 512th one (and zero) to narrow down the search for select. This costs ~14% space on top of the bits themselves.
+/// As with compact_bitset, unused bits past size() in the word array are always 0.
+class rank_select_bitvector
+{
+    using Word = std::uint64_t;
+    static constexpr std::size_t WBits = 64;
+    static constexpr std::size_t BlockWords = 8, BlockBits = BlockWords * WBits;
+    static constexpr std::size_t SampleRate = 512; ///< a select sample is taken every this many ones (or zeros)
+
+    std::vector<Word> words; // unused bits in this array are always 0
+    std::size_t nbits = 0;
+    std::vector<std::uint64_t> blockRanks; ///< blockRanks[b] = number of ones in blocks [0, b). Has nblocks + 1 entries.
+    std::vector<std::uint32_t> select1Samples, select0Samples; ///< block containing the (j * SampleRate)-th one/zero
+
+    std::size_t num_blocks() const noexcept { return (words.size() + BlockWords - 1) / BlockWords; }
+    // number of zeros in blocks [0, b)
+    std::uint64_t zeros_before_block(std::size_t b) const noexcept { return std::min(b * BlockBits, nbits) - blockRanks[b]; }
+    template <bool Bit>
+    std::uint64_t count_before_block(std::size_t b) const noexcept {
+        if constexpr (Bit) return blockRanks[b];
+        else return zeros_before_block(b);
+    }
+    void build_index() {
+        if (const std::size_t rem = nbits % WBits; rem) words.back() &= bit_util::low_mask(unsigned(rem));
+        const std::size_t nblocks = num_blocks();
+        blockRanks.assign(nblocks + 1, 0);
+        select1Samples.clear();
+        select0Samples.clear();
+        std::uint64_t ones = 0, zeros = 0;
+        for (std::size_t b = 0; b < nblocks; ++b) {
+            blockRanks[b] = ones;
+            std::uint64_t blockOnes = 0;
+            for (std::size_t w = b * BlockWords; w < std::min(words.size(), (b + 1) * BlockWords); ++w)
+                blockOnes += unsigned(bit_util::popcount(words[w]));
+            const std::uint64_t blockZeros = std::min(BlockBits, nbits - b * BlockBits) - blockOnes;
+            // record this block for every sample point that falls within it
+            while (select1Samples.size() * SampleRate < ones + blockOnes) select1Samples.push_back(std::uint32_t(b));
+            while (select0Samples.size() * SampleRate < zeros + blockZeros) select0Samples.push_back(std::uint32_t(b));
+            ones += blockOnes;
+            zeros += blockZeros;
+        }
+        blockRanks[nblocks] = ones;
+    }
+    template <bool Bit>
+    std::size_t select_impl(std::size_t k, const std::vector<std::uint32_t> &samples) const {
+        if (k >= count<Bit>()) throw std::out_of_range("Out-of-range rank specified to rank_select_bitvector::select");
+        // the block holding the k-th bit lies between the samples bracketing k; binary search for it
+        const std::size_t j = k / SampleRate;
+        std::size_t lo = samples[j], hi = j + 1 < samples.size() ? samples[j + 1] + 1 : num_blocks();
+        while (hi - lo > 1) {
+            const std::size_t mid = lo + (hi - lo) / 2;
+            if (count_before_block<Bit>(mid) <= k) lo = mid;
+            else hi = mid;
+        }
+        k -= count_before_block<Bit>(lo);
+        for (std::size_t w = lo * BlockWords; ; ++w) {
+            const Word word = Bit ? words[w] : ~words[w];
+            if (const std::size_t c = unsigned(bit_util::popcount(word)); k < c)
+                return w * WBits + unsigned(bit_util::select_in_word(word, unsigned(k)));
+            else
+                k -= c;
+        }
+    }
+    template <bool Bit>
+    std::size_t count() const noexcept {
+        if constexpr (Bit) return blockRanks.back();
+        else return nbits - blockRanks.back();
+    }
+public:
+    /// construct an empty bit vector
+    rank_select_bitvector() : blockRanks(1, 0) {}
+    /// take ownership of `nbits` bits stored in `words` (bit j of words[i] is bit i * 64 + j), and build the index
+    rank_select_bitvector(std::vector<std::uint64_t> wordsIn, std::size_t nbitsIn) : words(std::move(wordsIn)), nbits(nbitsIn) {
+        if (words.size() * WBits < nbits) throw std::invalid_argument("Word array is too small for the specified number of bits");
+        words.resize((nbits + WBits - 1) / WBits);
+        build_index();
+    }
+    /// copy the bits of a compact_bitset, and build the index
+    template <std::size_t N, typename T>
+    explicit rank_select_bitvector(const compact_bitset<N, T> &bs) : words((N + WBits - 1) / WBits), nbits(N) {
+        for (std::size_t i = 0; i < bs.num_words(); ++i) {
+            const std::size_t bitpos = i * bs.word_bits;
+            words[bitpos / WBits] |= Word(bs.word(i)) << (bitpos % WBits);
+        }
+        build_index();
+    }
+
+    std::size_t size() const noexcept { return nbits; }
+    bool operator[](std::size_t pos) const noexcept { return words[pos / WBits] >> (pos % WBits) & 0x1; }
+    /// returns the bit at pos -- throws std::out_of_range if pos >= size()
+    bool test(std::size_t pos) const {
+        if (pos >= size()) throw std::out_of_range("Out-of-range bit position specified to rank_select_bitvector");
+        return (*this)[pos];
+    }
+    /// returns the number of bits set to true
+    std::size_t count() const noexcept { return count<true>(); }
+
+    /// returns the number of ones in positions [0, pos). pos may be in the range [0, size()].
+    std::size_t rank1(std::size_t pos) const noexcept {
+        const std::size_t b = pos / BlockBits, wEnd = pos / WBits;
+        std::size_t ret = blockRanks[b];
+        for (std::size_t w = b * BlockWords; w < wEnd; ++w) ret += unsigned(bit_util::popcount(words[w]));
+        if (const std::size_t rem = pos % WBits; rem)
+            ret += unsigned(bit_util::popcount(words[wEnd] & bit_util::low_mask(unsigned(rem))));
+        return ret;
+    }
+    /// returns the number of zeros in positions [0, pos). pos may be in the range [0, size()].
+    std::size_t rank0(std::size_t pos) const noexcept { return pos - rank1(pos); }
+    /// returns the position of the k-th (0-based) one -- throws std::out_of_range if k >= count()
+    std::size_t select1(std::size_t k) const { return select_impl<true>(k, select1Samples); }
+    /// returns the position of the k-th (0-based) zero -- throws std::out_of_range if k >= size() - count()
+    std::size_t select0(std::size_t k) const { return select_impl<false>(k, select0Samples); }
+
+    /// returns the position of the first one at or after pos, or size() if there is none
+    std::size_t next_one(std::size_t pos) const noexcept {
+        if (pos >= nbits) return nbits;
+        std::size_t w = pos / WBits;
+        Word word = words[w] & ~bit_util::low_mask(unsigned(pos % WBits));
+        while (!word) {
+            if (++w >= words.size()) return nbits;
+            word = words[w];
+        }
+        return w * WBits + unsigned(bit_util::ctz(word));
+    }
+
+    /// returns word i of the underlying array
+    std::uint64_t word(std::size_t i) const noexcept { return words[i]; }
+    std::size_t num_words() const noexcept { return words.size(); }
+    /// access to the underlying data. Note that bits in this array that are unused are guaranteed to be 0
+    const std::byte *bits() const noexcept { return reinterpret_cast<const std::byte *>(words.data()); }
+    /// returns the number of bytes in the .bits() array
+    std::size_t bits_size() const noexcept { return words.size() * sizeof(Word); }
+    /// returns the number of bytes used by the rank/select index
+    std::size_t index_size() const noexcept {
+        return blockRanks.size() * sizeof(blockRanks[0]) + (select1Samples.size() + select0Samples.size()) * sizeof(std::uint32_t);
+    }
+};
@@ -0,0 +1,204 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "cache_padded.h"
+#include "compact_bitset.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/// A read-mostly shared compact_bitset<N, T> with RCU-style ("read-copy-update") publishing: writers build a new
+/// bitset and atomically swap a pointer to it in, and readers take snapshots without ever taking a lock or writing
+/// to a cache line that another thread writes to.
+///
+/// Old versions are freed with epoch-based reclamation. There is a global epoch, and each reader owns a cache-line
+/// padded slot. To take a snapshot a reader copies the global epoch into its slot, then loads the current pointer;
+/// dropping the snapshot clears the slot. A writer that replaces a version tags it with the global epoch and then
+/// advances the epoch; the old version is freed once every slot is either clear or newer than the tag (readers
+/// that entered later can only have seen the replacement). Writers are serialized by a mutex, and they (not the
+/// readers) do the freeing, in publish() and reclaim(); synchronize() waits until everything retired is freed.
+///
+/// Readers are obtained with make_reader() (at most max_readers at a time) and each may be used by one thread at a
+/// time, with at most one live snapshot per reader. The rcu_bitset must outlive its readers and snapshots.
+template <std::size_t N, typename T = typename compact_bitset<N>::word_type>
+class rcu_bitset
+{
+public:
+    using bitset_type = compact_bitset<N, T>;
+
+private:
+    struct Node {
+        bitset_type bits;
+        std::uint64_t retiredAt = 0; ///< the global epoch when this version was replaced
+    };
+    using Slot = cache_padded<std::atomic<std::uint64_t>>; ///< 0: not reading, else the epoch the reader entered at
+    std::size_t nslots;
+    std::unique_ptr<Slot[]> slots;
+    std::unique_ptr<cache_padded<std::atomic<bool>>[]> claimed;
+    alignas(cache_line_size) std::atomic<Node *> current;
+    std::atomic<std::uint64_t> globalEpoch{1};
+
+    alignas(cache_line_size) mutable std::mutex writeMut; ///< serializes writers; guards `retired`
+    std::vector<std::unique_ptr<Node>> retired;
+
+    // frees retired versions that no reader can still see; writeMut must be held
+    std::size_t reclaim_locked() {
+        std::uint64_t oldest = UINT64_MAX; // the oldest epoch a reader is in
+        for (std::size_t s = 0; s < nslots; ++s)
+            if (const auto e = slots[s]->load(); e && e < oldest) oldest = e;
+        const std::size_t before = retired.size();
+        std::size_t keep = 0;
+        for (auto &n : retired)
+            if (n->retiredAt >= oldest) retired[keep++] = std::move(n);
+        retired.resize(keep);
+        return before - keep;
+    }
+
+public:
+    /// A snapshot: the version that was current when it was taken, valid until the snapshot is destroyed.
+    class snapshot {
+        friend class rcu_bitset;
+        std::atomic<std::uint64_t> *slot = nullptr;
+        const Node *node = nullptr;
+        snapshot(std::atomic<std::uint64_t> *s, const Node *n) noexcept : slot(s), node(n) {}
+    public:
+        snapshot(snapshot &&o) noexcept : slot(o.slot), node(o.node) { o.slot = nullptr; }
+        snapshot & operator=(snapshot &&) = delete;
+        ~snapshot() { if (slot) slot->store(0, std::memory_order_release); }
+        const bitset_type & operator*() const noexcept { return node->bits; }
+        const bitset_type * operator->() const noexcept { return &node->bits; }
+    };
+
+    /// A reader's handle on its epoch slot. Move it to hand it to another thread.
+    class reader {
+        friend class rcu_bitset;
+        rcu_bitset *owner = nullptr;
+        std::size_t idx = 0;
+        reader(rcu_bitset *o, std::size_t i) noexcept : owner(o), idx(i) {}
+    public:
+        reader() noexcept = default;
+        reader(reader &&o) noexcept : owner(o.owner), idx(o.idx) { o.owner = nullptr; }
+        reader & operator=(reader &&o) noexcept {
+            if (this != &o) { release(); owner = o.owner; idx = o.idx; o.owner = nullptr; }
+            return *this;
+        }
+        ~reader() { release(); }
+        void release() noexcept {
+            if (owner) owner->claimed[idx]->store(false, std::memory_order_release);
+            owner = nullptr;
+        }
+        explicit operator bool() const noexcept { return owner != nullptr; }
+
+        /// takes a snapshot of the current version (lock-free; at most one live snapshot per reader)
+        snapshot read() const noexcept {
+            auto &slot = *owner->slots[idx];
+            // seq_cst: the slot store must be visible to writers before we load `current`
+            slot.store(owner->globalEpoch.load());
+            return snapshot(&slot, owner->current.load());
+        }
+        /// returns a copy of the current version
+        bitset_type load() const noexcept { return *read(); }
+    };
+
+    explicit rcu_bitset(std::size_t max_readers, const bitset_type &initial = {})
+        : nslots(max_readers), slots(std::make_unique<Slot[]>(max_readers)),
+          claimed(std::make_unique<cache_padded<std::atomic<bool>>[]>(max_readers)), current(new Node{initial}) {
+        if (!max_readers) throw std::invalid_argument("rcu_bitset needs at least one reader slot");
+    }
+    rcu_bitset(const rcu_bitset &) = delete;
+    rcu_bitset & operator=(const rcu_bitset &) = delete;
+    ~rcu_bitset() { delete current.load(); }
+
+    static constexpr std::size_t size() noexcept { return N; }
+    std::size_t max_readers() const noexcept { return nslots; }
+
+    /// claims a free reader slot; throws std::length_error if max_readers() readers are alive
+    reader make_reader() {
+        for (std::size_t s = 0; s < nslots; ++s) {
+            bool expected = false;
+            if (claimed[s]->compare_exchange_strong(expected, true, std::memory_order_acquire)) return reader(this, s);
+        }
+        throw std::length_error("rcu_bitset: all reader slots are taken");
+    }
+
+    /// makes bs the current version. Readers that already hold a snapshot keep seeing the old one.
+    void publish(const bitset_type &bs) {
+        auto fresh = std::make_unique<Node>(Node{bs});
+        std::lock_guard g(writeMut);
+        publish_locked(std::move(fresh));
+    }
+    /// copies the current version, applies f(bitset_type &) to the copy and publishes it, atomically with respect
+    /// to other writers
+    template <typename F>
+    void update(F && f) {
+        std::lock_guard g(writeMut);
+        auto fresh = std::make_unique<Node>(Node{current.load()->bits});
+        f(fresh->bits);
+        publish_locked(std::move(fresh));
+    }
+    /// returns a copy of the current version (for writers and other occasional readers without a reader handle;
+    /// this takes the writer mutex)
+    bitset_type load() const {
+        std::lock_guard g(writeMut);
+        return current.load()->bits;
+    }
+
+    /// frees the retired versions that no reader can still see; returns how many were freed
+    std::size_t reclaim() {
+        std::lock_guard g(writeMut);
+        return reclaim_locked();
+    }
+    /// the number of retired versions not yet freed
+    std::size_t pending() const {
+        std::lock_guard g(writeMut);
+        return retired.size();
+    }
+    /// blocks until every version retired so far has been freed, i.e. until all snapshots older than the current
+    /// version are gone. Must not be called while holding a snapshot.
+    void synchronize() {
+        while (true) {
+            {
+                std::lock_guard g(writeMut);
+                reclaim_locked();
+                if (retired.empty()) return;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    void publish_locked(std::unique_ptr<Node> fresh) {
+        Node *old = current.exchange(fresh.release());
+        old->retiredAt = globalEpoch.fetch_add(1);
+        retired.emplace_back(old);
+        reclaim_locked();
+    }
+};
@@ -0,0 +1,215 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "cache_padded.h"
+#include "compact_bitset.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+/// How sharded_bitset combines its shards into the logical bitset. Each policy gives the word the merge starts from
+/// and how to fold one shard's word into it.
+namespace sharded_merge {
+/// a bit is set if any writer set it (the default)
+struct any_of {
+    template <typename T> static constexpr T identity() noexcept { return T(0); }
+    template <typename T> static constexpr T combine(T acc, T w) noexcept { return T(acc | w); }
+};
+/// a bit is set if every shard that was ever handed out to a writer has it set, whether or not that writer has
+/// written yet (e.g. "all workers finished item i")
+struct all_of {
+    template <typename T> static constexpr T identity() noexcept { return T(~T(0)); }
+    template <typename T> static constexpr T combine(T acc, T w) noexcept { return T(acc & w); }
+};
+/// a bit is set if an odd number of writers have it set (e.g. per-thread parity that toggles with flip())
+struct odd_of {
+    template <typename T> static constexpr T identity() noexcept { return T(0); }
+    template <typename T> static constexpr T combine(T acc, T w) noexcept { return T(acc ^ w); }
+};
+} // namespace sharded_merge
+
+/// A bitset for write-heavy concurrent use: every writer thread owns a private shard (a full copy of the words,
+/// on its own cache lines), and readers see the shards combined by the Merge policy (OR by default).
+///
+/// Writes never leave the writer's shard, and are plain loads and stores rather than atomic read-modify-writes
+/// (the shard has a single writer, so no lock prefix is needed), hence no cache line moves between writers. Each
+/// shard also carries a write epoch that the owner bumps after every write that changed a word; a write that
+/// changes nothing doesn't even store.
+///
+/// The merged view is computed lazily: merged() compares every shard's epoch (and the number of shards handed
+/// out so far) with what the last merge saw, and only re-merges if one moved, otherwise it returns the cached
+/// bitset. A read-mostly phase between write bursts thus costs one epoch load per shard. The epochs are loaded
+/// (with acquire) before the words, so a merge reflects at least every write whose epoch it saw; a write racing
+/// with the merge is picked up by the next one.
+///
+/// Writers are obtained with make_writer(), which hands out a free shard (at most max_writers at a time). When a
+/// writer is destroyed its shard keeps its bits and goes to the next make_writer(). Exactly the shards that were
+/// ever handed out take part in merges -- a freshly claimed, still empty shard included -- which matters for
+/// all_of.
+template <std::size_t N, typename T = typename compact_bitset<N>::word_type, typename Merge = sharded_merge::any_of>
+class sharded_bitset
+{
+public:
+    using bitset_type = compact_bitset<N, T>;
+
+private:
+    static constexpr std::size_t NWords = bitset_type::num_words();
+    static constexpr std::size_t TBits = bitset_type::word_bits;
+    struct ShardData {
+        std::atomic<std::uint64_t> epoch{0}; ///< bumped by the owner after each write that changed a word
+        std::atomic<bool> claimed{false};
+        std::array<std::atomic<T>, NWords> words{};
+    };
+    using Shard = cache_padded<ShardData>;
+    std::size_t nshards;
+    std::unique_ptr<Shard[]> shards;
+    std::atomic<std::size_t> nused{0}; ///< shards [0, nused) have been handed out at least once
+
+    mutable std::mutex cacheMut; ///< guards the 4 members below
+    mutable bitset_type cache;
+    mutable std::vector<std::uint64_t> cacheEpochs; ///< the epoch of each shard as seen by the merge that made `cache`
+    mutable std::size_t cacheNUsed = 0; ///< the number of shards the merge that made `cache` combined
+    mutable std::uint64_t nmerges = 0;
+
+    static void throw_if_out_of_range(std::size_t pos) {
+        if (pos >= N) throw std::out_of_range("Out-of-range bit position specified to sharded_bitset");
+    }
+
+public:
+    /// A writer's handle on its shard. Use it from one thread at a time; move it to hand the shard over.
+    class writer {
+        friend class sharded_bitset;
+        ShardData *shard = nullptr;
+        explicit writer(ShardData *s) noexcept : shard(s) {}
+        template <typename Op>
+        writer & update(std::size_t pos, Op op) {
+            throw_if_out_of_range(pos);
+            auto &w = shard->words[pos / TBits];
+            const T old = w.load(std::memory_order_relaxed), val = op(old, T(T(1) << pos % TBits));
+            if (val != old) {
+                w.store(val, std::memory_order_relaxed);
+                shard->epoch.store(shard->epoch.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            }
+            return *this;
+        }
+    public:
+        writer() noexcept = default;
+        writer(writer &&o) noexcept : shard(o.shard) { o.shard = nullptr; }
+        writer & operator=(writer &&o) noexcept {
+            if (this != &o) { release(); shard = o.shard; o.shard = nullptr; }
+            return *this;
+        }
+        ~writer() { release(); }
+        /// gives the shard back (its bits stay, and remain part of the merged view)
+        void release() noexcept {
+            if (shard) shard->claimed.store(false, std::memory_order_release);
+            shard = nullptr;
+        }
+        explicit operator bool() const noexcept { return shard != nullptr; }
+
+        writer & set(std::size_t pos, bool val = true) {
+            return val ? update(pos, [](T w, T m) { return T(w | m); }) : reset(pos);
+        }
+        writer & reset(std::size_t pos) { return update(pos, [](T w, T m) { return T(w & ~m); }); }
+        writer & flip(std::size_t pos) { return update(pos, [](T w, T m) { return T(w ^ m); }); }
+        /// the bit as this writer's shard has it (not the merged view)
+        bool test(std::size_t pos) const {
+            throw_if_out_of_range(pos);
+            return shard->words[pos / TBits].load(std::memory_order_relaxed) >> pos % TBits & 0x1;
+        }
+        /// clears this writer's shard
+        writer & reset() noexcept {
+            for (auto &w : shard->words) w.store(0, std::memory_order_relaxed);
+            shard->epoch.store(shard->epoch.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            return *this;
+        }
+    };
+
+    explicit sharded_bitset(std::size_t max_writers)
+        : nshards(max_writers), shards(std::make_unique<Shard[]>(max_writers)), cacheEpochs(max_writers, 0) {
+        if (!max_writers) throw std::invalid_argument("sharded_bitset needs at least one shard");
+    }
+
+    static constexpr std::size_t size() noexcept { return N; }
+    std::size_t max_writers() const noexcept { return nshards; }
+
+    /// claims a free shard; throws std::length_error if max_writers() writers are alive
+    writer make_writer() {
+        for (std::size_t s = 0; s < nshards; ++s) {
+            bool expected = false;
+            if (shards[s]->claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                for (std::size_t n = nused.load(); n <= s && !nused.compare_exchange_weak(n, s + 1);) {}
+                return writer(&shards[s].value);
+            }
+        }
+        throw std::length_error("sharded_bitset: all shards are taken");
+    }
+
+    /// the sum of all shard epochs: changes whenever any write changed a bit in some shard
+    std::uint64_t epoch() const noexcept {
+        std::uint64_t ret = 0;
+        for (std::size_t s = 0; s < nshards; ++s) ret += shards[s]->epoch.load(std::memory_order_acquire);
+        return ret;
+    }
+
+    /// the logical bitset: the shards combined with Merge. Re-merges only if a shard was written, or a new shard was
+    /// handed out, since the last call.
+    bitset_type merged() const {
+        std::lock_guard g(cacheMut);
+        const std::size_t n = nused.load(std::memory_order_acquire);
+        bool stale = nmerges == 0 || n != cacheNUsed;
+        for (std::size_t s = 0; s < n; ++s) {
+            const std::uint64_t e = shards[s]->epoch.load(std::memory_order_acquire);
+            if (e != cacheEpochs[s]) cacheEpochs[s] = e, stale = true;
+        }
+        if (stale) {
+            for (std::size_t w = 0; w < NWords; ++w) {
+                T acc = n ? Merge::template identity<T>() : T(0);
+                for (std::size_t s = 0; s < n; ++s)
+                    acc = Merge::combine(acc, shards[s]->words[w].load(std::memory_order_relaxed));
+                cache.set_word(w, acc);
+            }
+            cacheNUsed = n;
+            ++nmerges;
+        }
+        return cache;
+    }
+    /// how many times merged() actually had to merge (as opposed to returning the cached result)
+    std::uint64_t merge_count() const {
+        std::lock_guard g(cacheMut);
+        return nmerges;
+    }
+
+    bool test(std::size_t pos) const { throw_if_out_of_range(pos); return merged().test(pos); }
+    std::size_t count() const { return merged().count(); }
+    bool any() const { return merged().any(); }
+    bool none() const { return !any(); }
+};
@@ -0,0 +1,198 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bit_util.h"
+#include "bitstream.h"
+#include "compact_bitset.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+/// An immutable, compressed sequence of compact_bitset<N, T> snapshots, as produced by snapshot_encoder.
+///
+/// Each snapshot is stored as the XOR of it and the previous snapshot, listing only the words that changed: the gap
+/// since the last changed word as an Elias gamma code, then either the position of the single bit that flipped or, if
+/// several did, the whole XOR word. Every keyframe_interval() snapshots a keyframe is stored instead (the XOR against
+/// an all-zero bitset), and its position recorded, so snapshot i is decoded from the nearest keyframe at or before it
+/// rather than from the start. A snapshot identical to its predecessor costs 1 bit.
+template<std::size_t N, typename T = typename compact_bitset<N>::word_type>
+class snapshot_stream
+{
+public:
+    using Bitset = compact_bitset<N, T>;
+private:
+    template <std::size_t, typename> friend class snapshot_encoder;
+    static constexpr std::size_t TBits = Bitset::word_bits;
+    static constexpr unsigned PosBits = unsigned(TBits == 8 ? 3 : TBits == 16 ? 4 : TBits == 32 ? 5 : 6);
+    static constexpr std::uint64_t Magic = 0x3173707362637378ull; // "xscbsps1"
+
+    std::vector<std::uint64_t> words;
+    std::size_t nbits = 0;
+    std::size_t nsnapshots = 0;
+    std::size_t interval = 1;
+    std::vector<std::uint64_t> keyframes; ///< bit offset of every keyframe
+
+    // apply the next encoded frame from r to bs (XOR)
+    static void decode_frame(bit_reader<> &r, Bitset &bs) {
+        const std::uint64_t nchanged = r.read_gamma() - 1;
+        std::size_t w = 0;
+        for (std::uint64_t i = 0; i < nchanged; ++i) {
+            w += std::size_t(r.read_gamma() - 1);
+            if (w >= Bitset::num_words()) throw std::invalid_argument("Corrupt snapshot_stream frame");
+            const T x = r.read_bit() ? T(T(1) << r.read(PosBits)) : T(r.read(unsigned(TBits)));
+            bs.set_word(w, T(bs.word(w) ^ x));
+            ++w;
+        }
+    }
+public:
+    /// Sequential decoder: yields each snapshot in turn, applying one delta per step.
+    class cursor {
+        friend class snapshot_stream;
+        const snapshot_stream *ss;
+        bit_reader<> r;
+        std::size_t next = 0;
+        Bitset cur;
+        explicit cursor(const snapshot_stream &s) : ss(&s), r(s.nbits, s.words.data()) {}
+    public:
+        /// returns false when there are no more snapshots
+        bool has_next() const noexcept { return next < ss->nsnapshots; }
+        /// decode and return the next snapshot
+        const Bitset & next_snapshot() {
+            if (!has_next()) throw std::out_of_range("No more snapshots in snapshot_stream");
+            if (next % ss->interval == 0) cur.reset(); // keyframe
+            decode_frame(r, cur);
+            ++next;
+            return cur;
+        }
+    };
+
+    snapshot_stream() = default;
+
+    /// returns the number of snapshots
+    std::size_t size() const noexcept { return nsnapshots; }
+    bool empty() const noexcept { return nsnapshots == 0; }
+    std::size_t keyframe_interval() const noexcept { return interval; }
+    /// returns the number of bytes used by the encoded snapshots and the keyframe index
+    std::size_t bytes_used() const noexcept { return words.size() * sizeof(words[0]) + keyframes.size() * sizeof(keyframes[0]); }
+
+    /// Decode snapshot i, starting from the keyframe at or before it -- throws std::out_of_range if i >= size()
+    Bitset at(std::size_t i) const {
+        if (i >= nsnapshots) throw std::out_of_range("Out-of-range index specified to snapshot_stream");
+        bit_reader<> r(nbits, words.data());
+        r.seek(keyframes[i / interval]);
+        Bitset ret;
+        for (std::size_t j = i / interval * interval; j <= i; ++j) decode_frame(r, ret);
+        return ret;
+    }
+    Bitset operator[](std::size_t i) const { return at(i); }
+    /// returns a cursor for decoding all snapshots in order, in O(1) per unchanged word
+    cursor begin_decode() const { return cursor(*this); }
+
+    /// Write the stream to `os` in a compact binary form (native byte order). Sets failbit on error.
+    void save(std::ostream &os) const {
+        const std::uint64_t header[] = {Magic, N, TBits, nsnapshots, interval, nbits, keyframes.size(), words.size()};
+        os.write(reinterpret_cast<const char *>(header), sizeof(header));
+        os.write(reinterpret_cast<const char *>(keyframes.data()), std::streamsize(keyframes.size() * sizeof(keyframes[0])));
+        os.write(reinterpret_cast<const char *>(words.data()), std::streamsize(words.size() * sizeof(words[0])));
+    }
+    /// Read a stream written by save() -- throws std::invalid_argument if the data is not a stream of this type
+    static snapshot_stream load(std::istream &is) {
+        std::uint64_t header[8];
+        if (!is.read(reinterpret_cast<char *>(header), sizeof(header)) || header[0] != Magic || header[1] != N || header[2] != TBits
+                || !header[4] || header[6] != (header[3] + header[4] - 1) / header[4] || header[5] > header[7] * 64)
+            throw std::invalid_argument("Not a valid snapshot_stream for this bitset type");
+        snapshot_stream ret;
+        ret.nsnapshots = std::size_t(header[3]);
+        ret.interval = std::size_t(header[4]);
+        ret.nbits = std::size_t(header[5]);
+        ret.keyframes.resize(std::size_t(header[6]));
+        ret.words.resize(std::size_t(header[7]));
+        if (!is.read(reinterpret_cast<char *>(ret.keyframes.data()), std::streamsize(ret.keyframes.size() * sizeof(ret.keyframes[0])))
+                || !is.read(reinterpret_cast<char *>(ret.words.data()), std::streamsize(ret.words.size() * sizeof(ret.words[0]))))
+            throw std::invalid_argument("Truncated snapshot_stream");
+        return ret;
+    }
+};
+
+/// Appends compact_bitset<N, T> snapshots to a snapshot_stream, one XOR delta at a time.
+template<std::size_t N, typename T = typename compact_bitset<N>::word_type>
+class snapshot_encoder
+{
+    using Stream = snapshot_stream<N, T>;
+    using Bitset = compact_bitset<N, T>;
+    bit_writer<> w;
+    Bitset prev;
+    std::size_t nsnapshots = 0, interval;
+    std::vector<std::uint64_t> keyframes;
+public:
+    /// store a keyframe every `keyframeInterval` snapshots (must be >= 1)
+    explicit snapshot_encoder(std::size_t keyframeInterval = 1024) : interval(keyframeInterval) {
+        if (!interval) throw std::invalid_argument("snapshot_encoder keyframe interval must be at least 1");
+    }
+    /// returns the number of snapshots appended so far
+    std::size_t size() const noexcept { return nsnapshots; }
+    /// returns the number of bits encoded so far
+    std::size_t bit_size() const noexcept { return w.size(); }
+
+    void append(const Bitset &bs) {
+        if (nsnapshots % interval == 0) {
+            keyframes.push_back(w.size());
+            prev.reset();
+        }
+        std::size_t nchanged = 0;
+        for (std::size_t i = 0; i < Bitset::num_words(); ++i) nchanged += bs.word(i) != prev.word(i);
+        w.write_gamma(nchanged + 1);
+        std::size_t next = 0; // index just past the last changed word written
+        for (std::size_t i = 0; i < Bitset::num_words() && nchanged; ++i) {
+            const T x = T(bs.word(i) ^ prev.word(i));
+            if (!x) continue;
+            w.write_gamma(i - next + 1);
+            if (bit_util::popcount(x) == 1) w.write_bit(true).write(unsigned(bit_util::ctz(x)), Stream::PosBits);
+            else w.write_bit(false).write(x, unsigned(Stream::TBits));
+            next = i + 1;
+            --nchanged;
+        }
+        prev = bs;
+        ++nsnapshots;
+    }
+
+    /// hand off the encoded snapshots, leaving the encoder empty
+    Stream finish() {
+        Stream ret;
+        ret.nbits = w.size();
+        ret.words = w.release();
+        ret.nsnapshots = nsnapshots;
+        ret.interval = interval;
+        ret.keyframes = std::move(keyframes);
+        keyframes.clear();
+        nsnapshots = 0;
+        prev.reset();
+        return ret;
+    }
+};
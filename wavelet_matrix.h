@@ -0,0 +1,206 @@
+/*
+ * compact_bitset - A drop-in replacement for std::bitset that doesn't
+ * waste memory.
+ *
+ * Copyright (c) 2001 Calin A. Culianu <calin.culianu@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+*/
+#pragma once
+#include "bit_util.h"
+#include "rank_select.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/// A wavelet matrix over a sequence of unsigned integer symbols, each at most `bits_per_symbol()` bits wide.
+///
+/// Level k holds bit (bits_per_symbol() - 1 - k) of every symbol, in the order obtained by stably partitioning the
+/// previous level by its bit (zeros first). Each level is a rank_select_bitvector, so access(), rank(), select() and
+/// quantile() all cost O(bits_per_symbol()) rank/select operations, independent of the sequence length.
+/// Space is ~1.14 * size() * bits_per_symbol() bits.
+class wavelet_matrix
+{
+public:
+    using value_type = std::uint64_t;
+private:
+    std::size_t n = 0;
+    unsigned nlevels = 0;
+    std::vector<rank_select_bitvector> levels;
+    std::vector<std::size_t> zeros; ///< number of zeros at each level
+
+    bool symbol_bit(value_type c, unsigned level) const noexcept { return c >> (nlevels - 1 - level) & 0x1; }
+
+    // Chunk boundaries are multiples of 64, so threads never write to the same word of a level.
+    static std::size_t chunk_size(std::size_t n, unsigned nthreads) noexcept { return ((n + nthreads - 1) / nthreads + 63) / 64 * 64; }
+    // Runs f(t, begin, end) for each of `nthreads` chunks of [0, n), each on its own thread.
+    template <typename F>
+    static void for_each_chunk(std::size_t n, unsigned nthreads, F && f) {
+        const std::size_t chunk = chunk_size(n, nthreads);
+        if (nthreads <= 1) { f(0u, std::size_t(0), n); return; }
+        std::vector<std::thread> threads;
+        threads.reserve(nthreads - 1);
+        for (unsigned t = 1; t < nthreads; ++t)
+            threads.emplace_back([&f, t, chunk, n] { f(t, std::min(n, t * chunk), std::min(n, (t + 1) * chunk)); });
+        f(0u, std::size_t(0), std::min(n, chunk));
+        for (auto &th : threads) th.join();
+    }
+    void build(std::vector<value_type> cur, unsigned nthreads) {
+        if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+        nthreads = unsigned(std::max<std::size_t>(1, std::min<std::size_t>(nthreads, n / 4096))); // don't bother for small inputs
+        std::vector<value_type> next(n);
+        std::vector<std::size_t> chunkZeros(nthreads), zeroOfs(nthreads), oneOfs(nthreads);
+        levels.reserve(nlevels);
+        for (unsigned level = 0; level < nlevels; ++level) {
+            const unsigned shift = nlevels - 1 - level;
+            std::vector<std::uint64_t> words((n + 63) / 64);
+            // pass 1: each thread sets the bits for its chunk and counts its zeros
+            for_each_chunk(n, nthreads, [&](unsigned t, std::size_t b, std::size_t e) {
+                std::size_t z = 0;
+                for (std::size_t i = b; i < e; ++i) {
+                    const std::uint64_t bit = cur[i] >> shift & 0x1;
+                    words[i / 64] |= bit << (i % 64);
+                    z += !bit;
+                }
+                chunkZeros[t] = z;
+            });
+            std::size_t totalZeros = 0;
+            for (unsigned t = 0; t < nthreads; ++t) totalZeros += chunkZeros[t];
+            zeros.push_back(totalZeros);
+            levels.emplace_back(std::move(words), n);
+            if (level + 1 == nlevels) break;
+            // pass 2: each thread stably scatters its chunk into the next level's order, at offsets from a prefix sum
+            const std::size_t chunk = chunk_size(n, nthreads);
+            std::size_t z = 0, o = totalZeros;
+            for (unsigned t = 0; t < nthreads; ++t) {
+                const std::size_t b = std::min(n, t * chunk), e = std::min(n, (t + 1) * chunk);
+                zeroOfs[t] = z;
+                oneOfs[t] = o;
+                z += chunkZeros[t];
+                o += (e - b) - chunkZeros[t];
+            }
+            for_each_chunk(n, nthreads, [&](unsigned t, std::size_t b, std::size_t e) {
+                std::size_t zi = zeroOfs[t], oi = oneOfs[t];
+                for (std::size_t i = b; i < e; ++i)
+                    next[(cur[i] >> shift & 0x1) ? oi++ : zi++] = cur[i];
+            });
+            cur.swap(next);
+        }
+    }
+    // returns the start of symbol c's range at the bottom level
+    std::size_t bottom_start(value_type c) const noexcept {
+        std::size_t p = 0;
+        for (unsigned level = 0; level < nlevels; ++level)
+            p = symbol_bit(c, level) ? zeros[level] + levels[level].rank1(p) : levels[level].rank0(p);
+        return p;
+    }
+public:
+    /// construct an empty wavelet matrix
+    wavelet_matrix() = default;
+    /// Build a wavelet matrix over `seq`. Each symbol must fit in `bitsPerSymbol` bits; if 0, just enough bits for the
+    /// largest symbol are used. Each level is built with `nthreads` threads (0 means one per hardware thread).
+    /// @throws std::invalid_argument if a symbol does not fit in bitsPerSymbol bits, or bitsPerSymbol > 64.
+    template <typename Int>
+    explicit wavelet_matrix(const std::vector<Int> &seq, unsigned bitsPerSymbol = 0, unsigned nthreads = 1) : n(seq.size()) {
+        std::vector<value_type> cur(seq.begin(), seq.end());
+        const value_type maxSym = cur.empty() ? 0 : *std::max_element(cur.begin(), cur.end());
+        if (bitsPerSymbol > 64) throw std::invalid_argument("wavelet_matrix symbols may be at most 64 bits wide");
+        if (!bitsPerSymbol) bitsPerSymbol = maxSym ? unsigned(bit_util::log2(maxSym)) + 1 : 1;
+        else if (maxSym > bit_util::low_mask(bitsPerSymbol)) throw std::invalid_argument("wavelet_matrix symbol is too wide");
+        nlevels = bitsPerSymbol;
+        build(std::move(cur), nthreads);
+    }
+
+    std::size_t size() const noexcept { return n; }
+    bool empty() const noexcept { return n == 0; }
+    unsigned bits_per_symbol() const noexcept { return nlevels; }
+    /// returns the number of bytes used by the levels, including their rank/select indexes
+    std::size_t bytes_used() const noexcept {
+        std::size_t ret = 0;
+        for (const auto &lv : levels) ret += lv.bits_size() + lv.index_size();
+        return ret;
+    }
+
+    /// returns the symbol at position i -- throws std::out_of_range if i >= size()
+    value_type access(std::size_t i) const {
+        if (i >= n) throw std::out_of_range("Out-of-range position specified to wavelet_matrix");
+        value_type ret = 0;
+        for (unsigned level = 0; level < nlevels; ++level) {
+            const auto &lv = levels[level];
+            const bool bit = lv[i];
+            i = bit ? zeros[level] + lv.rank1(i) : lv.rank0(i);
+            ret = ret << 1 | value_type(bit);
+        }
+        return ret;
+    }
+    value_type operator[](std::size_t i) const { return access(i); }
+
+    /// returns the number of occurrences of symbol c in positions [0, i). i is clamped to size().
+    std::size_t rank(value_type c, std::size_t i) const noexcept {
+        if (nlevels < 64 && c >> nlevels) return 0; // symbol cannot occur
+        i = std::min(i, n);
+        std::size_t p = 0;
+        for (unsigned level = 0; level < nlevels; ++level) {
+            const auto &lv = levels[level];
+            if (symbol_bit(c, level)) {
+                p = zeros[level] + lv.rank1(p);
+                i = zeros[level] + lv.rank1(i);
+            } else {
+                p = lv.rank0(p);
+                i = lv.rank0(i);
+            }
+        }
+        return i - p;
+    }
+    /// returns the position of the k-th (0-based) occurrence of symbol c -- throws std::out_of_range if c occurs k
+    /// times or fewer
+    std::size_t select(value_type c, std::size_t k) const {
+        if (k >= rank(c, n)) throw std::out_of_range("Out-of-range occurrence specified to wavelet_matrix::select");
+        std::size_t pos = bottom_start(c) + k;
+        // walk back up: the element at pos came from the pos-th zero (or one) of the level above
+        for (unsigned level = nlevels; level-- > 0; )
+            pos = symbol_bit(c, level) ? levels[level].select1(pos - zeros[level]) : levels[level].select0(pos);
+        return pos;
+    }
+    /// returns the k-th (0-based) smallest symbol in positions [l, r) -- throws std::out_of_range if the range is
+    /// invalid or k >= r - l
+    value_type quantile(std::size_t l, std::size_t r, std::size_t k) const {
+        if (l > r || r > n || k >= r - l) throw std::out_of_range("Out-of-range query specified to wavelet_matrix::quantile");
+        value_type ret = 0;
+        for (unsigned level = 0; level < nlevels; ++level) {
+            const auto &lv = levels[level];
+            const std::size_t l0 = lv.rank0(l), r0 = lv.rank0(r);
+            if (k < r0 - l0) {
+                l = l0;
+                r = r0;
+                ret <<= 1;
+            } else {
+                k -= r0 - l0;
+                l = zeros[level] + (l - l0);
+                r = zeros[level] + (r - r0);
+                ret = ret << 1 | 0x1;
+            }
+        }
+        return ret;
+    }
+};